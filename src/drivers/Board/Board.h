@@ -9,15 +9,41 @@
 #define ACCEL_SDA_PIN 16
 #define ACCEL_SCL_PIN 17
 #define I2C_ADDRESS 0x19
+#define ACCEL_INT1_PIN 18 // LIS3DH INT1 output (data ready / FIFO interrupts)
+#define ACCEL_INT2_PIN 19 // LIS3DH INT2 output (tap / free-fall / orientation events)
 
 #define WAI_REG 0x0F // WHO_AM_I register address for LIS3DH
 #define CTRL_REG1 0x20 // Control register 1 address for LIS3DH
+#define CTRL_REG2 0x21 // Control register 2 address for LIS3DH
+#define CTRL_REG3 0x22 // Control register 3 address for LIS3DH
 #define CTRL_REG4 0x23 // Control register 4 address for LIS3DH
+#define CTRL_REG5 0x24 // Control register 5 address for LIS3DH
+#define CTRL_REG6 0x25 // Control register 6 address for LIS3DH
+#define STATUS_REG 0x27 // Status register address for LIS3DH
+#define FIFO_CTRL_REG 0x2E // FIFO control register address for LIS3DH
+#define FIFO_SRC_REG 0x2F // FIFO status register address for LIS3DH
 #define TEMP_CFG_REG 0x1F // Temperature configuration register address for LIS3DH
 
+#define INT1_CFG 0x30 // Inertial interrupt 1 configuration register address for LIS3DH
+#define INT1_SRC 0x31 // Inertial interrupt 1 source register address for LIS3DH
+#define INT1_THS 0x32 // Inertial interrupt 1 threshold register address for LIS3DH
+#define INT1_DURATION 0x33 // Inertial interrupt 1 duration register address for LIS3DH
+#define INT2_CFG 0x34 // Inertial interrupt 2 configuration register address for LIS3DH
+#define INT2_SRC 0x35 // Inertial interrupt 2 source register address for LIS3DH
+#define INT2_THS 0x36 // Inertial interrupt 2 threshold register address for LIS3DH
+#define INT2_DURATION 0x37 // Inertial interrupt 2 duration register address for LIS3DH
+#define CLICK_CFG 0x38 // Click configuration register address for LIS3DH
+#define CLICK_SRC 0x39 // Click source register address for LIS3DH
+#define CLICK_THS 0x3A // Click threshold register address for LIS3DH
+#define TIME_LIMIT 0x3B // Click time limit register address for LIS3DH
+#define TIME_LATENCY 0x3C // Double click latency register address for LIS3DH
+#define TIME_WINDOW 0x3D // Double click window register address for LIS3DH
+
 #define READ_X_L 0x28 // X-axis low byte register address for LIS3DH
 #define READ_X_H 0x29 // X-axis high byte register address for LIS3DH
 #define READ_Y_L 0x2A // Y-axis low byte register address for LIS3DH
 #define READ_Y_H 0x2B // Y-axis high byte register address for LIS3DH
 #define READ_Z_L 0x2C // Z-axis low byte register address for LIS3DH
-#define READ_Z_H 0x2D // Z-axis high byte register address for LIS3DH
\ No newline at end of file
+#define READ_Z_H 0x2D // Z-axis high byte register address for LIS3DH
+
+#define AUTO_INCREMENT 0x80 // Set in the register address to read/write consecutive registers in one transfer
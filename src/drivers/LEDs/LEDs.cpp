@@ -1,51 +1,79 @@
 // LED Driver
 
 #include <stdio.h>
+#include <string.h>
 #include <vector>
+#include <algorithm>
 #include "pico/stdlib.h"
+#include "pico/time.h"
 #include "hardware/gpio.h"
 #include "hardware/pio.h"
+#include "hardware/dma.h"
 
 #include "WS2812.pio.h" // This header file gets produced during compilation from the WS2812.pio file
 #include "LEDs.h"
 #include "drivers/Board/Board.h"
+#include "drivers/instrumentation/instrumentation.h"
+#include "drivers/logging/logging.h"
+
+// Offset of the WS2812 program in each PIO block, which is loaded once however many state machines run it
+static int ws2812ProgramOffset[NUM_PIOS] = {-1, -1};
 
 // --- LEDs Driver Class Functions ---
 
 // - LED class functions -
 
-// Constructor to initialize LED [led_num] with default color values
-LED::LED(int led_num) : led_num(led_num), red(0), green(0), blue(0), applied_color({red,blue,green}) {}
+// Constructor to create a view of LED [led_num] in [controller]
+LED::LED(LEDController* controller, int led_num) : controller(controller), led_num(led_num) {}
 
 // Set the color of the LED
 // Accepts RGB values in the range 0-255
 void LED::setColor(uint8_t r, uint8_t g, uint8_t b) {
-    red = r;
-    green = g;
-    blue = b;
+    controller->pendingColors[led_num] = packRGB(r, g, b);
+    controller->markDirty(led_num, led_num);
 }
 
 // formatColor() returns the color in a format suitable for WS2812
-// The format is a 32-bit integer where the first byte is red, second byte is green,
-// and third byte is blue.
+// The format is the 32-bit word sent to the PIO, with the channels in the controller's colour order from the top byte
+// down.
 uint32_t LED::formatColor() const {
-    return (red << 24) | (green << 16) | (blue << 8);
+    uint32_t word;
+    controller->packer(&controller->pendingColors[led_num], 1, &word, 1, nullptr);
+    return word;
+}
+
+// setPackedColor() sets the color from a packed 0xWWRRGGBB value
+void LED::setPackedColor(uint32_t color) {
+    controller->pendingColors[led_num] = color;
+    controller->markDirty(led_num, led_num);
+}
+
+// packedColor() returns the pending color packed as 0xWWRRGGBB
+uint32_t LED::packedColor() const {
+    return controller->pendingColors[led_num];
 }
 
 // RGBColor() returns the RGB color as a vector
 std::vector<uint8_t> LED::RGBColor() const {
-    return {red, green, blue};
+    uint32_t color = packedColor();
+    return {packedRed(color), packedGreen(color), packedBlue(color)};
 }
 
 // applyColor() sets the applied color to the current RGB values
 void LED::applyColor() {
     // Update the applied color with the current RGB values
-    applied_color = {red, green, blue};
+    controller->appliedColors[led_num] = controller->pendingColors[led_num];
+}
+
+// packedAppliedColor() returns the currently applied color packed as 0xWWRRGGBB
+uint32_t LED::packedAppliedColor() const {
+    return controller->appliedColors[led_num];
 }
 
 // getAppliedColor() returns the currently applied color
 std::vector<uint8_t> LED::getAppliedColor() const {
-    return applied_color;
+    uint32_t color = packedAppliedColor();
+    return {packedRed(color), packedGreen(color), packedBlue(color)};
 }
 
 // LEDNum() returns the LED number
@@ -53,21 +81,180 @@ int LED::LEDNum() const {
     return led_num;
 }
 
+// - WS2812Chain class functions -
+
+WS2812Chain::WS2812Chain()
+    : output{0, nullptr, -1}, sm(0), dmaChannel(-1), rgbw(false), buffer(nullptr), length(0), frameInFlight(false),
+      latchStarted(false), latchStart() {}
+
+// init() starts the WS2812 program on a state machine and claims the DMA channel that feeds it
+void WS2812Chain::init(const LEDOutput& chainOutput, bool chainRgbw, const uint32_t* chainBuffer, size_t chainLength) {
+    output = chainOutput;
+    rgbw = chainRgbw;
+    buffer = chainBuffer;
+    length = chainLength;
+    PIO pio = output.pio;
+
+    // Load the WS2812 program into the PIO block if this is its first chain, and start a state machine running it
+    unsigned int pioIndex = pio_get_index(pio);
+    if (ws2812ProgramOffset[pioIndex] < 0) {
+        ws2812ProgramOffset[pioIndex] = (int)pio_add_program(pio, &ws2812_program);
+    }
+    if (output.sm < 0) {
+        sm = (unsigned int)pio_claim_unused_sm(pio, true);
+    } else {
+        sm = (unsigned int)output.sm;
+        pio_sm_claim(pio, sm);
+    }
+    ws2812_program_init(pio, sm, ws2812ProgramOffset[pioIndex], output.pin, 800000, rgbw);
+
+    // Claim a DMA channel that copies the buffer into the state machine's TX FIFO, paced by its DREQ
+    dmaChannel = dma_claim_unused_channel(true);
+    dma_channel_config config = dma_channel_get_default_config(dmaChannel);
+    channel_config_set_transfer_data_size(&config, DMA_SIZE_32);
+    channel_config_set_read_increment(&config, true);
+    channel_config_set_write_increment(&config, false);
+    channel_config_set_dreq(&config, pio_get_dreq(pio, sm, true));
+    dma_channel_configure(dmaChannel, &config, &pio->txf[sm], buffer, length, false);
+}
+
+// arm() reloads the DMA channel with the whole buffer, ready to be started
+uint32_t WS2812Chain::arm() {
+    return arm(length);
+}
+
+// arm(words) reloads the DMA channel with the start of the buffer
+uint32_t WS2812Chain::arm(size_t words) {
+    dma_channel_set_read_addr(dmaChannel, buffer, false);
+    dma_channel_set_trans_count(dmaChannel, std::min(words, length), false);
+    frameInFlight = true;
+    latchStarted = false;
+    return 1u << dmaChannel;
+}
+
+// start() sends the next frame
+void WS2812Chain::start() {
+    dma_start_channel_mask(arm());
+}
+
+// isFrameDone() checks whether the DMA transfer has finished, the PIO has drained and the latch time has elapsed
+bool WS2812Chain::isFrameDone() {
+    if (!frameInFlight) {
+        return true;
+    }
+
+    // Still sending data to the LEDs
+    if (dma_channel_is_busy(dmaChannel) || !pio_sm_is_tx_fifo_empty(output.pio, sm)) {
+        return false;
+    }
+
+    // The FIFO is empty, so the line goes idle once the final word has shifted out. Time the latch from here.
+    if (!latchStarted) {
+        latchStart = get_absolute_time();
+        latchStarted = true;
+    }
+    int64_t wordTime = rgbw ? RGBW_WORD_TIME_US : WORD_TIME_US;
+    if (absolute_time_diff_us(latchStart, get_absolute_time()) < LATCH_TIME_US + wordTime) {
+        return false;
+    }
+
+    frameInFlight = false;
+    return true;
+}
+
+// - Packing functions -
+
+// pixelPackerFor() picks the packPixels() specialisation for a colour order, so each one is compiled with its shifts as
+// constants
+PixelPacker pixelPackerFor(ColorOrder order, bool hasWhite) {
+    static constexpr PixelPacker packers[3][2] = {
+        {packPixels<ColorOrder::RGB, false>, packPixels<ColorOrder::RGB, true>},
+        {packPixels<ColorOrder::GRB, false>, packPixels<ColorOrder::GRB, true>},
+        {packPixels<ColorOrder::BGR, false>, packPixels<ColorOrder::BGR, true>},
+    };
+    return packers[size_t(order)][hasWhite ? 1 : 0];
+}
+
 // - LEDController class functions -
 
 // Constructor to initialize the LEDController with a specified number of LEDs
-LEDController::LEDController(int num_leds) : LEDs() {
+LEDController::LEDController(int num_leds, ColorOrder order, bool hasWhite)
+    : pendingColors(num_leds, 0), appliedColors(num_leds, 0), LEDs(), outputTable(), outputTableIdentity(true),
+      brightness(255), gammaCorrection(false), hasWhite(hasWhite),
+      packer(pixelPackerFor(order, hasWhite)), outputs(), segments(), segmentOffsets(), frameBuffer(),
+      initialised(false), dirtyFirst(num_leds), dirtyLast(-1), fullFrame(true), frameStats() {
+    LEDs.reserve(num_leds);
     for (int i = 0; i < num_leds; ++i) {
-        LEDs.emplace_back(i);
+        LEDs.emplace_back(this, i);
     }
+    rebuildOutputTable();
+
+    // One chain on the board's LED pin
+    outputs.push_back({{LED_PIN, pio0, -1}, WS2812Chain(), 0, 0, 0});
+    segments.push_back({0, num_leds, 0, false});
+    layoutFrame();
+}
+
+// configureOutputs() checks and applies a new output mapping
+bool LEDController::configureOutputs(const std::vector<LEDOutput>& newOutputs,
+                                     const std::vector<LEDSegment>& newSegments) {
+    if (initialised) {
+        log(LogLevel::ERROR, "LEDController::configureOutputs: Outputs must be configured before initLEDs().");
+        return false;
+    }
+    if (newOutputs.empty()) {
+        log(LogLevel::ERROR, "LEDController::configureOutputs: No outputs given.");
+        return false;
+    }
+
+    std::vector<bool> used(newOutputs.size(), false);
+    for (const LEDSegment& segment : newSegments) {
+        if (segment.output < 0 || segment.output >= (int)newOutputs.size() || segment.first < 0 ||
+            segment.count <= 0 || segment.first + segment.count > (int)pendingColors.size()) {
+            logValues(LogLevel::ERROR, "LEDController::configureOutputs: Segment at LED %d is out of range.",
+                      {segment.first});
+            return false;
+        }
+        used[segment.output] = true;
+    }
+    if (std::find(used.begin(), used.end(), false) != used.end()) {
+        log(LogLevel::ERROR, "LEDController::configureOutputs: Every output needs at least one segment.");
+        return false;
+    }
+
+    outputs.clear();
+    for (const LEDOutput& output : newOutputs) {
+        outputs.push_back({output, WS2812Chain(), 0, 0, 0});
+    }
+    segments = newSegments;
+    layoutFrame();
+    fullFrame = true;
+    return true;
+}
+
+// layoutFrame() stores each output's segments together in frameBuffer, in the order they are sent
+void LEDController::layoutFrame() {
+    segmentOffsets.assign(segments.size(), 0);
+    size_t offset = 0;
+    for (size_t o = 0; o < outputs.size(); ++o) {
+        outputs[o].offset = offset;
+        for (size_t s = 0; s < segments.size(); ++s) {
+            if (segments[s].output == (int)o) {
+                segmentOffsets[s] = offset;
+                offset += segments[s].count;
+            }
+        }
+        outputs[o].length = offset - outputs[o].offset;
+    }
+    frameBuffer.assign(offset, 0);
 }
 
 // initialize LEDs
 void LEDController::initLEDs() {
-    // Initialise PIO0 to control the LED chain
-    uint pio_program_offset = pio_add_program(pio0, &ws2812_program);
-    // Set up the WS2812 program with the specified parameters
-    ws2812_program_init(pio0, 0, pio_program_offset, LED_PIN, 800000, false);
+    for (OutputChannel& channel : outputs) {
+        channel.chain.init(channel.output, hasWhite, frameBuffer.data() + channel.offset, channel.length);
+    }
+    initialised = true;
 }
 
 // getLED() returns a reference to the LED at the specified index
@@ -79,79 +266,390 @@ LED& LEDController::getLED(int index) {
 // setLEDGroup() sets a group of LEDs to the specified color
 // This function takes an array of indices and sets the corresponding LEDs to the given RGB color.
 void LEDController::setLEDGroup(const std::vector<int>& indices, uint8_t r, uint8_t g, uint8_t b) {
+    uint32_t color = packRGB(r, g, b);
     for (int index : indices) {
-        if (index >= 0 && index < LEDs.size()) {
-            LEDs[index].setColor(r, g, b); // Set the color of the specified LED
+        if (index >= 0 && index < (int)pendingColors.size()) {
+            pendingColors[index] = color; // Set the color of the specified LED
+            markDirty(index, index);
         }
     }
 }
 
+// fillRange() sets a run of LEDs to one colour, clipped to the strip
+void LEDController::fillRange(int first, int count, uint32_t color) {
+    int begin = std::max(first, 0);
+    int end = std::min(first + count, (int)pendingColors.size());
+    if (begin < end) {
+        std::fill(pendingColors.begin() + begin, pendingColors.begin() + end, color);
+        markDirty(begin, end - 1);
+    }
+}
+
 // resetLEDs() resets all LEDs to off state
 void LEDController::resetLEDs() {
-    for (auto& led : LEDs) {
-        led.setColor(0, 0, 0); // Set each LED to black (off)
-    }
+    std::fill(pendingColors.begin(), pendingColors.end(), 0); // Set each LED to black (off)
+    markDirty(0, (int)pendingColors.size() - 1);
 }
 
 // Update the LEDs by sending their color data to the WS2812 chain
 // This function assumes that the PIO and WS2812 program are already initialized
 void LEDController::updateLEDs() {
-    for (const auto& led : LEDs) {
-        uint32_t color = led.formatColor();
-        pio_sm_put_blocking(pio0, 0, color);
+    INSTRUMENT_SCOPE(Probe::LED_UPDATE);
+    waitForFrame(); // Let any asynchronous frame finish first
+    updateLEDsAsync();
+    waitForFrame(); // Delay only for the latch time so the LEDs show the new colours on return
+}
+
+// updateLEDsAsync() packs the changed LEDs and hands each output's frame, up to its last change, to its DMA channel
+// without waiting for it to be sent
+bool LEDController::updateLEDsAsync() {
+    // The DMA channels are still reading the frame buffer, so it cannot be repacked yet
+    if (!initialised || !isFrameDone()) {
+        return false;
+    }
+
+    // Trim LEDs that were written but ended up back at their applied colour (e.g. cleared and redrawn) off the ends
+    int first = 0;
+    int last = (int)pendingColors.size() - 1;
+    if (!fullFrame) {
+        first = std::max(dirtyFirst, first);
+        last = std::min(dirtyLast, last);
+        while (first <= last && pendingColors[first] == appliedColors[first]) {
+            ++first;
+        }
+        while (last >= first && pendingColors[last] == appliedColors[last]) {
+            --last;
+        }
+    }
+    dirtyFirst = (int)pendingColors.size();
+    dirtyLast = -1;
+    fullFrame = false;
+
+    if (first > last) {
+        frameStats.framesSkipped++;
+        frameStats.pixelsSaved += (uint32_t)frameBuffer.size();
+        return true;
+    }
+
+    // Pack the changed part of each segment into its output's part of the frame, walking the colours backwards for
+    // reversed segments. Words before it are still valid from earlier frames; each output is sent up to the last
+    // changed word.
+    const uint8_t* table = outputTableIdentity ? nullptr : outputTable.data();
+    for (OutputChannel& channel : outputs) {
+        channel.sendLength = 0;
+    }
+    for (size_t s = 0; s < segments.size(); ++s) {
+        const LEDSegment& segment = segments[s];
+        int begin = std::max(first, segment.first);
+        int end = std::min(last, segment.first + segment.count - 1);
+        if (begin > end) {
+            continue;
+        }
+
+        // Positions in the segment of the first word to pack and of the word after the last
+        size_t start = begin - segment.first;
+        size_t stop = end - segment.first + 1;
+        const uint32_t* src = pendingColors.data() + begin;
+        ptrdiff_t step = 1;
+        if (segment.reversed) {
+            start = segment.first + segment.count - 1 - end;
+            stop = segment.first + segment.count - begin;
+            src = pendingColors.data() + end;
+            step = -1;
+        }
+        packer(src, step, frameBuffer.data() + segmentOffsets[s] + start, stop - start, table);
+
+        OutputChannel& channel = outputs[segment.output];
+        channel.sendLength = std::max(channel.sendLength, segmentOffsets[s] - channel.offset + stop);
+    }
+    std::copy(pendingColors.begin() + first, pendingColors.begin() + last + 1, appliedColors.begin() + first);
+
+    // Start every output with changes in the same cycle
+    uint32_t dmaMask = 0;
+    uint32_t sent = 0;
+    for (OutputChannel& channel : outputs) {
+        if (channel.sendLength > 0) {
+            dmaMask |= channel.chain.arm(channel.sendLength);
+            sent += (uint32_t)channel.sendLength;
+        }
+    }
+    dma_start_channel_mask(dmaMask);
+
+    frameStats.framesSent++;
+    frameStats.pixelsSent += sent;
+    frameStats.pixelsSaved += (uint32_t)frameBuffer.size() - sent;
+    return true;
+}
+
+// markAllDirty() forces the next frame to repack and resend every LED
+void LEDController::markAllDirty() {
+    fullFrame = true;
+}
+
+// getFrameStats() returns the frame and pixel counters
+LEDFrameStats LEDController::getFrameStats() const {
+    return frameStats;
+}
+
+// isFrameDone() checks whether every output has sent and latched its frame
+bool LEDController::isFrameDone() {
+    for (OutputChannel& channel : outputs) {
+        if (!channel.chain.isFrameDone()) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// waitForFrame() spins until the current frame has been latched by the LEDs
+void LEDController::waitForFrame() {
+    while (!isFrameDone()) {
+        tight_loop_contents();
     }
-    sleep_ms(500); // Delay to allow the LEDs to update
 }
 
 // HSVtoRGB(int h, int s, int v) converts HSV values to RGB
 std::vector<uint8_t> LEDController::HSVtoRGB(int h, int s, int v) const {
-    float r, g, b;
-    float f, p, q, t;
-    int i;
+    // Wrap the hue to 0-359 degrees and rescale it to the 16-bit hue used by hsvToPacked()
+    h %= 360;
+    if (h < 0) {
+        h += 360;
+    }
+    uint16_t hue = (uint16_t)((uint32_t)h * 65536 / 360);
+    uint32_t color = hsvToPacked(hue, (uint8_t)s, (uint8_t)v);
+    return {packedRed(color), packedGreen(color), packedBlue(color)};
+}
 
-    if (s == 0) {
-        r = g = b = v / 255.0f; // Achromatic (grey)
-    } else {
-        h /= 60; // Sector 0 to 5
-        i = static_cast<int>(h);
-        f = h - i; // Factorial part
-        p = v * (1 - s / 255.0f);
-        q = v * (1 - f * s / 255.0f);
-        t = v * (1 - (1 - f) * s / 255.0f);
+// setHSVRange() converts a run of HSV colours straight into the pending colour buffer
+void LEDController::setHSVRange(int first, const HSV* colors, int count) {
+    if (first < 0) {
+        colors -= first;
+        count += first;
+        first = 0;
+    }
+    int end = std::min(first + count, (int)pendingColors.size());
+    uint32_t* out = pendingColors.data();
+    for (int i = first; i < end; ++i) {
+        const HSV& color = colors[i - first];
+        out[i] = hsvToPacked(color.h, color.s, color.v);
+    }
+    if (first < end) {
+        markDirty(first, end - 1);
+    }
+}
 
-        switch (i % 6) {
-            case 0: r = v; g = t; b = p; break;
-            case 1: r = q; g = v; b = p; break;
-            case 2: r = p; g = v; b = t; break;
-            case 3: r = p; g = q; b = v; break;
-            case 4: r = t; g = p; b = v; break;
-            case 5: r = v; g = p; b = q; break;
-        }
+// Rebuild the output table from the gamma and brightness settings
+void LEDController::rebuildOutputTable() {
+    for (int i = 0; i < 256; ++i) {
+        uint8_t value = gammaCorrection ? GAMMA_TABLE[i] : (uint8_t)i;
+        outputTable[i] = scale8(value, brightness);
     }
+    outputTableIdentity = !gammaCorrection && brightness == 255;
+}
 
-    return {static_cast<uint8_t>(r), static_cast<uint8_t>(g), static_cast<uint8_t>(b)};
+// setBrightness() scales every LED's output
+void LEDController::setBrightness(uint8_t value) {
+    brightness = value;
+    rebuildOutputTable();
+    fullFrame = true;
+}
+
+// setGammaCorrection() enables gamma correction of the output
+void LEDController::setGammaCorrection(bool enabled) {
+    gammaCorrection = enabled;
+    rebuildOutputTable();
+    fullFrame = true;
 }
 
 // - LED status functions -
 
 // count() returns the number of LEDs managed by this controller
 int LEDController::count() const {
-    return LEDs.size();
+    return pendingColors.size();
+}
+
+// - Report formatting -
+
+// ReportWriter formats reports without the heap. In buffer mode it copies what fits into the caller's buffer and
+// counts the rest; in sink mode it collects text in a small chunk and hands each full chunk to the sink.
+struct LEDController::ReportWriter {
+    static constexpr size_t CHUNK_SIZE = 64;
+
+    char* buffer;
+    size_t size;
+    size_t length; // Length of the whole report so far, including anything that did not fit
+    ReportSink sink;
+    void* context;
+    char chunk[CHUNK_SIZE];
+    size_t chunkLength;
+
+    ReportWriter(char* buffer, size_t size)
+        : buffer(buffer), size(size), length(0), sink(nullptr), context(nullptr), chunkLength(0) {}
+    ReportWriter(ReportSink sink, void* context)
+        : buffer(nullptr), size(0), length(0), sink(sink), context(context), chunkLength(0) {}
+
+    void put(const char* text, size_t count) {
+        if (sink) {
+            while (count > 0) {
+                size_t n = std::min(count, CHUNK_SIZE - chunkLength);
+                std::copy(text, text + n, chunk + chunkLength);
+                chunkLength += n;
+                text += n;
+                count -= n;
+                if (chunkLength == CHUNK_SIZE) {
+                    flush();
+                }
+            }
+            return;
+        }
+        if (length + 1 < size) {
+            size_t n = std::min(count, size - 1 - length);
+            std::copy(text, text + n, buffer + length);
+        }
+        length += count;
+    }
+
+    void text(const char* text) {
+        put(text, strlen(text));
+    }
+
+    void number(int value) {
+        char digits[12];
+        size_t n = sizeof(digits);
+        unsigned int magnitude = value < 0 ? 0u - (unsigned int)value : (unsigned int)value;
+        do {
+            digits[--n] = char('0' + magnitude % 10);
+            magnitude /= 10;
+        } while (magnitude > 0);
+        if (value < 0) {
+            digits[--n] = '-';
+        }
+        put(digits + n, sizeof(digits) - n);
+    }
+
+    void flush() {
+        if (chunkLength > 0) {
+            sink(context, chunk, chunkLength);
+            chunkLength = 0;
+        }
+    }
+
+    // finish() flushes the sink or terminates the buffer, and returns the length of the whole report
+    size_t finish() {
+        if (sink) {
+            flush();
+        } else if (size > 0) {
+            buffer[std::min(length, size - 1)] = '\0';
+        }
+        return length;
+    }
+};
+
+// statusLine() writes "LED n: R=r, G=g, B=b" for the pending colour of LED [index]
+void LEDController::statusLine(ReportWriter& writer, int index) const {
+    writer.text("LED ");
+    writer.number(index);
+    if (index < 0 || index >= (int)pendingColors.size()) {
+        writer.text(": Out of range");
+        return;
+    }
+    uint32_t color = pendingColors[index];
+    writer.text(": R=");
+    writer.number(packedRed(color));
+    writer.text(", G=");
+    writer.number(packedGreen(color));
+    writer.text(", B=");
+    writer.number(packedBlue(color));
+}
+
+// actionLine() writes "LED n: Pending RGB(r,g,b)" if LED [index] has a colour waiting to be applied
+void LEDController::actionLine(ReportWriter& writer, int index) const {
+    writer.text("LED ");
+    writer.number(index);
+    if (index < 0 || index >= (int)pendingColors.size()) {
+        writer.text(": Out of range");
+        return;
+    }
+    uint32_t color = pendingColors[index];
+    if (color == appliedColors[index]) {
+        writer.text(": No actions on standby");
+        return;
+    }
+    writer.text(": Pending RGB(");
+    writer.number(packedRed(color));
+    writer.text(",");
+    writer.number(packedGreen(color));
+    writer.text(",");
+    writer.number(packedBlue(color));
+    writer.text(")");
+}
+
+void LEDController::statusReport(ReportWriter& writer, const int* indices, size_t count) const {
+    for (size_t i = 0; i < count; ++i) {
+        statusLine(writer, indices[i]);
+        writer.text("\n");
+    }
+}
+
+void LEDController::actionReport(ReportWriter& writer, const int* indices, size_t count) const {
+    for (size_t i = 0; i < count; ++i) {
+        actionLine(writer, indices[i]);
+        writer.text("\n");
+    }
+}
+
+void LEDController::summaryReport(ReportWriter& writer) const {
+    writer.text("LED Summary:\n");
+    for (int led_num = 0; led_num < (int)pendingColors.size(); ++led_num) {
+        statusLine(writer, led_num);
+        writer.text(";");
+        actionLine(writer, led_num);
+        writer.text("\n");
+    }
+}
+
+void LEDController::dirtyReport(ReportWriter& writer) const {
+    int total = pendingColors.size();
+    int led_num = 0;
+    while (led_num < total) {
+        uint32_t color = pendingColors[led_num];
+        if (color == appliedColors[led_num]) {
+            ++led_num;
+            continue;
+        }
+
+        // Extend the run over the following LEDs waiting for the same colour
+        int last = led_num;
+        while (last + 1 < total && pendingColors[last + 1] == color && appliedColors[last + 1] != color) {
+            ++last;
+        }
+
+        writer.text("LED ");
+        writer.number(led_num);
+        if (last > led_num) {
+            writer.text("-");
+            writer.number(last);
+        }
+        writer.text(": Pending RGB(");
+        writer.number(packedRed(color));
+        writer.text(",");
+        writer.number(packedGreen(color));
+        writer.text(",");
+        writer.number(packedBlue(color));
+        writer.text(")\n");
+        led_num = last + 1;
+    }
 }
 
 // getStatus(const std::vector<int>& indices) returns the status of the specified LEDs
 std::vector<std::string> LEDController::getStatus(const std::vector<int>& indices) const {
     std::vector<std::string> status;
     for (int index : indices) {
-        if (index >= 0 && index < LEDs.size()) {
-            const LED& led = LEDs[index];
-            status.push_back("LED " + std::to_string(index) + ": " + 
-                             "R=" + std::to_string(led.formatColor() >> 24 & 0xFF) + ", " +
-                             "G=" + std::to_string(led.formatColor() >> 16 & 0xFF) + ", " +
-                             "B=" + std::to_string(led.formatColor() >> 8 & 0xFF));
-        } else {
-            status.push_back("LED " + std::to_string(index) + ": Out of range");
-        }
+        char line[64];
+        ReportWriter writer(line, sizeof(line));
+        statusLine(writer, index);
+        writer.finish();
+        status.push_back(line);
     }
     return status;
 }
@@ -159,34 +657,79 @@ std::vector<std::string> LEDController::getStatus(const std::vector<int>& indice
 // getAction(const std::vector<int>& indices) returns the action for the specified LEDs
 std::vector<std::string> LEDController::getAction(const std::vector<int>& indices) const {
     std::vector<std::string> actions;
-
     for (int index : indices) {
-        if (index >= 0 && index < LEDs.size()) {
-            if (LEDs[index].RGBColor() != LEDs[index].getAppliedColor()) {
-                actions.push_back("LED " + std::to_string(index) + ": Pending RGB(" +
-                                  std::to_string(LEDs[index].RGBColor()[0]) + "," +
-                                  std::to_string(LEDs[index].RGBColor()[1]) + "," +
-                                  std::to_string(LEDs[index].RGBColor()[2]) + ")");
-            } else {
-                actions.push_back("LED " + std::to_string(index) + ": No actions on standby");
-            }
-        } else {
-            actions.push_back("LED " + std::to_string(index) + ": Out of range");
-        }
+        char line[64];
+        ReportWriter writer(line, sizeof(line));
+        actionLine(writer, index);
+        writer.finish();
+        actions.push_back(line);
     }
     return actions;
 }
 
 // getSummary() returns a summary of the LEDs
 std::string LEDController::getSummary() const {
-    std::string summary = "LED Summary:\n";
-    for (const auto& led : LEDs) {
-        int led_num = led.LEDNum();
-        summary += "LED " + std::to_string(led_num) + ": " +
-                   "R=" + std::to_string(led.formatColor() >> 24 & 0xFF) + ", " +
-                   "G=" + std::to_string(led.formatColor() >> 16 & 0xFF) + ", " +
-                   "B=" + std::to_string(led.formatColor() >> 8 & 0xFF) + ";" +
-                   getAction({led_num})[0] + "\n";
-    }
+    // Size the string once, then format straight into it
+    std::string summary(writeSummary(static_cast<char*>(nullptr), 0), '\0');
+    writeSummary(&summary[0], summary.size() + 1);
     return summary;
-}
\ No newline at end of file
+}
+
+// - Allocation-free reporting -
+
+size_t LEDController::writeStatus(const int* indices, size_t count, char* buffer, size_t size) const {
+    ReportWriter writer(buffer, size);
+    statusReport(writer, indices, count);
+    return writer.finish();
+}
+
+void LEDController::writeStatus(const int* indices, size_t count, ReportSink sink, void* context) const {
+    ReportWriter writer(sink, context);
+    statusReport(writer, indices, count);
+    writer.finish();
+}
+
+size_t LEDController::writeAction(const int* indices, size_t count, char* buffer, size_t size) const {
+    ReportWriter writer(buffer, size);
+    actionReport(writer, indices, count);
+    return writer.finish();
+}
+
+void LEDController::writeAction(const int* indices, size_t count, ReportSink sink, void* context) const {
+    ReportWriter writer(sink, context);
+    actionReport(writer, indices, count);
+    writer.finish();
+}
+
+size_t LEDController::writeSummary(char* buffer, size_t size) const {
+    ReportWriter writer(buffer, size);
+    summaryReport(writer);
+    return writer.finish();
+}
+
+void LEDController::writeSummary(ReportSink sink, void* context) const {
+    ReportWriter writer(sink, context);
+    summaryReport(writer);
+    writer.finish();
+}
+
+size_t LEDController::writeDirty(char* buffer, size_t size) const {
+    ReportWriter writer(buffer, size);
+    dirtyReport(writer);
+    return writer.finish();
+}
+
+void LEDController::writeDirty(ReportSink sink, void* context) const {
+    ReportWriter writer(sink, context);
+    dirtyReport(writer);
+    writer.finish();
+}
+
+// dirtyCount() returns the number of LEDs whose pending colour differs from the applied one
+int LEDController::dirtyCount() const {
+    int dirty = 0;
+    for (size_t i = 0; i < pendingColors.size(); ++i) {
+        dirty += pendingColors[i] != appliedColors[i];
+    }
+    return dirty;
+}
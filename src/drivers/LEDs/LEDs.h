@@ -3,55 +3,368 @@
 // Include necessary libraries
 #include <vector>
 #include <string>
+#include <cstdint>
+#include <array>
+#include <cstddef>
+#include <algorithm>
+#include "pico/time.h"
+#include "hardware/pio.h"
+
+// -- Packed colour helpers --
+
+// Colours are stored packed as 0xWWRRGGBB so that a whole pixel fits in one 32-bit word. The white byte is only sent
+// to RGBW strips.
+constexpr uint32_t packRGB(uint8_t r, uint8_t g, uint8_t b) {
+    return (uint32_t(r) << 16) | (uint32_t(g) << 8) | uint32_t(b);
+}
+constexpr uint32_t packRGBW(uint8_t r, uint8_t g, uint8_t b, uint8_t w) {
+    return (uint32_t(w) << 24) | packRGB(r, g, b);
+}
+constexpr uint8_t packedRed(uint32_t color) { return (color >> 16) & 0xFF; }
+constexpr uint8_t packedGreen(uint32_t color) { return (color >> 8) & 0xFF; }
+constexpr uint8_t packedBlue(uint32_t color) { return color & 0xFF; }
+constexpr uint8_t packedWhite(uint32_t color) { return color >> 24; }
+
+// -- Colour conversion helpers --
+
+// HSV colour with a 16-bit hue (0-65535 is one full turn, so red is 0, green 21845 and blue 43690)
+struct HSV {
+    uint16_t h;
+    uint8_t s;
+    uint8_t v;
+};
+
+// scale8() returns a * b / 255, rounded, for 8-bit a and b
+constexpr uint8_t scale8(uint8_t a, uint8_t b) {
+    uint32_t x = uint32_t(a) * b + 128;
+    return uint8_t((x + (x >> 8)) >> 8);
+}
+
+// hsvToPacked() converts HSV to a packed 0x00RRGGBB colour in integer arithmetic.
+// The hue is split into one of six sectors plus an 8-bit position within the sector.
+constexpr uint32_t hsvToPacked(uint16_t hue, uint8_t s, uint8_t v) {
+    if (s == 0) {
+        return packRGB(v, v, v); // Achromatic (grey)
+    }
+
+    uint32_t scaled = uint32_t(hue) * 6;
+    uint8_t sector = uint8_t(scaled >> 16);
+    uint8_t f = uint8_t(scaled >> 8);
+
+    uint8_t p = scale8(v, 255 - s);
+    uint8_t q = scale8(v, 255 - scale8(s, f));
+    uint8_t t = scale8(v, 255 - scale8(s, 255 - f));
+
+    switch (sector) {
+        case 0: return packRGB(v, t, p);
+        case 1: return packRGB(q, v, p);
+        case 2: return packRGB(p, v, t);
+        case 3: return packRGB(p, q, v);
+        case 4: return packRGB(t, p, v);
+        default: return packRGB(v, p, q);
+    }
+}
+
+// hsv8ToPacked() is hsvToPacked() for an 8-bit hue (0-255 is one full turn)
+constexpr uint32_t hsv8ToPacked(uint8_t hue, uint8_t s, uint8_t v) {
+    return hsvToPacked(uint16_t(hue) << 8, s, v);
+}
+
+// Gamma 2.2 correction table, built at compile time. x^2.2 is computed as x^2 * x^0.2, with the fifth root found by
+// Newton's method since std::pow is not constexpr.
+constexpr std::array<uint8_t, 256> makeGammaTable() {
+    std::array<uint8_t, 256> table{};
+    for (int i = 0; i < 256; ++i) {
+        double x = i / 255.0;
+        double root = 1.0;
+        for (int n = 0; n < 40 && i > 0; ++n) {
+            root = (4 * root + x / (root * root * root * root)) / 5;
+        }
+        double y = (i > 0) ? x * x * root : 0.0;
+        table[i] = uint8_t(y * 255 + 0.5);
+    }
+    return table;
+}
+inline constexpr std::array<uint8_t, 256> GAMMA_TABLE = makeGammaTable();
+
+// -- Colour order --
+
+// Order in which a strip expects the colour channels. WS2812B strips are GRB. RGBW strips (e.g. SK6812) also take a
+// white channel after the three colours.
+enum class ColorOrder : uint8_t {
+    RGB,
+    GRB,
+    BGR,
+};
+
+// Shift of red, green and blue in the word sent to the PIO, for each ColorOrder. The PIO sends the top 24 bits (32
+// with white) most significant bit first, so the first channel on the wire goes in the top byte.
+inline constexpr uint8_t COLOR_ORDER_SHIFTS[3][3] = {
+    {24, 16, 8}, // RGB
+    {16, 24, 8}, // GRB
+    {8, 16, 24}, // BGR
+};
+
+// PixelLayout packs 0xWWRRGGBB colours into PIO words for one colour order, with the shifts fixed at compile time
+template <ColorOrder Order, bool HasWhite>
+struct PixelLayout {
+    static constexpr uint32_t RED_SHIFT = COLOR_ORDER_SHIFTS[size_t(Order)][0];
+    static constexpr uint32_t GREEN_SHIFT = COLOR_ORDER_SHIFTS[size_t(Order)][1];
+    static constexpr uint32_t BLUE_SHIFT = COLOR_ORDER_SHIFTS[size_t(Order)][2];
+    static constexpr uint32_t WHITE_MASK = HasWhite ? 0xFF : 0; // White goes in the low byte, after the colours
+
+    static constexpr uint32_t pack(uint32_t color) {
+        return (uint32_t(packedRed(color)) << RED_SHIFT) | (uint32_t(packedGreen(color)) << GREEN_SHIFT) |
+               (uint32_t(packedBlue(color)) << BLUE_SHIFT) | (packedWhite(color) & WHITE_MASK);
+    }
+
+    // pack() with every channel passed through a lookup table (e.g. brightness and gamma)
+    static constexpr uint32_t pack(uint32_t color, const uint8_t* table) {
+        return (uint32_t(table[packedRed(color)]) << RED_SHIFT) | (uint32_t(table[packedGreen(color)]) << GREEN_SHIFT) |
+               (uint32_t(table[packedBlue(color)]) << BLUE_SHIFT) | (table[packedWhite(color)] & WHITE_MASK);
+    }
+};
+
+// packPixels() packs [count] colours into PIO words, reading [src] with a stride of [step] (-1 walks backwards) and
+// passing each channel through [table] unless it is null
+template <ColorOrder Order, bool HasWhite>
+void packPixels(const uint32_t* src, ptrdiff_t step, uint32_t* dst, size_t count, const uint8_t* table) {
+    using Layout = PixelLayout<Order, HasWhite>;
+    if (table) {
+        for (size_t i = 0; i < count; ++i, src += step) {
+            dst[i] = Layout::pack(*src, table);
+        }
+    } else {
+        for (size_t i = 0; i < count; ++i, src += step) {
+            dst[i] = Layout::pack(*src);
+        }
+    }
+}
+
+// The packPixels() specialisation for a colour order chosen at run time
+typedef void (*PixelPacker)(const uint32_t* src, ptrdiff_t step, uint32_t* dst, size_t count, const uint8_t* table);
+PixelPacker pixelPackerFor(ColorOrder order, bool hasWhite);
+
+// -- Output mapping --
+
+// A physical LED output: one WS2812 data pin, driven by its own PIO state machine and DMA channel. Outputs are sent
+// side by side, so a frame takes as long as the longest output rather than the total number of LEDs.
+struct LEDOutput {
+    unsigned int pin;
+    PIO pio; // PIO block (pio0 or pio1)
+    int sm;  // State machine, or -1 to claim any free one
+};
+
+// A run of [count] logical LEDs starting at [first], sent on output number [output]. Segments on the same output are
+// chained in the order given, and a reversed segment is sent last LED first (e.g. for serpentine wiring).
+struct LEDSegment {
+    int first;
+    int count;
+    int output;
+    bool reversed;
+};
 
 // -- LED Driver Classes --
 
+// WS2812Chain sends frames of packed words to one LED chain: a PIO state machine running the WS2812 program, fed from
+// a buffer by a DMA channel. It enforces the latch time between frames.
+class WS2812Chain {
+    private:
+        // Time the WS2812 line must be held low for the LEDs to latch a frame, plus the time taken by the final word to
+        // leave the PIO shift register (24 or 32 bits at 800 kHz)
+        static constexpr int64_t LATCH_TIME_US = 280;
+        static constexpr int64_t WORD_TIME_US = 30;
+        static constexpr int64_t RGBW_WORD_TIME_US = 40;
+
+        LEDOutput output;
+        unsigned int sm;
+        int dmaChannel; // -1 until init() is called
+        bool rgbw;
+        const uint32_t* buffer;
+        size_t length;
+
+        // Frame output state, used to enforce the latch time
+        bool frameInFlight;
+        bool latchStarted;
+        absolute_time_t latchStart;
+
+    public:
+        WS2812Chain();
+
+        // init() starts the WS2812 program on the output's state machine (claiming a free one if output.sm is -1) and
+        // claims a DMA channel to send [length] words from [buffer]. rgbw selects 32-bit words for RGBW strips.
+        void init(const LEDOutput& output, bool rgbw, const uint32_t* buffer, size_t length);
+
+        // arm() loads the DMA channel with the next frame without starting it, and returns the channel's bit for
+        // dma_start_channel_mask(), so several chains can be started in the same cycle
+        uint32_t arm();
+
+        // arm(words) loads only the first [words] words of the buffer. The LEDs past them keep their colours, since
+        // each LED only passes data on once it has taken its own.
+        uint32_t arm(size_t words);
+
+        // start() sends the next frame on this chain alone
+        void start();
+
+        // isFrameDone() returns true once the last frame has been sent and the latch time has elapsed
+        bool isFrameDone();
+};
+
+class LEDController;
+
 // Single LED class to represent an individual LED
+// An LED is a lightweight view onto its controller's frame buffers; it does not own any storage itself.
 class LED {
     private:
-        // LED number and its RGB color values
+        // Controller that stores this LED's colours, and the LED number (its index in the controller)
+        LEDController* controller;
         int led_num;
-        uint8_t red, green, blue;
-        std::vector<uint8_t> applied_color;
     public:
-        // Constructor to initialize LED [led_num]
-        LED(int led_num);
+        // Constructor to create a view of LED [led_num] in [controller]
+        LED(LEDController* controller, int led_num);
 
         // Set the color of the LED
         // Accepts RGB values in the range 0-255
         void setColor(uint8_t r, uint8_t g, uint8_t b);
 
         // formatColor() returns the color in a format suitable for WS2812
-        // The format is a 32-bit integer where the first byte is red, second byte is green,
-        // and third byte is blue.
+        // The format is the 32-bit word sent to the PIO, with the channels in the controller's colour order from the
+        // top byte down (e.g. green, red, blue for a GRB strip).
         // This is used to send the color data to the LED strip.
         uint32_t formatColor() const;
 
+        // setPackedColor() sets the color from a packed 0xWWRRGGBB value
+        void setPackedColor(uint32_t color);
+
+        // packedColor() returns the pending color packed as 0xWWRRGGBB
+        uint32_t packedColor() const;
+
         // RGBColor() returns the RGB color as a vector
+        // Prefer packedColor() in hot paths, as this allocates.
         std::vector<uint8_t> RGBColor() const;
 
-        // applyColor() applies the current color to the LED
+        // applyColor() marks the current color as shown by the LED
+        // The controller does this for every LED it sends, and skips LEDs whose colour is already applied, so call it
+        // directly only for a colour the LED already shows.
         void applyColor();
 
+        // packedAppliedColor() returns the currently applied color packed as 0xWWRRGGBB
+        uint32_t packedAppliedColor() const;
+
         // getAppliedColor() returns the currently applied color
+        // Prefer packedAppliedColor() in hot paths, as this allocates.
         std::vector<uint8_t> getAppliedColor() const;
 
         // LEDNum() returns the LED number
         int LEDNum() const;
 };
 
+// A ReportSink receives a status report in pieces as it is formatted, e.g. to pass it on to the log or a UART. The
+// text is not NUL terminated and is only valid during the call.
+typedef void (*ReportSink)(void* context, const char* text, size_t length);
+
+// Counters kept by LEDController::updateLEDsAsync()
+struct LEDFrameStats {
+    uint32_t framesSent;    // Frames that changed at least one LED and were sent
+    uint32_t framesSkipped; // Frames with nothing to send, which left the outputs idle
+    uint32_t pixelsSent;    // LEDs sent, over all outputs
+    uint32_t pixelsSaved;   // LEDs left out: unchanged LEDs past the last change on a chain, and all of a skipped frame
+};
+
 // LEDController class to manage a dynamic number of LEDs
+// The number of LEDs and the output mapping are chosen at run time. For a fixed strip with no heap use, see
+// StaticLEDController in StaticLEDController.h; both pack frames with the same compile-time specialised packPixels().
 class LEDController {
     private:
         // Default number of LEDs
         static constexpr int DEFAULT_NUM_LEDS = 12;
 
-        // Vector to hold the state of each LED
+        // Pending (set but not yet applied) and applied colours of every LED, packed as 0xWWRRGGBB
+        std::vector<uint32_t> pendingColors;
+        std::vector<uint32_t> appliedColors;
+
+        // Views onto the colour buffers, handed out by getLED()
         std::vector<LED> LEDs;
 
+        // Lookup table applied to every channel as frames are packed: gamma correction and brightness combined.
+        // outputTableIdentity lets packing skip the lookups when neither is in use.
+        std::array<uint8_t, 256> outputTable;
+        bool outputTableIdentity;
+        uint8_t brightness;
+        bool gammaCorrection;
+
+        // Whether the strips take a white channel, and the packing function specialised for their colour order
+        bool hasWhite;
+        PixelPacker packer;
+
+        // An output and the run of frameBuffer it sends
+        struct OutputChannel {
+            LEDOutput output;
+            WS2812Chain chain;
+            size_t offset;
+            size_t length;
+            size_t sendLength; // Words to send in the frame being prepared
+        };
+
+        // Where each logical LED goes: the outputs, the segments mapped onto them and the position of each segment in
+        // frameBuffer
+        std::vector<OutputChannel> outputs;
+        std::vector<LEDSegment> segments;
+        std::vector<size_t> segmentOffsets;
+
+        // Packed frame, each output's words stored together, that the DMA channels stream into the PIO TX FIFOs
+        std::vector<uint32_t> frameBuffer;
+
+        // Set once initLEDs() has started the outputs
+        bool initialised;
+
+        // LEDs written since the last frame was sent (none when dirtyFirst > dirtyLast). The range can include LEDs
+        // set back to their applied colour, which the next frame trims off its ends.
+        int dirtyFirst;
+        int dirtyLast;
+
+        // Set when every LED has to be packed and sent again: before the first frame, and after a change to the
+        // output mapping, brightness or gamma
+        bool fullFrame;
+
+        LEDFrameStats frameStats;
+
+        // markDirty() adds LEDs [first] to [last] to the range the next frame sends
+        void markDirty(int first, int last) {
+            dirtyFirst = std::min(dirtyFirst, first);
+            dirtyLast = std::max(dirtyLast, last);
+        }
+
+        // rebuildOutputTable() recomputes outputTable after a gamma or brightness change
+        void rebuildOutputTable();
+
+        // layoutFrame() places each output's segments in frameBuffer
+        void layoutFrame();
+
+        // Formatting for the status reports, into a fixed buffer or a sink (see LEDs.cpp)
+        struct ReportWriter;
+        void statusLine(ReportWriter& writer, int index) const;
+        void actionLine(ReportWriter& writer, int index) const;
+        void statusReport(ReportWriter& writer, const int* indices, size_t count) const;
+        void actionReport(ReportWriter& writer, const int* indices, size_t count) const;
+        void summaryReport(ReportWriter& writer) const;
+        void dirtyReport(ReportWriter& writer) const;
+
+        friend class LED;
+
     public:
-        // Constructor to initialize the LEDController with a specified number of LEDs
-        LEDController(int num_leds = DEFAULT_NUM_LEDS);
+        // Constructor to initialize the LEDController with a specified number of LEDs, for strips that take the
+        // colours in [order] (plus white after them if [hasWhite])
+        LEDController(int num_leds = DEFAULT_NUM_LEDS, ColorOrder order = ColorOrder::GRB, bool hasWhite = false);
+
+        // The LED views point back at their controller, and the controller owns a DMA channel, so it cannot be copied
+        LEDController(const LEDController&) = delete;
+        LEDController& operator=(const LEDController&) = delete;
+
+        // configureOutputs() splits the LEDs across several outputs, e.g. one strip per pin. Every LED normally
+        // appears in one segment. By default all the LEDs are sent on LED_PIN with pio0. Call this before initLEDs();
+        // returns false (leaving the mapping unchanged) if it is called too late or a segment is out of range.
+        bool configureOutputs(const std::vector<LEDOutput>& newOutputs, const std::vector<LEDSegment>& newSegments);
 
         // initLEDs() initializes the functionality of the LEDs
         void initLEDs();
@@ -62,26 +375,89 @@ class LEDController {
         // setLEDGroup() sets a group of LEDs to the specified color
         void setLEDGroup(const std::vector<int>& indices, uint8_t r, uint8_t g, uint8_t b);
 
+        // fillRange() sets [count] LEDs starting at [first] to a packed 0xWWRRGGBB colour
+        void fillRange(int first, int count, uint32_t color);
+
         // resetLEDs() resets all LEDs to off state
         void resetLEDs();
 
-        // updateLEDs() updates the state of all LEDs
+        // updateLEDs() updates the state of all LEDs and waits until the frame has been latched
         void updateLEDs();
 
+        // updateLEDsAsync() packs the LEDs that changed since the last frame into the frame buffer and starts a DMA
+        // transfer to each LED chain that has changes, returning immediately. Each chain is sent up to its last
+        // changed LED only, and the sent colours are marked as applied. If nothing changed, nothing is sent.
+        // Returns false (and sends nothing) if the previous frame is still in flight.
+        bool updateLEDsAsync();
+
+        // markAllDirty() makes the next frame resend every LED, e.g. after the strips have lost power
+        void markAllDirty();
+
+        // getFrameStats() returns the frame and pixel counters since the controller was created
+        LEDFrameStats getFrameStats() const;
+
+        // isFrameDone() returns true once the last frame has been sent and the latch time has elapsed
+        bool isFrameDone();
+
+        // waitForFrame() blocks until isFrameDone() returns true
+        void waitForFrame();
+
         // HSVtoRGB(int h, int s, int v) converts HSV values to RGB
+        // h is in degrees (0-359), s and v are 0-255. Prefer hsvToPacked(), which does not allocate.
         std::vector<uint8_t> HSVtoRGB(int h, int s, int v) const;
 
+        // setHSVRange() converts [count] HSV colours and writes them to the LEDs starting at [first] in one pass.
+        // LEDs past the end of the strip are ignored.
+        void setHSVRange(int first, const HSV* colors, int count);
+
+        // setBrightness() scales every LED's output (255 is full brightness). Colours are stored unscaled.
+        void setBrightness(uint8_t value);
+
+        // setGammaCorrection() enables gamma 2.2 correction of the output, for perceptually even fades
+        void setGammaCorrection(bool enabled);
+
         // - LED status functions -
 
         // count() returns the number of LEDs managed by this controller
         int count() const;
 
         // getStatus(const std::vector<int>& indices) returns the status of the specified LEDs
+        // This allocates a string per LED; prefer writeStatus() for polling.
         std::vector<std::string> getStatus(const std::vector<int>& indices) const;
 
         // getAction(const std::vector<int>& indices) returns the action for the specified LEDs
+        // This allocates a string per LED; prefer writeAction() for polling.
         std::vector<std::string> getAction(const std::vector<int>& indices) const;
 
         // getSummary() returns a summary of the LEDs
+        // This allocates; prefer writeSummary() for polling.
         std::string getSummary() const;
+
+        // - Allocation-free reporting -
+        // Each report comes in two forms. The buffer form writes at most [size] - 1 characters plus a NUL to [buffer]
+        // and, like snprintf(), returns the length of the whole report, so a result of [size] or more means it was cut
+        // short. The sink form passes the whole report to [sink] in pieces of up to 64 characters. Neither uses the
+        // heap. Lines are the same as the vector functions above, each ended by a newline.
+
+        // writeStatus() reports the pending colour of [count] LEDs listed in [indices]
+        size_t writeStatus(const int* indices, size_t count, char* buffer, size_t size) const;
+        void writeStatus(const int* indices, size_t count, ReportSink sink, void* context) const;
+
+        // writeAction() reports whether [count] LEDs listed in [indices] have a colour waiting to be applied
+        size_t writeAction(const int* indices, size_t count, char* buffer, size_t size) const;
+        void writeAction(const int* indices, size_t count, ReportSink sink, void* context) const;
+
+        // writeSummary() reports every LED's pending colour and action, as getSummary() does
+        size_t writeSummary(char* buffer, size_t size) const;
+        void writeSummary(ReportSink sink, void* context) const;
+
+        // writeDirty() reports only the LEDs whose pending colour differs from the applied one (see
+        // LED::applyColor()), with a run of neighbouring LEDs waiting for the same colour on one line (e.g.
+        // "LED 10-19: Pending RGB(255,0,0)"). It writes nothing when every LED is applied, so it is cheap enough to
+        // poll at high rates.
+        size_t writeDirty(char* buffer, size_t size) const;
+        void writeDirty(ReportSink sink, void* context) const;
+
+        // dirtyCount() returns the number of LEDs whose pending colour differs from the applied one
+        int dirtyCount() const;
 };
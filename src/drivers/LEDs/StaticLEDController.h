@@ -0,0 +1,108 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include "pico/stdlib.h"
+#include "LEDs.h"
+#include "drivers/Board/Board.h"
+
+// StaticLEDController drives one fixed strip of N LEDs with everything decided at compile time: the pixel and frame
+// buffers are std::arrays inside the object (so a global controller lives in .bss and never touches the heap), and the
+// colour order and white channel are template parameters, so packing compiles down to constant shifts.
+//
+// Unlike LEDController there are no LED views, output mapping, brightness or gamma; colours are sent as set. Example:
+//
+//     static StaticLEDController<60, ColorOrder::GRB, true> strip;
+//     strip.init(LED_PIN);
+//     strip.setColor(0, 255, 0, 0, 32);
+//     strip.update();
+template <size_t N, ColorOrder Order = ColorOrder::GRB, bool HasWhite = false>
+class StaticLEDController {
+    private:
+        // Colours as set, packed as 0xWWRRGGBB
+        std::array<uint32_t, N> pixels;
+
+        // Packed words that the DMA channel streams into the PIO TX FIFO
+        std::array<uint32_t, N> frame;
+
+        WS2812Chain chain;
+        bool initialised;
+
+    public:
+        StaticLEDController() : pixels(), frame(), chain(), initialised(false) {}
+
+        // The chain's DMA channel reads from this object's frame buffer, so it cannot be copied
+        StaticLEDController(const StaticLEDController&) = delete;
+        StaticLEDController& operator=(const StaticLEDController&) = delete;
+
+        // init() starts the strip on [pin], using state machine [sm] of [pio] (-1 claims any free one)
+        void init(unsigned int pin = LED_PIN, PIO pio = pio0, int sm = -1) {
+            chain.init({pin, pio, sm}, HasWhite, frame.data(), N);
+            initialised = true;
+        }
+
+        // setColor() sets LED [index] (ignored if out of range). The white level is only sent to RGBW strips.
+        void setColor(size_t index, uint8_t r, uint8_t g, uint8_t b, uint8_t w = 0) {
+            if (index < N) {
+                pixels[index] = packRGBW(r, g, b, w);
+            }
+        }
+
+        // setPackedColor() sets LED [index] from a packed 0xWWRRGGBB colour (ignored if out of range)
+        void setPackedColor(size_t index, uint32_t color) {
+            if (index < N) {
+                pixels[index] = color;
+            }
+        }
+
+        // packedColor() returns the colour of LED [index] packed as 0xWWRRGGBB
+        uint32_t packedColor(size_t index) const {
+            return index < N ? pixels[index] : 0;
+        }
+
+        // fill() sets every LED to a packed 0xWWRRGGBB colour
+        void fill(uint32_t color) {
+            pixels.fill(color);
+        }
+
+        // clear() turns every LED off
+        void clear() {
+            pixels.fill(0);
+        }
+
+        // updateAsync() packs the colours and starts sending them, returning immediately. Returns false (and sends
+        // nothing) before init() or while the previous frame is still in flight.
+        bool updateAsync() {
+            if (!initialised || !chain.isFrameDone()) {
+                return false;
+            }
+            packPixels<Order, HasWhite>(pixels.data(), 1, frame.data(), N, nullptr);
+            chain.start();
+            return true;
+        }
+
+        // update() sends the colours and waits until the LEDs have latched them
+        void update() {
+            waitForFrame();
+            updateAsync();
+            waitForFrame();
+        }
+
+        // isFrameDone() returns true once the last frame has been sent and the latch time has elapsed
+        bool isFrameDone() {
+            return chain.isFrameDone();
+        }
+
+        // waitForFrame() blocks until isFrameDone() returns true
+        void waitForFrame() {
+            while (!chain.isFrameDone()) {
+                tight_loop_contents();
+            }
+        }
+
+        // count() returns the number of LEDs
+        static constexpr size_t count() {
+            return N;
+        }
+};
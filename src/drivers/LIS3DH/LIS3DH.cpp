@@ -3,13 +3,17 @@
 #include <stdio.h>
 #include <vector>
 #include "pico/stdlib.h"
+#include "pico/time.h"
 #include "hardware/gpio.h"
 #include "hardware/pio.h"
+#include "hardware/sync.h"
+#include "hardware/dma.h"
 
 #include "WS2812.pio.h" // This header file gets produced during compilation from the WS2812.pio file
 
 #include "hardware/i2c.h"
 #include "drivers/logging/logging.h"
+#include "drivers/instrumentation/instrumentation.h"
 
 #include "drivers/Board/Board.h"
 
@@ -17,11 +21,23 @@
 
 // --- LIS3DH Driver Class Functions ---
 
-void accelDriver::accelInit() {
-    // Initialize the I2C interface for the LIS3DH accelerometer
+// Timeout for a blocking transfer: a byte takes 22.5 us at 400 kHz, so allow twice that plus time for the start
+#define I2C_TIMEOUT_BASE_US 500
+#define I2C_TIMEOUT_PER_BYTE_US 50
+
+static unsigned int transferTimeoutUs(size_t length) {
+    return I2C_TIMEOUT_BASE_US + I2C_TIMEOUT_PER_BYTE_US * (unsigned int)length;
+}
+
+void accelDriver::initBus() {
     i2c_init(I2C_INSTANCE, 400 * 1000); // 400 kHz I2C speed
     gpio_set_function(ACCEL_SDA_PIN, GPIO_FUNC_I2C);
     gpio_set_function(ACCEL_SCL_PIN, GPIO_FUNC_I2C);
+}
+
+void accelDriver::accelInit() {
+    // Initialize the I2C interface for the LIS3DH accelerometer
+    initBus();
 
     // read the WHO_AM_I register to verify communication
     uint8_t waiOut; // Allocate variable for the output buffer
@@ -55,65 +71,689 @@ void accelDriver::accelInit() {
     }
 }
 
+bool accelDriver::busHeldByTransfer() const {
+    if (transferStatus != AccelTransferStatus::BUSY) {
+        return false;
+    }
+    log(LogLevel::ERROR, "LIS3DH bus is busy with an asynchronous transfer");
+    return true;
+}
+
 bool accelDriver::writeRegister(uint8_t reg, uint8_t data) {
+    if (busHeldByTransfer()) {
+        return false;
+    }
     uint8_t buf[2];
     buf[0] = reg;
     buf[1] = data;
 
     // Write data to the specified register of the LIS3DH
-    int bytes_written = i2c_write_blocking(I2C_INSTANCE, I2C_ADDRESS, buf, 2, false);
+    int bytes_written = i2c_write_timeout_us(I2C_INSTANCE, I2C_ADDRESS, buf, 2, false, transferTimeoutUs(2));
     if (bytes_written != 2) {
         log(LogLevel::ERROR, "Failed to write to LIS3DH accelerometer");
+        if (bytes_written == PICO_ERROR_TIMEOUT) {
+            recoverBus();
+        }
         return false; // Return false if the write operation failed
     }
     return true; // Return true if the write operation was successful
 }
 
 bool accelDriver::readRegister(uint8_t reg, uint8_t *data, size_t length = 1) {
-    if (1 != i2c_write_blocking(I2C_INSTANCE, I2C_ADDRESS, &reg, 1, true)) {
+    INSTRUMENT_SCOPE(Probe::ACCEL_READ_REGISTER);
+    if (busHeldByTransfer()) {
+        return false;
+    }
+    int result = i2c_write_timeout_us(I2C_INSTANCE, I2C_ADDRESS, &reg, 1, true, transferTimeoutUs(1));
+    if (result != 1) {
         // You need to pass the pointer to the register address because
-        // i2c_write_blocking expects a pointer to a buffer of data.
+        // i2c_write_timeout_us expects a pointer to a buffer of data.
         log(LogLevel::ERROR, "lis3dh::read_registers: Failed to select register address.");
+        if (result == PICO_ERROR_TIMEOUT) {
+            recoverBus();
+        }
         return false;
     }
 
-    // Now read the data
-    int bytes_read = i2c_read_blocking(I2C_INSTANCE, I2C_ADDRESS, data, length, true);
-    if (bytes_read != length) {
+    // Now read the data, releasing the bus afterwards
+    int bytes_read = i2c_read_timeout_us(I2C_INSTANCE, I2C_ADDRESS, data, length, false, transferTimeoutUs(length));
+    if (bytes_read != (int)length) {
         log(LogLevel::ERROR, "lis3dh::read_registers: Failed to read data.");
+        if (bytes_read == PICO_ERROR_TIMEOUT) {
+            recoverBus();
+        }
         return false;
     }
 
     return true; // Return true if the read operation was successful
 }
 
+bool accelDriver::modifyRegister(uint8_t reg, uint8_t mask, uint8_t value) {
+    uint8_t current;
+    if (!readRegister(reg, &current, 1)) {
+        return false;
+    }
+    return writeRegister(reg, (current & ~mask) | (value & mask));
+}
+
 std::vector<float> accelDriver::readAccelerometer() {
-    uint8_t data[6]; // Buffer to hold the accelerometer data
+    AccelSample sample = readSample();
+    if (sample.status != AccelStatus::OK) {
+        return {}; // Let the caller detect the failure rather than converting garbage
+    }
+
+    return {sample.x_mg * 0.001f, sample.y_mg * 0.001f, sample.z_mg * 0.001f}; // Return the accelerometer data as a vector of floats
+}
+
+float accelDriver::convertToGs(int16_t rawValue) {
+    // Convert the raw accelerometer value to Gs (gravitational units)
+    // The mg/LSB depends on the resolution and full-scale range, e.g. 4 mg in normal mode at ±2g
+    return (float)(rawValue * sensitivityMg) * 0.001f;
+}
+
+// --- Resolution and conversion ---
+
+// CTRL_REG1 low-power enable and CTRL_REG4 high-resolution and full-scale bits
+#define CTRL_REG1_LPEN 0x08
+#define CTRL_REG4_HR 0x08
+#define CTRL_REG4_FS_MASK 0x30
+
+// Sensitivity in mg/digit, indexed by [resolution][range] (LIS3DH datasheet table 4)
+static const uint8_t sensitivityTable[3][4] = {
+    {16, 32, 64, 192}, // Low-power (8-bit)
+    {4, 8, 16, 48},    // Normal (10-bit)
+    {1, 2, 4, 12},     // High-resolution (12-bit)
+};
+
+// Bits to discard from the left-justified output registers, indexed by resolution
+static const uint8_t shiftTable[3] = {8, 6, 4};
+
+bool accelDriver::configure(AccelResolution newResolution, AccelRange newRange) {
+    uint8_t lpen = (newResolution == AccelResolution::LOW_POWER_8BIT) ? CTRL_REG1_LPEN : 0;
+    uint8_t hr = (newResolution == AccelResolution::HIGH_RES_12BIT) ? CTRL_REG4_HR : 0;
+
+    if (!modifyRegister(CTRL_REG1, CTRL_REG1_LPEN, lpen) ||
+        !modifyRegister(CTRL_REG4, CTRL_REG4_HR | CTRL_REG4_FS_MASK, hr | (static_cast<uint8_t>(newRange) << 4))) {
+        log(LogLevel::ERROR, "Failed to configure LIS3DH resolution and range");
+        return false;
+    }
+
+    resolution = newResolution;
+    range = newRange;
+    rawShift = shiftTable[static_cast<uint8_t>(resolution)];
+    sensitivityMg = sensitivityTable[static_cast<uint8_t>(resolution)][static_cast<uint8_t>(range)];
+    return true;
+}
+
+AccelSample accelDriver::readSample() {
+    AccelRawFrame frame;
+    AccelSample sample = {0, 0, 0, AccelStatus::READ_FAILED, (uint32_t)to_us_since_boot(get_absolute_time())};
 
     // Read 6 bytes of data from the LIS3DH accelerometer
-    if (!readRegister(READ_X_L | 0x80, data, 6)) {
+    if (!readRegister(READ_X_L | AUTO_INCREMENT, reinterpret_cast<uint8_t *>(&frame), sizeof(frame))) {
         log(LogLevel::ERROR, "Failed to read accelerometer data");
+        return sample;
     }
 
-    // Convert the raw data to 16-bit integers
-    int16_t x = (int16_t)(data[0] | (data[1] << 8)) >> 4; // Combine low and high bytes for X-axis
-    int16_t y = (int16_t)(data[2] | (data[3] << 8)) >> 4; // Combine low and high bytes for Y-axis
-    int16_t z = (int16_t)(data[4] | (data[5] << 8)) >> 4; // Combine low and high bytes for Z-axis
+    convertFrames(&frame, &sample, 1, sample.timestamp_us);
+    return sample;
+}
 
-    float xGs = convertToGs(x); // Convert raw X-axis data to Gs
-    float yGs = convertToGs(y); // Convert raw Y-axis data to Gs
-    float zGs = convertToGs(z); // Convert raw Z-axis data to Gs
+void accelDriver::convertFrames(const AccelRawFrame *frames, AccelSample *samples, size_t count, uint32_t timestamp_us) const {
+    // Arithmetic shift keeps the sign, and the multiply stays in integers so no soft-float is needed
+    const int shift = rawShift;
+    const int sensitivity = sensitivityMg;
+    uint32_t timestamp = timestamp_us - (uint32_t)(count - 1) * samplePeriodUs;
 
-    float tempX = float(x);
-    float tempY = float(y);
-    float tempZ = float(z);
+    for (size_t i = 0; i < count; ++i) {
+        samples[i].x_mg = (int16_t)((frames[i].x >> shift) * sensitivity);
+        samples[i].y_mg = (int16_t)((frames[i].y >> shift) * sensitivity);
+        samples[i].z_mg = (int16_t)((frames[i].z >> shift) * sensitivity);
+        samples[i].status = AccelStatus::OK;
+        samples[i].timestamp_us = timestamp;
+        timestamp += samplePeriodUs;
+    }
+}
+
+void accelDriver::convertFramesToGs(const AccelRawFrame *frames, float *gs, size_t count) const {
+    const int shift = rawShift;
+    const float scale = sensitivityMg * 0.001f;
 
-    return {xGs, yGs, zGs}; // Return the accelerometer data as a vector of floats
+    for (size_t i = 0; i < count; ++i) {
+        gs[3 * i + 0] = (frames[i].x >> shift) * scale;
+        gs[3 * i + 1] = (frames[i].y >> shift) * scale;
+        gs[3 * i + 2] = (frames[i].z >> shift) * scale;
+    }
 }
 
-float accelDriver::convertToGs(int16_t rawValue) {
-    // Convert the raw accelerometer value to Gs (gravitational units)
-    // 1LSB = 16mGs
-    // This conversion assumes the LIS3DH is configured for ±2g full scale
-    return (float)rawValue * 0.016f;
+// --- FIFO streaming ---
+
+// FIFO_SRC_REG bit definitions
+#define FIFO_SRC_WTM 0x80
+#define FIFO_SRC_OVRN 0x40
+#define FIFO_SRC_EMPTY 0x20
+#define FIFO_SRC_FSS_MASK 0x1F
+
+// CTRL_REG5 FIFO enable bit
+#define CTRL_REG5_FIFO_EN 0x40
+
+// Decode the number of unread samples from FIFO_SRC_REG. FSS only counts to 31, so a full FIFO is flagged by OVRN.
+static size_t fifoSourceLevel(uint8_t fifoSrc) {
+    if (fifoSrc & FIFO_SRC_EMPTY) {
+        return 0;
+    }
+    if (fifoSrc & FIFO_SRC_OVRN) {
+        return ACCEL_FIFO_DEPTH;
+    }
+    return fifoSrc & FIFO_SRC_FSS_MASK;
+}
+
+// Sample period in microseconds, indexed by the ODR field. The last entry depends on the mode (1.344 kHz normally,
+// 5.376 kHz in low-power mode) and is handled in setDataRate().
+static const uint32_t samplePeriodTable[10] = {0, 1000000, 100000, 40000, 20000, 10000, 5000, 2500, 625, 744};
+
+bool accelDriver::setDataRate(AccelDataRate rate) {
+    // ODR occupies the top nibble of CTRL_REG1
+    if (!modifyRegister(CTRL_REG1, 0xF0, static_cast<uint8_t>(rate) << 4)) {
+        log(LogLevel::ERROR, "Failed to set LIS3DH data rate");
+        return false;
+    }
+
+    samplePeriodUs = samplePeriodTable[static_cast<uint8_t>(rate)];
+    if (rate == AccelDataRate::HZ_1344_LP_5376 && resolution == AccelResolution::LOW_POWER_8BIT) {
+        samplePeriodUs = 186;
+    }
+    return true;
+}
+
+bool accelDriver::enableFifo(AccelFifoMode mode, uint8_t watermark) {
+    // Passing through bypass mode empties the FIFO and re-arms the FIFO and stream-to-FIFO modes
+    if (!writeRegister(FIFO_CTRL_REG, static_cast<uint8_t>(AccelFifoMode::BYPASS))) {
+        return false;
+    }
+    if (!modifyRegister(CTRL_REG5, CTRL_REG5_FIFO_EN, CTRL_REG5_FIFO_EN)) {
+        log(LogLevel::ERROR, "Failed to enable LIS3DH FIFO");
+        return false;
+    }
+    if (!writeRegister(FIFO_CTRL_REG, static_cast<uint8_t>(mode) | (watermark & FIFO_SRC_FSS_MASK))) {
+        log(LogLevel::ERROR, "Failed to configure LIS3DH FIFO mode");
+        return false;
+    }
+    return true;
+}
+
+bool accelDriver::disableFifo() {
+    if (!writeRegister(FIFO_CTRL_REG, static_cast<uint8_t>(AccelFifoMode::BYPASS))) {
+        return false;
+    }
+    return modifyRegister(CTRL_REG5, CTRL_REG5_FIFO_EN, 0);
+}
+
+int accelDriver::fifoLevel() {
+    uint8_t fifoSrc;
+    if (!readRegister(FIFO_SRC_REG, &fifoSrc, 1)) {
+        return -1;
+    }
+    return fifoSourceLevel(fifoSrc);
+}
+
+size_t accelDriver::drainFifo(AccelRawFrame *frames, size_t maxFrames) {
+    INSTRUMENT_SCOPE(Probe::ACCEL_DRAIN_FIFO);
+    uint8_t fifoSrc;
+    if (!readRegister(FIFO_SRC_REG, &fifoSrc, 1)) {
+        return 0;
+    }
+
+    size_t count = fifoSourceLevel(fifoSrc);
+    if (fifoSrc & FIFO_SRC_OVRN) {
+        fifoOverruns++;
+    }
+    if (count > maxFrames) {
+        count = maxFrames;
+    }
+    if (count == 0) {
+        return 0;
+    }
+
+    // With the FIFO enabled the register address wraps from OUT_Z_H back to OUT_X_L, so one auto-increment read
+    // pops [count] samples in order. AccelRawFrame matches the register layout, so read straight into the caller's
+    // buffer.
+    if (!readRegister(READ_X_L | AUTO_INCREMENT, reinterpret_cast<uint8_t *>(frames), count * sizeof(AccelRawFrame))) {
+        log(LogLevel::ERROR, "Failed to read LIS3DH FIFO");
+        return 0;
+    }
+    return count;
+}
+
+uint32_t accelDriver::fifoOverrunCount() const {
+    return fifoOverruns;
+}
+
+// --- Asynchronous transfers ---
+
+// A transfer is a list of commands for the I2C block: the register address to write, then a read command per byte. One
+// DMA channel feeds the commands into DATA_CMD and a second copies the received bytes out, each paced by the block's
+// DREQ, so the whole transfer runs without the core.
+
+void accelDriver::claimTransferChannels() {
+    if (dmaCommandChannel >= 0) {
+        return;
+    }
+    i2c_hw_t *hw = i2c_get_hw(I2C_INSTANCE);
+
+    dmaCommandChannel = dma_claim_unused_channel(true);
+    dma_channel_config config = dma_channel_get_default_config(dmaCommandChannel);
+    channel_config_set_transfer_data_size(&config, DMA_SIZE_32);
+    channel_config_set_read_increment(&config, true);
+    channel_config_set_write_increment(&config, false);
+    channel_config_set_dreq(&config, i2c_get_dreq(I2C_INSTANCE, true));
+    dma_channel_configure(dmaCommandChannel, &config, &hw->data_cmd, transferCommands, 0, false);
+
+    dmaDataChannel = dma_claim_unused_channel(true);
+    config = dma_channel_get_default_config(dmaDataChannel);
+    channel_config_set_transfer_data_size(&config, DMA_SIZE_8);
+    channel_config_set_read_increment(&config, false);
+    channel_config_set_write_increment(&config, true);
+    channel_config_set_dreq(&config, i2c_get_dreq(I2C_INSTANCE, false));
+    dma_channel_configure(dmaDataChannel, &config, nullptr, &hw->data_cmd, 0, false);
+}
+
+bool accelDriver::startRead(uint8_t reg, uint8_t *data, size_t length, uint32_t timeout_us,
+                            AccelTransferCallback callback, void *context) {
+    if (transferStatus == AccelTransferStatus::BUSY || length == 0 || length > ACCEL_MAX_TRANSFER) {
+        return false;
+    }
+    claimTransferChannels();
+
+    // Select the register, then restart into a read with a stop after the last byte
+    transferCommands[0] = reg;
+    for (size_t i = 1; i <= length; ++i) {
+        transferCommands[i] = I2C_IC_DATA_CMD_CMD_BITS;
+    }
+    transferCommands[1] |= I2C_IC_DATA_CMD_RESTART_BITS;
+    transferCommands[length] |= I2C_IC_DATA_CMD_STOP_BITS;
+
+    // The target address can only be changed while the block is disabled. Re-enabling the DMA requests each time
+    // covers a re-initialisation by recoverBus().
+    i2c_hw_t *hw = i2c_get_hw(I2C_INSTANCE);
+    hw->enable = 0;
+    hw->tar = I2C_ADDRESS;
+    hw->dma_cr = I2C_IC_DMA_CR_TDMAE_BITS | I2C_IC_DMA_CR_RDMAE_BITS;
+    hw->enable = 1;
+    (void)hw->clr_tx_abrt; // Reading clears an abort left by an earlier transfer
+
+    transferStatus = AccelTransferStatus::BUSY;
+    transferDeadline = make_timeout_time_us(timeout_us);
+    transferCallback = callback;
+    transferContext = context;
+    transferStart = instrumentNow();
+
+    // Start both channels in the same cycle
+    dma_channel_set_write_addr(dmaDataChannel, data, false);
+    dma_channel_set_trans_count(dmaDataChannel, length, false);
+    dma_channel_set_read_addr(dmaCommandChannel, transferCommands, false);
+    dma_channel_set_trans_count(dmaCommandChannel, length + 1, false);
+    dma_start_channel_mask((1u << dmaDataChannel) | (1u << dmaCommandChannel));
+    return true;
+}
+
+AccelTransferStatus accelDriver::pollTransfer() {
+    if (transferStatus != AccelTransferStatus::BUSY) {
+        return transferStatus;
+    }
+
+    i2c_hw_t *hw = i2c_get_hw(I2C_INSTANCE);
+    if (!dma_channel_is_busy(dmaDataChannel)) {
+        finishTransfer(AccelTransferStatus::DONE);
+    } else if (hw->raw_intr_stat & I2C_IC_RAW_INTR_STAT_TX_ABRT_BITS) {
+        // The block flushes its commands after a NACK, so the data channel would never finish
+        log<LogLevel::ERROR>("LIS3DH transfer aborted, source 0x%x", (uint32_t)hw->tx_abrt_source);
+        dma_channel_abort(dmaCommandChannel);
+        dma_channel_abort(dmaDataChannel);
+        (void)hw->clr_tx_abrt;
+        finishTransfer(AccelTransferStatus::FAILED);
+    } else if (time_reached(transferDeadline)) {
+        log<LogLevel::ERROR>("LIS3DH transfer timed out, recovering the bus");
+        dma_channel_abort(dmaCommandChannel);
+        dma_channel_abort(dmaDataChannel);
+        recoverBus();
+        finishTransfer(AccelTransferStatus::TIMED_OUT);
+    }
+    return transferStatus;
+}
+
+void accelDriver::finishTransfer(AccelTransferStatus status) {
+    instrumentRecord(Probe::ACCEL_TRANSFER, transferStart);
+    transferStatus = status;
+
+    // The callback may start the next transfer, so it runs last
+    if (transferCallback) {
+        transferCallback(status, transferContext);
+    }
+}
+
+AccelTransferStatus accelDriver::waitTransfer() {
+    while (pollTransfer() == AccelTransferStatus::BUSY) {
+        tight_loop_contents();
+    }
+    return transferStatus;
+}
+
+// Half an SCL period for bit-banged recovery, giving 100 kHz
+#define RECOVERY_HALF_PERIOD_US 5
+
+bool accelDriver::recoverBus() {
+    busRecoveries++;
+
+    // Take the pins from the I2C block. SDA is left as an input so the sensor can release it.
+    i2c_deinit(I2C_INSTANCE);
+    gpio_init(ACCEL_SDA_PIN);
+    gpio_init(ACCEL_SCL_PIN);
+    gpio_put(ACCEL_SCL_PIN, 1);
+    gpio_set_dir(ACCEL_SCL_PIN, GPIO_OUT);
+
+    // A sensor stuck mid-byte holds SDA low until it has clocked out the rest of the byte and its ACK
+    for (int i = 0; i < 9 && !gpio_get(ACCEL_SDA_PIN); ++i) {
+        gpio_put(ACCEL_SCL_PIN, 0);
+        sleep_us(RECOVERY_HALF_PERIOD_US);
+        gpio_put(ACCEL_SCL_PIN, 1);
+        sleep_us(RECOVERY_HALF_PERIOD_US);
+    }
+    bool released = gpio_get(ACCEL_SDA_PIN);
+
+    // Send a STOP (SDA rising while SCL is high) so the sensor waits for a new transfer
+    gpio_put(ACCEL_SDA_PIN, 0);
+    gpio_set_dir(ACCEL_SDA_PIN, GPIO_OUT);
+    sleep_us(RECOVERY_HALF_PERIOD_US);
+    gpio_set_dir(ACCEL_SDA_PIN, GPIO_IN);
+    sleep_us(RECOVERY_HALF_PERIOD_US);
+
+    initBus();
+    if (!released) {
+        log(LogLevel::ERROR, "LIS3DH bus recovery failed: SDA is still held low");
+    }
+    return released;
+}
+
+uint32_t accelDriver::busRecoveryCount() const {
+    return busRecoveries;
+}
+
+// --- Interrupt driven sampling ---
+
+// CTRL_REG3 data interrupt bits, which enableInterrupt() owns. The rest route the event engines.
+#define CTRL_REG3_DATA_MASK 0x1E
+
+// Set from interrupt context, so these live outside the class in the style of the logging driver
+static volatile bool int1Pending = false;
+static volatile bool int2Pending = false;
+static volatile bool waitTimedOut = false;
+
+// GPIO interrupt handler. The SDK has a single callback for every pin, so check which one fired.
+static void accelGpioCallback(uint gpio, uint32_t events) {
+    if (gpio == ACCEL_INT1_PIN) {
+        int1Pending = true;
+    } else if (gpio == ACCEL_INT2_PIN) {
+        int2Pending = true;
+    }
+}
+
+// Alarm handler that ends a wait. Returning 0 stops the alarm from repeating.
+static int64_t accelTimeoutCallback(alarm_id_t id, void *user_data) {
+    waitTimedOut = true;
+    return 0;
+}
+
+// Set up an interrupt pin as an input that calls accelGpioCallback on a rising edge
+static void attachInterruptPin(uint pin, volatile bool &pending) {
+    gpio_init(pin);
+    gpio_set_dir(pin, GPIO_IN);
+    pending = false;
+    gpio_set_irq_enabled_with_callback(pin, GPIO_IRQ_EDGE_RISE, true, &accelGpioCallback);
+}
+
+bool accelDriver::enableInterrupt(AccelInterrupt source) {
+    // INT1 is push-pull and active high by default. Leave any event engines routed to INT1 alone.
+    if (!modifyRegister(CTRL_REG3, CTRL_REG3_DATA_MASK, static_cast<uint8_t>(source))) {
+        log(LogLevel::ERROR, "Failed to configure LIS3DH CTRL_REG3");
+        return false;
+    }
+
+    attachInterruptPin(ACCEL_INT1_PIN, int1Pending);
+    return true;
+}
+
+bool accelDriver::dataReady() const {
+    // The LIS3DH holds INT1 high until the data is read, so the level catches an edge that arrived before the handler
+    // was installed or while the previous data was still being read
+    return int1Pending || gpio_get(ACCEL_INT1_PIN);
+}
+
+bool accelDriver::sleepUntil(bool (accelDriver::*condition)() const, uint32_t timeout_us) {
+    // An alarm interrupt wakes the core if the sensor never asserts the pin
+    waitTimedOut = false;
+    alarm_id_t alarm = add_alarm_in_us(timeout_us, accelTimeoutCallback, nullptr, true);
+
+    bool ready;
+    for (;;) {
+        // Check and sleep with interrupts disabled so an interrupt between the two still wakes the core
+        uint32_t irqStatus = save_and_disable_interrupts();
+        ready = (this->*condition)();
+        if (ready || waitTimedOut) {
+            restore_interrupts(irqStatus);
+            break;
+        }
+        __wfi();
+        restore_interrupts(irqStatus);
+    }
+
+    if (alarm > 0) {
+        cancel_alarm(alarm);
+    }
+    return ready;
+}
+
+bool accelDriver::waitForData(uint32_t timeout_us) {
+    bool ready = sleepUntil(&accelDriver::dataReady, timeout_us);
+    int1Pending = false;
+    return ready;
+}
+
+// --- Embedded event engines ---
+
+// Interrupt routing bits for each engine, the same in CTRL_REG3 (I1_*) and CTRL_REG6 (I2_*)
+#define ROUTE_CLICK 0x80
+#define ROUTE_IA1 0x40
+#define ROUTE_IA2 0x20
+#define ROUTE_EVENT_MASK (ROUTE_CLICK | ROUTE_IA1 | ROUTE_IA2)
+
+// CTRL_REG2 high-pass filter for the click engine, and CTRL_REG5 latches for the inertial generators
+#define CTRL_REG2_HPCLICK 0x04
+#define CTRL_REG5_LIR_INT1 0x08
+#define CTRL_REG5_LIR_INT2 0x02
+
+// INTx_CFG bits: AND/OR combination, 6D mode, and a high and a low event enable per axis
+#define INT_CFG_AOI 0x80
+#define INT_CFG_6D 0x40
+#define INT_CFG_LOW_EVENTS 0x15
+#define INT_CFG_ALL_EVENTS 0x3F
+
+// INTx_SRC bits: interrupt active, then high and low flags per axis
+#define INT_SRC_IA 0x40
+#define INT_SRC_ZH 0x20
+#define INT_SRC_ZL 0x10
+#define INT_SRC_YH 0x08
+#define INT_SRC_YL 0x04
+#define INT_SRC_XH 0x02
+#define INT_SRC_XL 0x01
+
+// CLICK_CFG has a single (S) and double (D) enable per axis, X in the lowest bits
+#define CLICK_CFG_SINGLE_X 0x01
+#define CLICK_CFG_DOUBLE_X 0x02
+
+// CLICK_SRC bits, and the latch bit of CLICK_THS
+#define CLICK_SRC_IA 0x40
+#define CLICK_SRC_DCLICK 0x20
+#define CLICK_SRC_SCLICK 0x10
+#define CLICK_SRC_SIGN 0x08
+#define CLICK_SRC_AXES 0x07
+#define CLICK_THS_LIR 0x80
+
+// While the sensor is falling the latched free-fall interrupt re-asserts on every sample, so sightings closer together
+// than this are the same fall
+#define FREE_FALL_REARM_US 50000
+
+// Threshold register LSB in mg for each full-scale range (datasheet table 85)
+static const uint8_t thresholdLsbTable[4] = {16, 32, 62, 186};
+
+uint8_t accelDriver::thresholdCounts(uint16_t mg) const {
+    // Rounded to the nearest step, and never 0, which would trigger on every sample
+    uint32_t lsb = thresholdLsbTable[static_cast<uint8_t>(range)];
+    uint32_t counts = (mg + lsb / 2) / lsb;
+    return (uint8_t)(counts < 1 ? 1 : (counts > 127 ? 127 : counts));
+}
+
+uint8_t accelDriver::durationCounts(uint16_t ms, uint8_t maxCounts) const {
+    // Durations count samples, so they depend on the data rate
+    if (samplePeriodUs == 0) {
+        return 0;
+    }
+    uint32_t counts = ((uint32_t)ms * 1000 + samplePeriodUs / 2) / samplePeriodUs;
+    return (uint8_t)(counts > maxCounts ? maxCounts : counts);
+}
+
+bool accelDriver::routeEvent(uint8_t engineBits, AccelEventPin pin) {
+    bool int1 = pin == AccelEventPin::INT1;
+    if (!modifyRegister(CTRL_REG3, engineBits, int1 ? engineBits : 0) ||
+        !modifyRegister(CTRL_REG6, engineBits, int1 ? 0 : engineBits)) {
+        log(LogLevel::ERROR, "Failed to route LIS3DH event interrupt");
+        return false;
+    }
+
+    if (int1) {
+        eventsOnInt1 = true;
+        attachInterruptPin(ACCEL_INT1_PIN, int1Pending);
+    } else {
+        eventsOnInt2 = true;
+        attachInterruptPin(ACCEL_INT2_PIN, int2Pending);
+    }
+    return true;
+}
+
+bool accelDriver::enableTapDetection(const AccelTapSettings &settings, AccelEventPin pin) {
+    // Double-tap enables sit one bit above the single-tap enables
+    uint8_t clickCfg = 0;
+    for (int axis = 0; axis < 3; ++axis) {
+        if (settings.axes & (1 << axis)) {
+            clickCfg |= (settings.doubleTap ? (CLICK_CFG_SINGLE_X | CLICK_CFG_DOUBLE_X) : CLICK_CFG_SINGLE_X)
+                        << (2 * axis);
+        }
+    }
+
+    // The thresholds are written last, as CLICK_CFG starts the engine
+    if (!modifyRegister(CTRL_REG2, CTRL_REG2_HPCLICK, CTRL_REG2_HPCLICK) ||
+        !writeRegister(CLICK_THS, CLICK_THS_LIR | thresholdCounts(settings.threshold_mg)) ||
+        !writeRegister(TIME_LIMIT, durationCounts(settings.timeLimit_ms, 127)) ||
+        !writeRegister(TIME_LATENCY, durationCounts(settings.latency_ms, 255)) ||
+        !writeRegister(TIME_WINDOW, durationCounts(settings.window_ms, 255)) ||
+        !writeRegister(CLICK_CFG, clickCfg)) {
+        log(LogLevel::ERROR, "Failed to configure LIS3DH tap detection");
+        return false;
+    }
+
+    tapEnabled = clickCfg != 0;
+    return routeEvent(ROUTE_CLICK, pin);
+}
+
+bool accelDriver::enableFreeFallDetection(uint16_t threshold_mg, uint16_t duration_ms, AccelEventPin pin) {
+    // Free-fall is a low event on every axis at once (AND combination), latched until INT1_SRC is read
+    if (!writeRegister(INT1_THS, thresholdCounts(threshold_mg)) ||
+        !writeRegister(INT1_DURATION, durationCounts(duration_ms, 127)) ||
+        !modifyRegister(CTRL_REG5, CTRL_REG5_LIR_INT1, CTRL_REG5_LIR_INT1) ||
+        !writeRegister(INT1_CFG, INT_CFG_AOI | INT_CFG_LOW_EVENTS)) {
+        log(LogLevel::ERROR, "Failed to configure LIS3DH free-fall detection");
+        return false;
+    }
+
+    freeFallEnabled = true;
+    return routeEvent(ROUTE_IA1, pin);
+}
+
+bool accelDriver::enableOrientationDetection(uint16_t threshold_mg, uint16_t duration_ms, AccelEventPin pin) {
+    // 6D movement mode (6D without AOI) interrupts each time the sensor enters a new known orientation
+    if (!writeRegister(INT2_THS, thresholdCounts(threshold_mg)) ||
+        !writeRegister(INT2_DURATION, durationCounts(duration_ms, 127)) ||
+        !modifyRegister(CTRL_REG5, CTRL_REG5_LIR_INT2, CTRL_REG5_LIR_INT2) ||
+        !writeRegister(INT2_CFG, INT_CFG_6D | INT_CFG_ALL_EVENTS)) {
+        log(LogLevel::ERROR, "Failed to configure LIS3DH orientation detection");
+        return false;
+    }
+
+    orientationEnabled = true;
+    return routeEvent(ROUTE_IA2, pin);
+}
+
+bool accelDriver::disableEvents() {
+    if (!writeRegister(CLICK_CFG, 0) || !writeRegister(INT1_CFG, 0) || !writeRegister(INT2_CFG, 0) ||
+        !modifyRegister(CTRL_REG3, ROUTE_EVENT_MASK, 0) || !modifyRegister(CTRL_REG6, ROUTE_EVENT_MASK, 0)) {
+        log(LogLevel::ERROR, "Failed to disable LIS3DH event detection");
+        return false;
+    }
+
+    tapEnabled = freeFallEnabled = orientationEnabled = false;
+    eventsOnInt1 = eventsOnInt2 = false;
+    return true;
+}
+
+bool accelDriver::eventPending() const {
+    // Events are latched, so the pin stays high until they are read
+    return (eventsOnInt2 && (int2Pending || gpio_get(ACCEL_INT2_PIN))) ||
+           (eventsOnInt1 && (int1Pending || gpio_get(ACCEL_INT1_PIN)));
+}
+
+bool accelDriver::waitForEvent(uint32_t timeout_us) {
+    return sleepUntil(&accelDriver::eventPending, timeout_us);
+}
+
+// Decode the known orientation from INT2_SRC in 6D mode, where exactly one high or low flag is set
+static AccelOrientation decodeOrientation(uint8_t source) {
+    switch (source & ~INT_SRC_IA) {
+        case INT_SRC_XH: return AccelOrientation::X_UP;
+        case INT_SRC_XL: return AccelOrientation::X_DOWN;
+        case INT_SRC_YH: return AccelOrientation::Y_UP;
+        case INT_SRC_YL: return AccelOrientation::Y_DOWN;
+        case INT_SRC_ZH: return AccelOrientation::Z_UP;
+        case INT_SRC_ZL: return AccelOrientation::Z_DOWN;
+        default: return AccelOrientation::UNKNOWN;
+    }
+}
+
+size_t accelDriver::readEvents(AccelEvent *events, size_t maxEvents) {
+    // Clear the flags before reading, so an event that arrives during the reads sets them again
+    int1Pending = false;
+    int2Pending = false;
+
+    uint32_t timestamp = (uint32_t)to_us_since_boot(get_absolute_time());
+    size_t count = 0;
+    uint8_t source;
+
+    if (tapEnabled && count < maxEvents && readRegister(CLICK_SRC, &source, 1) && (source & CLICK_SRC_IA)) {
+        // The lowest axis flag is the one that tapped
+        uint8_t axes = source & CLICK_SRC_AXES;
+        events[count++] = {(source & CLICK_SRC_DCLICK) ? AccelEventType::DOUBLE_TAP : AccelEventType::SINGLE_TAP,
+                           (uint8_t)(axes & -axes), (source & CLICK_SRC_SIGN) != 0, AccelOrientation::UNKNOWN,
+                           timestamp};
+    }
+    if (freeFallEnabled && count < maxEvents && readRegister(INT1_SRC, &source, 1) && (source & INT_SRC_IA)) {
+        bool sameFall = freeFallSeen && timestamp - freeFallSeenUs < FREE_FALL_REARM_US;
+        freeFallSeen = true;
+        freeFallSeenUs = timestamp;
+        if (!sameFall) {
+            events[count++] = {AccelEventType::FREE_FALL, 0, false, AccelOrientation::UNKNOWN, timestamp};
+        }
+    }
+    if (orientationEnabled && count < maxEvents && readRegister(INT2_SRC, &source, 1) && (source & INT_SRC_IA)) {
+        events[count++] = {AccelEventType::ORIENTATION, 0, false, decodeOrientation(source), timestamp};
+    }
+    return count;
 }
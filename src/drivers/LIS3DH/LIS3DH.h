@@ -4,18 +4,340 @@
 #include <cstdint>
 #include <stdio.h>
 #include "pico/stdlib.h"
+#include "pico/time.h"
 #include "hardware/i2c.h"
+#include "drivers/instrumentation/instrumentation.h"
 
+// Number of samples the LIS3DH hardware FIFO can hold
+constexpr size_t ACCEL_FIFO_DEPTH = 32;
+
+// One raw sample as stored in OUT_X_L..OUT_Z_H: left-justified 16-bit values, little-endian.
+// The layout matches the register map so that FIFO bursts can be read straight into an array of frames.
+struct AccelRawFrame {
+    int16_t x;
+    int16_t y;
+    int16_t z;
+};
+static_assert(sizeof(AccelRawFrame) == 6, "AccelRawFrame must match the LIS3DH output register layout");
+
+// Operating modes, which set the resolution of the output data
+enum class AccelResolution : uint8_t {
+    LOW_POWER_8BIT,
+    NORMAL_10BIT,
+    HIGH_RES_12BIT,
+};
+
+// Full-scale ranges (FS field of CTRL_REG4)
+enum class AccelRange : uint8_t {
+    G2 = 0,
+    G4 = 1,
+    G8 = 2,
+    G16 = 3,
+};
+
+// Result of reading a sample
+enum class AccelStatus : uint8_t {
+    OK,
+    READ_FAILED,
+};
+
+// A converted sample. Values are in milli-g, which covers the full ±16g range of every mode in an int16_t.
+struct AccelSample {
+    int16_t x_mg;
+    int16_t y_mg;
+    int16_t z_mg;
+    AccelStatus status;
+    uint32_t timestamp_us; // Time since boot that the sample was read (or, for FIFO samples, estimated to be taken)
+};
+
+// Output data rates (ODR field of CTRL_REG1)
+// The LP_* rates are only available in low-power mode.
+enum class AccelDataRate : uint8_t {
+    POWER_DOWN = 0x0,
+    HZ_1 = 0x1,
+    HZ_10 = 0x2,
+    HZ_25 = 0x3,
+    HZ_50 = 0x4,
+    HZ_100 = 0x5,
+    HZ_200 = 0x6,
+    HZ_400 = 0x7,
+    LP_1600 = 0x8,
+    HZ_1344_LP_5376 = 0x9,
+};
+
+// FIFO modes (FM field of FIFO_CTRL_REG)
+enum class AccelFifoMode : uint8_t {
+    BYPASS = 0x00,         // FIFO disabled, output registers hold the latest sample
+    FIFO = 0x40,           // Collect samples until full, then stop
+    STREAM = 0x80,         // Keep the newest 32 samples, discarding the oldest when full
+    STREAM_TO_FIFO = 0xC0, // Stream until the trigger event, then FIFO
+};
+
+// Interrupt sources that can be routed to the INT1 pin (CTRL_REG3)
+enum class AccelInterrupt : uint8_t {
+    DATA_READY = 0x10,     // I1_ZYXDA: a new sample is available
+    FIFO_WATERMARK = 0x04, // I1_WTM: the FIFO has reached its watermark
+    FIFO_OVERRUN = 0x02,   // I1_OVERRUN: the FIFO is full
+};
+
+// Interrupt pins that the embedded event engines can be routed to
+enum class AccelEventPin : uint8_t {
+    INT1, // Shared with the data interrupts (see enableInterrupt())
+    INT2, // Events only, so an interrupt always means an event
+};
+
+// Axes that the tap engine watches, combined with |
+enum AccelAxes : uint8_t {
+    ACCEL_AXIS_X = 0x01,
+    ACCEL_AXIS_Y = 0x02,
+    ACCEL_AXIS_Z = 0x04,
+    ACCEL_AXES_ALL = 0x07,
+};
+
+// Events detected by the sensor's embedded engines
+enum class AccelEventType : uint8_t {
+    SINGLE_TAP,  // A short spike on one axis
+    DOUBLE_TAP,  // Two taps in quick succession (the first is also reported as a single tap)
+    FREE_FALL,   // Every axis near zero g for the configured time (reported once per fall)
+    ORIENTATION, // The sensor has settled in a new orientation
+};
+
+// Which face of the board points up (towards the sky), as seen by the 6D engine
+enum class AccelOrientation : uint8_t {
+    UNKNOWN,
+    X_UP,
+    X_DOWN,
+    Y_UP,
+    Y_DOWN,
+    Z_UP, // Lying flat, face up
+    Z_DOWN,
+};
+
+// A decoded event. Taps give the axis (ACCEL_AXIS_X, _Y or _Z) and direction of the tap, orientation events the new
+// orientation; the other fields are zero.
+struct AccelEvent {
+    AccelEventType type;
+    uint8_t axis;
+    bool negative;
+    AccelOrientation orientation;
+    uint32_t timestamp_us; // Time since boot that the event was read
+};
+
+// Tap detection settings (see accelDriver::enableTapDetection()). The defaults suit finger taps on a board at ±2g.
+struct AccelTapSettings {
+    uint8_t axes = ACCEL_AXES_ALL;
+    uint16_t threshold_mg = 1200; // Rise above the slowly varying acceleration that counts as a tap
+    uint16_t timeLimit_ms = 20;   // Longest a tap can stay above the threshold
+    bool doubleTap = false;       // Also detect double taps
+    uint16_t latency_ms = 80;     // After a tap, time to ignore the ringing before looking for the second tap
+    uint16_t window_ms = 250;     // Time after the latency in which the second tap must start
+};
+
+// State of an asynchronous transfer (see accelDriver::startRead())
+enum class AccelTransferStatus : uint8_t {
+    IDLE,      // No transfer has been started
+    BUSY,      // Running on the bus
+    DONE,      // The data has arrived
+    FAILED,    // The sensor did not acknowledge
+    TIMED_OUT, // The deadline passed, and the bus has been recovered
+};
+
+// Called once when an asynchronous transfer finishes, from the pollTransfer() call that noticed
+typedef void (*AccelTransferCallback)(AccelTransferStatus status, void *context);
+
+// Longest asynchronous burst read: the whole FIFO
+constexpr size_t ACCEL_MAX_TRANSFER = ACCEL_FIFO_DEPTH * sizeof(AccelRawFrame);
 
 class accelDriver {
     private:
+        // Conversion settings for the current resolution and range: raw values are shifted right by rawShift to
+        // remove the unused low bits, then multiplied by sensitivityMg to get milli-g.
+        // accelInit() configures normal (10-bit) mode at ±2g.
+        AccelResolution resolution = AccelResolution::NORMAL_10BIT;
+        AccelRange range = AccelRange::G2;
+        uint8_t rawShift = 6;
+        uint8_t sensitivityMg = 4;
+
+        // Time between samples at the current data rate (accelInit() configures 400 Hz)
+        uint32_t samplePeriodUs = 2500;
+
+        // Number of times the FIFO overflowed before it was drained (each overflow loses at least one sample)
+        uint32_t fifoOverruns = 0;
+
+        // Asynchronous transfers: the DMA channels that write commands into the I2C block and collect the bytes it
+        // receives (claimed on first use, -1 until then), the commands for the transfer in progress and its state
+        int dmaCommandChannel = -1;
+        int dmaDataChannel = -1;
+        uint32_t transferCommands[ACCEL_MAX_TRANSFER + 1];
+        AccelTransferStatus transferStatus = AccelTransferStatus::IDLE;
+        absolute_time_t transferDeadline = {};
+        AccelTransferCallback transferCallback = nullptr;
+        void *transferContext = nullptr;
+        InstrumentStamp transferStart = {};
+
+        // Number of times recoverBus() has run
+        uint32_t busRecoveries = 0;
+
+        // Embedded event engines that are enabled, and the pins they are routed to
+        bool tapEnabled = false;
+        bool freeFallEnabled = false;
+        bool orientationEnabled = false;
+        bool eventsOnInt1 = false;
+        bool eventsOnInt2 = false;
+
+        // When the free-fall interrupt was last seen, so that one fall is reported once
+        bool freeFallSeen = false;
+        uint32_t freeFallSeenUs = 0;
+
+        // initBus() sets up the I2C block and hands it the pins
+        void initBus();
+
+        // claimTransferChannels() claims and configures the DMA channels the first time they are needed
+        void claimTransferChannels();
+
+        // finishTransfer() records the outcome of a transfer and calls its callback
+        void finishTransfer(AccelTransferStatus status);
+
+        // sleepUntil() sleeps the core until [condition] holds, returning false if it still doesn't after timeout_us
+        bool sleepUntil(bool (accelDriver::*condition)() const, uint32_t timeout_us);
+
+        // routeEvent() sends an engine's interrupt to [pin] (CTRL_REG3 for INT1, CTRL_REG6 for INT2) and installs the
+        // GPIO interrupt handler for it. The bits are the engine's I1_* flag, which matches its I2_* flag.
+        bool routeEvent(uint8_t engineBits, AccelEventPin pin);
+
+        // thresholdCounts() and durationCounts() convert physical units to the engines' register units at the
+        // current range and data rate
+        uint8_t thresholdCounts(uint16_t mg) const;
+        uint8_t durationCounts(uint16_t ms, uint8_t maxCounts) const;
+
+        // writeRegister() and readRegister() are the blocking transfers. They return false without touching the bus
+        // while an asynchronous transfer owns it.
         bool writeRegister(uint8_t reg, uint8_t data);
 
         bool readRegister(uint8_t reg, uint8_t *data, size_t length);
+
+        // busHeldByTransfer() returns true (and logs) if an asynchronous transfer is still running
+        bool busHeldByTransfer() const;
+
+        // Read-modify-write of the bits selected by mask
+        bool modifyRegister(uint8_t reg, uint8_t mask, uint8_t value);
     public:
         void accelInit();
 
+        // readAccelerometer() returns the current acceleration in Gs, or an empty vector if the read failed.
+        // Prefer readSample(), which does not allocate or use floating point.
         std::vector<float> readAccelerometer();
 
+        // convertToGs() converts a right-justified raw value to Gs using the current resolution and range
         float convertToGs(int16_t rawValue);
+
+        // configure() sets the operating mode and full-scale range, and updates the conversion settings to match
+        bool configure(AccelResolution newResolution, AccelRange newRange);
+
+        // readSample() reads the latest sample with one burst read and converts it to milli-g.
+        // On failure the status is AccelStatus::READ_FAILED and the values are zero.
+        AccelSample readSample();
+
+        // convertFrames() converts [count] raw frames to milli-g in one pass. The last frame is stamped with
+        // timestamp_us and earlier frames are back-dated by the sample period, which suits a FIFO drain.
+        void convertFrames(const AccelRawFrame *frames, AccelSample *samples, size_t count, uint32_t timestamp_us) const;
+
+        // convertFramesToGs() converts [count] raw frames to Gs, writing x, y, z for each frame into gs[3 * count]
+        void convertFramesToGs(const AccelRawFrame *frames, float *gs, size_t count) const;
+
+        // - FIFO streaming -
+
+        // setDataRate() changes the output data rate, leaving the other CTRL_REG1 settings untouched
+        bool setDataRate(AccelDataRate rate);
+
+        // enableFifo() empties the FIFO and starts collecting samples in the given mode.
+        // The watermark (0-31) sets the fill level that raises the WTM flag in FIFO_SRC_REG.
+        bool enableFifo(AccelFifoMode mode, uint8_t watermark = 0);
+
+        // disableFifo() returns the sensor to bypass mode
+        bool disableFifo();
+
+        // fifoLevel() returns the number of unread samples in the FIFO (0-32), or -1 if FIFO_SRC_REG could not be read
+        int fifoLevel();
+
+        // drainFifo() reads every pending sample (up to maxFrames) into frames with a single burst read.
+        // Returns the number of frames read, which is 0 if the FIFO was empty or the read failed.
+        size_t drainFifo(AccelRawFrame *frames, size_t maxFrames);
+
+        // - Interrupt driven sampling -
+
+        // enableInterrupt() routes the given source to INT1 and installs the GPIO interrupt handler for ACCEL_INT1_PIN
+        bool enableInterrupt(AccelInterrupt source);
+
+        // dataReady() returns true if the interrupt has fired (or INT1 is still asserted) since data was last waited for
+        bool dataReady() const;
+
+        // waitForData() sleeps the core until INT1 fires, returning false if nothing arrived within timeout_us
+        bool waitForData(uint32_t timeout_us);
+
+        // fifoOverrunCount() returns how many times the FIFO was found full (and possibly overwritten) when drained
+        uint32_t fifoOverrunCount() const;
+
+        // - Embedded event engines -
+        //
+        // The sensor can detect taps, free-fall and orientation changes itself and raise an interrupt, so the core can
+        // sleep without reading any samples. Thresholds and times are converted using the range and data rate at the
+        // time of the call, so configure() and setDataRate() first (e.g. 400 Hz for taps, which last a few ms). Events
+        // are latched until readEvents() collects them.
+
+        // enableTapDetection() sets up the click engine. It watches the high-pass filtered acceleration, so gravity
+        // does not count towards the threshold.
+        bool enableTapDetection(const AccelTapSettings &settings, AccelEventPin pin = AccelEventPin::INT2);
+
+        // enableFreeFallDetection() raises an event once every axis has stayed below threshold_mg for duration_ms,
+        // which happens when the sensor is dropped. Uses inertial interrupt generator 1.
+        bool enableFreeFallDetection(uint16_t threshold_mg = 350, uint16_t duration_ms = 30,
+                                     AccelEventPin pin = AccelEventPin::INT2);
+
+        // enableOrientationDetection() raises an event when the sensor settles in a new orientation: one axis beyond
+        // ±threshold_mg for duration_ms. Uses inertial interrupt generator 2 in 6D movement mode.
+        bool enableOrientationDetection(uint16_t threshold_mg = 650, uint16_t duration_ms = 100,
+                                        AccelEventPin pin = AccelEventPin::INT2);
+
+        // disableEvents() turns every event engine off and removes them from the interrupt pins
+        bool disableEvents();
+
+        // eventPending() returns true if a pin carrying events has fired (or is still asserted) since events were last
+        // read. With events on INT1 this is also true for data interrupts.
+        bool eventPending() const;
+
+        // waitForEvent() sleeps the core until an event pin fires, returning false if nothing arrived within timeout_us
+        bool waitForEvent(uint32_t timeout_us);
+
+        // readEvents() reads the source registers of the enabled engines, which releases their latched interrupts, and
+        // decodes up to maxEvents events into events. Returns the number of events, 0 if nothing happened or a read
+        // failed.
+        size_t readEvents(AccelEvent *events, size_t maxEvents);
+
+        // - Asynchronous transfers -
+
+        // startRead() starts reading [length] bytes (1 to ACCEL_MAX_TRANSFER) from register [reg] in one burst, with
+        // DMA running the bus so the core is free until it finishes. Set AUTO_INCREMENT in reg for multi-byte reads,
+        // and keep data valid until the transfer has finished. If it hasn't finished within timeout_us it is abandoned
+        // and the bus is recovered. Returns false (starting nothing) if a transfer is already running or the length is
+        // out of range. Until pollTransfer() finishes it, the blocking reads and writes (and so drainFifo(),
+        // readEvents() and the rest) fail instead of sharing the bus with the DMA.
+        bool startRead(uint8_t reg, uint8_t *data, size_t length, uint32_t timeout_us,
+                       AccelTransferCallback callback = nullptr, void *context = nullptr);
+
+        // pollTransfer() checks on the transfer, finishing it once the data has arrived, the sensor has NACKed or the
+        // deadline has passed, and returns its status. Call it regularly while the status is BUSY; the callback runs
+        // from here.
+        AccelTransferStatus pollTransfer();
+
+        // waitTransfer() polls until the transfer has finished and returns its status
+        AccelTransferStatus waitTransfer();
+
+        // recoverBus() frees a bus held by a sensor that was interrupted part-way through a byte: it clocks SCL until
+        // the sensor releases SDA (at most 9 clocks), sends a STOP and re-initialises the I2C block. Returns false if
+        // SDA is still held low.
+        bool recoverBus();
+
+        // busRecoveryCount() returns how many times recoverBus() has run, whether after a timeout or on request
+        uint32_t busRecoveryCount() const;
 };
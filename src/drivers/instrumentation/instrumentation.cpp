@@ -0,0 +1,178 @@
+// Latency instrumentation, using the style that state is global in the C file.
+
+#include "instrumentation.h"
+
+#if INSTRUMENTATION_ENABLED
+
+#include <string.h>
+#include "pico/platform.h"
+#include "drivers/logging/logging.h"
+
+#ifndef TEST_HARNESS
+#include "hardware/clocks.h"
+#endif
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+// --- Internal state
+
+/// The raw counters for one probe on one core. Durations are in ticks (see ticksPerSecond()).
+struct ProbeData {
+    uint32_t count;
+    uint32_t minTicks;
+    uint32_t maxTicks;
+    uint64_t totalTicks;
+    uint32_t buckets[INSTRUMENT_BUCKETS];
+};
+
+/// Each core only writes its own copy, so recording needs no locks
+static ProbeData probeData[2][(size_t)Probe::COUNT];
+
+static const char *const probeNames[(size_t)Probe::COUNT] = {
+    "accel_read_register",
+    "accel_drain_fifo",
+    "accel_transfer",
+    "led_update",
+    "log_call",
+};
+
+/// The device falls back to the microsecond timer for spans longer than this, as SysTick only has 24 bits
+#define SYSTICK_SPAN_LIMIT_US 100000
+
+// --- Internal functions
+
+/// The tick rate: nanoseconds on the host, CPU cycles on the device
+static uint64_t ticksPerSecond()
+{
+#ifdef TEST_HARNESS
+    return 1000000000ull;
+#else
+    return clock_get_hz(clk_sys);
+#endif
+}
+
+static uint64_t ticksToNs(uint64_t ticks)
+{
+    uint64_t rate = ticksPerSecond();
+    return ticks / rate * 1000000000ull + ticks % rate * 1000000000ull / rate;
+}
+
+/// Elapsed ticks since start, saturating at 32 bits
+static uint32_t elapsedTicks(InstrumentStamp start)
+{
+    InstrumentStamp end = instrumentNow();
+#ifdef TEST_HARNESS
+    uint64_t ticks = end.ns - start.ns;
+#else
+    uint64_t ticks;
+    uint32_t us = end.us - start.us;
+    if (us < SYSTICK_SPAN_LIMIT_US) {
+        ticks = (start.cycles - end.cycles) & M0PLUS_SYST_RVR_BITS; // SysTick counts down
+    } else {
+        ticks = (uint64_t)us * (ticksPerSecond() / 1000000);
+    }
+#endif
+    return ticks > UINT32_MAX ? UINT32_MAX : (uint32_t)ticks;
+}
+
+/// The histogram bucket for a duration: the number of bits needed to hold it
+static size_t bucketFor(uint32_t ticks)
+{
+    if (ticks == 0) {
+        return 0;
+    }
+#ifdef _MSC_VER
+    unsigned long index;
+    _BitScanReverse(&index, ticks);
+    return index + 1;
+#else
+    return 32 - __builtin_clz(ticks);
+#endif
+}
+
+// --- Public functions
+
+void instrumentRecord(Probe probe, InstrumentStamp start)
+{
+    uint32_t ticks = elapsedTicks(start);
+    ProbeData &data = probeData[get_core_num()][(size_t)probe];
+
+    if (data.count == 0 || ticks < data.minTicks) {
+        data.minTicks = ticks;
+    }
+    if (ticks > data.maxTicks) {
+        data.maxTicks = ticks;
+    }
+    data.totalTicks += ticks;
+    data.buckets[bucketFor(ticks)]++;
+    data.count++;
+}
+
+ProbeStats instrumentGetStats(Probe probe)
+{
+    ProbeStats stats = {};
+    stats.name = probeNames[(size_t)probe];
+
+    uint32_t minTicks = UINT32_MAX;
+    uint32_t maxTicks = 0;
+    uint64_t totalTicks = 0;
+    for (const auto &core : probeData) {
+        const ProbeData &data = core[(size_t)probe];
+        if (data.count == 0) {
+            continue;
+        }
+        stats.count += data.count;
+        totalTicks += data.totalTicks;
+        if (data.minTicks < minTicks) {
+            minTicks = data.minTicks;
+        }
+        if (data.maxTicks > maxTicks) {
+            maxTicks = data.maxTicks;
+        }
+        for (size_t b = 0; b < INSTRUMENT_BUCKETS; b++) {
+            stats.buckets[b] += data.buckets[b];
+        }
+    }
+
+    if (stats.count > 0) {
+        stats.totalNs = ticksToNs(totalTicks);
+        stats.minNs = (uint32_t)ticksToNs(minTicks);
+        stats.maxNs = (uint32_t)ticksToNs(maxTicks);
+    }
+    return stats;
+}
+
+void instrumentReset()
+{
+    memset(probeData, 0, sizeof(probeData));
+}
+
+uint64_t instrumentBucketLimitNs(size_t bucket)
+{
+    return ticksToNs(1ull << bucket);
+}
+
+void instrumentDump()
+{
+    for (size_t p = 0; p < (size_t)Probe::COUNT; p++) {
+        // Take the snapshot first, as logging may itself be a probe
+        ProbeStats stats = instrumentGetStats((Probe)p);
+        if (stats.count == 0) {
+            continue;
+        }
+
+        log<LogLevel::INFORMATION>("Probe %s: %u calls, mean %u ns", stats.name, stats.count,
+                                   (uint32_t)(stats.totalNs / stats.count));
+        log<LogLevel::INFORMATION>("Probe %s: min %u ns, max %u ns", stats.name, stats.minNs, stats.maxNs);
+        for (size_t b = 0; b < INSTRUMENT_BUCKETS; b++) {
+            if (stats.buckets[b] > 0) {
+                log<LogLevel::INFORMATION>("Probe %s: under %u ns: %u", stats.name, instrumentBucketLimitNs(b),
+                                           stats.buckets[b]);
+            }
+        }
+    }
+}
+
+#endif
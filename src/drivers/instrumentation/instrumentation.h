@@ -0,0 +1,124 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+
+#ifdef TEST_HARNESS
+#include <chrono>
+#else
+#include "hardware/structs/systick.h"
+#include "hardware/timer.h"
+#endif
+
+/// Latency probes for the driver hot paths. Each probe keeps a call count, min/max/mean and a histogram with one
+/// bucket per power of two, in fixed static storage (one copy per core, so recording needs no locks). Wrap the code to
+/// be timed in INSTRUMENT_SCOPE(Probe::...) and call instrumentDump() to log the results.
+///
+/// Define INSTRUMENTATION_ENABLED as 0 to compile every probe out: INSTRUMENT_SCOPE() expands to nothing and the
+/// functions below do nothing.
+#ifndef INSTRUMENTATION_ENABLED
+#define INSTRUMENTATION_ENABLED 1
+#endif
+
+/// The code paths that can be timed. Add a probe here and give it a name in instrumentation.cpp.
+enum class Probe : uint8_t {
+    ACCEL_READ_REGISTER, // accelDriver::readRegister(): one I2C register read
+    ACCEL_DRAIN_FIFO,    // accelDriver::drainFifo(): reading the FIFO in one burst
+    ACCEL_TRANSFER,      // accelDriver::startRead() to the transfer finishing: one DMA-driven burst read
+    LED_UPDATE,          // LEDController::updateLEDs(): pushing a frame and waiting for it to latch
+    LOG_CALL,            // log() and log<Level>() in the caller, including printing in immediate mode
+    COUNT,
+};
+
+/// The number of histogram buckets. Bucket 0 holds durations under 1 tick, and bucket b holds [2^(b-1), 2^b) ticks.
+constexpr size_t INSTRUMENT_BUCKETS = 33;
+
+/// A snapshot of one probe, combined across both cores. Durations are in nanoseconds.
+struct ProbeStats {
+    const char *name;
+    uint32_t count;
+    uint64_t totalNs;
+    uint32_t minNs;
+    uint32_t maxNs;
+    uint32_t buckets[INSTRUMENT_BUCKETS]; // Calls per power-of-two bucket, see instrumentBucketLimitNs()
+};
+
+/// A point in time to measure from. The host uses steady_clock in nanoseconds. The device uses this core's SysTick
+/// counting CPU cycles (24 bits, so it wraps every 134 ms at 125 MHz) together with the 1 MHz timer for longer spans.
+struct InstrumentStamp {
+#ifdef TEST_HARNESS
+    uint64_t ns;
+#else
+    uint32_t cycles;
+    uint32_t us;
+#endif
+};
+
+#if INSTRUMENTATION_ENABLED
+
+/// Take a timestamp. Cheap enough to call around a single register access.
+inline InstrumentStamp instrumentNow()
+{
+#ifdef TEST_HARNESS
+    auto now = std::chrono::steady_clock::now().time_since_epoch();
+    return {(uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(now).count()};
+#else
+    // SysTick is per core and off at reset, so start it on first use (counting down from 2^24 - 1 at the CPU clock)
+    if (!(systick_hw->csr & M0PLUS_SYST_CSR_ENABLE_BITS)) {
+        systick_hw->rvr = M0PLUS_SYST_RVR_BITS;
+        systick_hw->cvr = 0;
+        systick_hw->csr = M0PLUS_SYST_CSR_CLKSOURCE_BITS | M0PLUS_SYST_CSR_ENABLE_BITS;
+    }
+    return {systick_hw->cvr, timer_hw->timerawl};
+#endif
+}
+
+/// Record one call to a probe that took the time since start
+void instrumentRecord(Probe probe, InstrumentStamp start);
+
+/// Get the combined statistics for a probe. The snapshot is not atomic, so a call being recorded at the same time may
+/// be partly included.
+ProbeStats instrumentGetStats(Probe probe);
+
+/// Clear every probe.
+void instrumentReset();
+
+/// Log every probe that has been called: its count, min/mean/max and the non-empty histogram buckets. Call this on
+/// demand, or periodically from a main loop (the pipeline does so with its own statistics).
+void instrumentDump();
+
+/// The upper limit (exclusive) of a histogram bucket in nanoseconds.
+uint64_t instrumentBucketLimitNs(size_t bucket);
+
+/// Times the enclosing scope
+class ScopedProbe {
+    public:
+        explicit ScopedProbe(Probe probe) : probe(probe), start(instrumentNow()) {}
+        ~ScopedProbe() { instrumentRecord(probe, start); }
+
+        ScopedProbe(const ScopedProbe&) = delete;
+        ScopedProbe& operator=(const ScopedProbe&) = delete;
+
+    private:
+        Probe probe;
+        InstrumentStamp start;
+};
+
+#define INSTRUMENT_CONCAT_(a, b) a##b
+#define INSTRUMENT_CONCAT(a, b) INSTRUMENT_CONCAT_(a, b)
+
+/// Time from here to the end of the enclosing scope, e.g. `INSTRUMENT_SCOPE(Probe::LED_UPDATE);`
+#define INSTRUMENT_SCOPE(probe) ScopedProbe INSTRUMENT_CONCAT(instrumentScope, __LINE__)(probe)
+
+#else
+
+inline InstrumentStamp instrumentNow() { return {}; }
+inline void instrumentRecord(Probe probe, InstrumentStamp start) {}
+inline ProbeStats instrumentGetStats(Probe probe) { return {}; }
+inline void instrumentReset() {}
+inline void instrumentDump() {}
+inline uint64_t instrumentBucketLimitNs(size_t bucket) { return 0; }
+
+#define INSTRUMENT_SCOPE(probe) ((void)0)
+
+#endif
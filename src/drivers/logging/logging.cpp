@@ -1,46 +1,318 @@
 // Logging system, using the style that state is global in the C file.
 
 #include <stdio.h>
+#include <string.h>
+#include <atomic>
 #include "pico/stdlib.h"
 #include "pico/time.h"
+#include "pico/platform.h"
+#include "pico/multicore.h"
+#include "pico/flash.h"
 #include "logging.h"
+#include "drivers/instrumentation/instrumentation.h"
 
 // --- Device driver internal state:
 
 /// Drop messages whose level is below this threshold.
 static LogLevel maxLogLevel = LogLevel::INFORMATION;
 
+/// Whether messages are printed straight away or queued for logDrain().
+static LogMode logMode = LogMode::IMMEDIATE;
+
+/// A queued message. Either a format string plus its arguments, or (when fmt is null) a copy of a plain message.
+struct LogRecord {
+    uint32_t time;
+    const char *fmt;
+    LogLevel level;
+    uint8_t argCount;
+    union {
+        LogArg args[LOG_MAX_ARGS];
+        char text[LOG_MAX_ARGS * sizeof(LogArg)];
+    };
+    LogRecord() {}
+};
+
+/// Single-producer, single-consumer ring of records. Each core gets its own ring so that both can log without locks;
+/// the drain is the only consumer. The indices increase forever and are masked on use.
+struct LogQueue {
+    LogRecord records[LOG_QUEUE_LENGTH];
+    std::atomic<uint32_t> head{0};    // Next slot to write, only changed by the producer
+    std::atomic<uint32_t> tail{0};    // Next slot to read, only changed by the consumer
+    std::atomic<uint32_t> dropped{0}; // Records lost because the ring was full, only changed by the producer
+};
+static_assert((LOG_QUEUE_LENGTH & (LOG_QUEUE_LENGTH - 1)) == 0, "LOG_QUEUE_LENGTH must be a power of two");
+
+static LogQueue logQueues[2];
+
+// --- Internal functions
+
+/// Convert the level to a string
+static const char *levelName(LogLevel level)
+{
+    switch (level) {
+        case LogLevel::INFORMATION:
+            return "Information";
+        case LogLevel::WARNING:
+            return "Warning";
+        case LogLevel::ERROR:
+            return "Error";
+    };
+    return "";
+}
+
+/// Print a formatted message with its timestamp and level
+static void printMessage(uint32_t time, LogLevel level, const char *msg)
+{
+    uint32_t time_sec = time / 1000;
+    uint32_t time_decimal = (time % 1000);
+    printf("[%u.%03u %s]: %s\n", (unsigned)time_sec, (unsigned)time_decimal, levelName(level), msg);
+}
+
+/// Claim the next free slot in this core's queue, or return null (and count the drop) if it is full
+static LogRecord *reserveRecord(LogQueue &queue)
+{
+    uint32_t head = queue.head.load(std::memory_order_relaxed);
+    if (head - queue.tail.load(std::memory_order_acquire) >= LOG_QUEUE_LENGTH) {
+        // Only this core writes the count, so a plain load and store avoids a locked read-modify-write on the M0+
+        queue.dropped.store(queue.dropped.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+        return nullptr;
+    }
+    return &queue.records[head & (LOG_QUEUE_LENGTH - 1)];
+}
+
+/// Publish the slot returned by reserveRecord() to the drain
+static void commitRecord(LogQueue &queue)
+{
+    queue.head.store(queue.head.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+}
+
+/// Expand a record's format string into out, formatting one conversion at a time with its typed argument
+static void formatRecord(const LogRecord &record, char *out, size_t len)
+{
+    size_t pos = 0;
+    size_t argIndex = 0;
+    const char *p = record.fmt;
+
+    while (*p && pos + 1 < len) {
+        if (*p != '%') {
+            out[pos++] = *p++;
+            continue;
+        }
+        if (p[1] == '%') {
+            out[pos++] = '%';
+            p += 2;
+            continue;
+        }
+
+        // Copy the conversion specification (flags, width, precision, length and the conversion character)
+        char spec[16];
+        size_t specLen = 0;
+        do {
+            spec[specLen++] = *p++;
+        } while (*p && specLen < sizeof(spec) - 1 && !strchr("diouxXeEfFgGaAcsp", p[-1]));
+        spec[specLen] = '\0';
+
+        if (argIndex >= record.argCount) {
+            break; // More conversions than arguments
+        }
+
+        // Strip any length modifier and re-add the one that matches the stored type
+        char conversion = spec[specLen - 1];
+        size_t prefixLen = specLen - 1;
+        while (prefixLen > 1 && strchr("hljztL", spec[prefixLen - 1])) {
+            prefixLen--;
+        }
+
+        // Convert the argument to the type the conversion expects, so a mismatch cannot misread the argument list
+        const LogArg &arg = record.args[argIndex++];
+        bool is64 = (arg.type == LogArg::INT64 || arg.type == LogArg::UINT64);
+        char fixed[24];
+        int written = 0;
+        if (strchr("di", conversion)) {
+            long long value = (arg.type == LogArg::DOUBLE) ? (long long)arg.d
+                            : (arg.type == LogArg::UINT32) ? (long long)arg.u32
+                            : (arg.type == LogArg::INT32) ? (long long)arg.i32
+                            : (arg.type == LogArg::STRING) ? 0 : arg.i64;
+            snprintf(fixed, sizeof(fixed), "%.*s%s%c", (int)prefixLen, spec, is64 ? "ll" : "", conversion);
+            written = is64 ? snprintf(out + pos, len - pos, fixed, value) : snprintf(out + pos, len - pos, fixed, (int)value);
+        } else if (strchr("ouxXc", conversion)) {
+            unsigned long long value = (arg.type == LogArg::DOUBLE) ? (unsigned long long)arg.d
+                                     : (arg.type == LogArg::UINT32) ? (unsigned long long)arg.u32
+                                     : (arg.type == LogArg::INT32) ? (unsigned long long)(long long)arg.i32
+                                     : (arg.type == LogArg::STRING) ? 0 : arg.u64;
+            snprintf(fixed, sizeof(fixed), "%.*s%s%c", (int)prefixLen, spec, is64 ? "ll" : "", conversion);
+            written = is64 ? snprintf(out + pos, len - pos, fixed, value) : snprintf(out + pos, len - pos, fixed, (unsigned)value);
+        } else if (strchr("eEfFgGaA", conversion)) {
+            double value = (arg.type == LogArg::DOUBLE) ? arg.d
+                         : (arg.type == LogArg::UINT32) ? (double)arg.u32
+                         : (arg.type == LogArg::INT32) ? (double)arg.i32
+                         : (arg.type == LogArg::INT64) ? (double)arg.i64
+                         : (arg.type == LogArg::UINT64) ? (double)arg.u64 : 0.0;
+            snprintf(fixed, sizeof(fixed), "%.*s%c", (int)prefixLen, spec, conversion);
+            written = snprintf(out + pos, len - pos, fixed, value);
+        } else if (conversion == 's') {
+            snprintf(fixed, sizeof(fixed), "%.*s%c", (int)prefixLen, spec, conversion);
+            const char *value = (arg.type == LogArg::STRING) ? (arg.s ? arg.s : "(null)") : "?";
+            written = snprintf(out + pos, len - pos, fixed, value);
+        } else {
+            written = snprintf(out + pos, len - pos, "?"); // %p and anything unrecognised
+        }
+        if (written > 0) {
+            pos += (size_t)written;
+        }
+        if (pos >= len) {
+            pos = len - 1;
+        }
+    }
+    out[pos] = '\0';
+}
+
 // --- Device driver functions
 void setLogLevel(LogLevel newLevel)
 {
     maxLogLevel = newLevel;
 }
 
+void setLogMode(LogMode mode)
+{
+    logMode = mode;
+}
+
 void log(LogLevel level, const char *msg)
 {
     // Should we show this message?
     if (level < maxLogLevel) {
         return;
     }
+    INSTRUMENT_SCOPE(Probe::LOG_CALL);
 
     // Get the time since boot
     uint32_t time = to_ms_since_boot(get_absolute_time());
-    uint32_t time_sec = time / 1000;
-    uint32_t time_decimal = (time % 1000);
 
-    // Convert the level to a string
-    const char *levelStr;
-    switch (level) {
-        case LogLevel::INFORMATION:
-            levelStr = "Information";
-            break;
-        case LogLevel::WARNING:
-            levelStr = "Warning";
-            break;
-        case LogLevel::ERROR:
-            levelStr = "Error";
-            break;
-        
-    };
-    printf("[%u.%03u %s]: %s\n", time_sec, time_decimal, levelStr, msg);
+    if (logMode == LogMode::IMMEDIATE) {
+        printMessage(time, level, msg);
+        return;
+    }
+
+    // Queue a copy of the message, as the caller's buffer may not outlive the record
+    LogQueue &queue = logQueues[get_core_num()];
+    LogRecord *record = reserveRecord(queue);
+    if (record == nullptr) {
+        return;
+    }
+    record->time = time;
+    record->fmt = nullptr;
+    record->level = level;
+    record->argCount = 0;
+    strncpy(record->text, msg, sizeof(record->text) - 1);
+    record->text[sizeof(record->text) - 1] = '\0';
+    commitRecord(queue);
+}
+
+void logValues(LogLevel level, const char *fmt, std::initializer_list<LogArg> args)
+{
+    if (!logLevelEnabled(level)) {
+        return;
+    }
+    logCaptured(level, fmt, args.begin(), args.size());
+}
+
+bool logLevelEnabled(LogLevel level)
+{
+    return level >= maxLogLevel;
+}
+
+void logCaptured(LogLevel level, const char *fmt, const LogArg *args, size_t count)
+{
+    INSTRUMENT_SCOPE(Probe::LOG_CALL);
+    uint32_t time = to_ms_since_boot(get_absolute_time());
+    if (count > LOG_MAX_ARGS) {
+        count = LOG_MAX_ARGS;
+    }
+
+    if (logMode == LogMode::IMMEDIATE) {
+        // Format on the stack
+        LogRecord record;
+        record.fmt = fmt;
+        record.argCount = (uint8_t)count;
+        for (size_t i = 0; i < count; i++) {
+            record.args[i] = args[i];
+        }
+        char msg[128];
+        formatRecord(record, msg, sizeof(msg));
+        printMessage(time, level, msg);
+        return;
+    }
+
+    // Only the pointer to the format and the raw arguments are stored; formatting happens in logDrain()
+    LogQueue &queue = logQueues[get_core_num()];
+    LogRecord *record = reserveRecord(queue);
+    if (record == nullptr) {
+        return;
+    }
+    record->time = time;
+    record->fmt = fmt;
+    record->level = level;
+    record->argCount = (uint8_t)count;
+    for (size_t i = 0; i < count; i++) {
+        record->args[i] = args[i];
+    }
+    commitRecord(queue);
+}
+
+size_t logDrain(size_t maxRecords)
+{
+    static uint32_t reportedDrops = 0;
+    size_t printed = 0;
+
+    for (LogQueue &queue : logQueues) {
+        uint32_t tail = queue.tail.load(std::memory_order_relaxed);
+        while (printed < maxRecords && tail != queue.head.load(std::memory_order_acquire)) {
+            const LogRecord &record = queue.records[tail & (LOG_QUEUE_LENGTH - 1)];
+            if (record.fmt == nullptr) {
+                printMessage(record.time, record.level, record.text);
+            } else {
+                char msg[128];
+                formatRecord(record, msg, sizeof(msg));
+                printMessage(record.time, record.level, msg);
+            }
+
+            // Hand the slot back to the producer
+            tail++;
+            queue.tail.store(tail, std::memory_order_release);
+            printed++;
+        }
+    }
+
+    // Report any records lost since the last drain
+    uint32_t dropped = logDroppedCount();
+    if (dropped != reportedDrops) {
+        char msg[48];
+        snprintf(msg, sizeof(msg), "%u log records dropped", (unsigned)(dropped - reportedDrops));
+        printMessage(to_ms_since_boot(get_absolute_time()), LogLevel::WARNING, msg);
+        reportedDrops = dropped;
+    }
+    return printed;
+}
+
+/// Core 1 entry point for logStartDrainOnCore1()
+static void drainLoop()
+{
+    // Let core 0 pause this core while it writes to flash (e.g. the sample recorder)
+    flash_safe_execute_core_init();
+    for (;;) {
+        if (logDrain() == 0) {
+            sleep_ms(1); // Nothing queued, so give the queue a moment to fill
+        }
+    }
+}
+
+void logStartDrainOnCore1()
+{
+    multicore_launch_core1(drainLoop);
+}
+
+uint32_t logDroppedCount()
+{
+    return logQueues[0].dropped.load(std::memory_order_relaxed) + logQueues[1].dropped.load(std::memory_order_relaxed);
 }
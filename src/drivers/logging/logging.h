@@ -1,5 +1,10 @@
 #pragma once 
 
+#include <stdint.h>
+#include <stddef.h>
+#include <initializer_list>
+#include <type_traits>
+
 /// Represents the priority of a log message.
 enum LogLevel {
     INFORMATION,
@@ -7,8 +12,110 @@ enum LogLevel {
     ERROR,
 };
 
+/// Selects when messages are formatted and printed.
+enum class LogMode {
+    /// Format and print in the caller (the default).
+    IMMEDIATE,
+    /// Queue a compact record in constant time. Records are formatted and printed later by logDrain().
+    DEFERRED,
+};
+
+/// One argument of a deferred log record. Strings are stored by pointer, so they must outlive the record (e.g. string
+/// literals).
+struct LogArg {
+    enum Type : uint8_t {
+        INT32,
+        UINT32,
+        INT64,
+        UINT64,
+        DOUBLE,
+        STRING,
+    };
+
+    Type type;
+    union {
+        int32_t i32;
+        uint32_t u32;
+        int64_t i64;
+        uint64_t u64;
+        double d;
+        const char *s;
+    };
+
+    /// Integers are stored in the narrowest of 32 or 64 bits that holds them, keeping their signedness.
+    template <typename T, std::enable_if_t<std::is_integral_v<T>, int> = 0>
+    LogArg(T value) {
+        if constexpr (std::is_signed_v<T>) {
+            if constexpr (sizeof(T) <= 4) { type = INT32; i32 = value; } else { type = INT64; i64 = value; }
+        } else {
+            if constexpr (sizeof(T) <= 4) { type = UINT32; u32 = value; } else { type = UINT64; u64 = value; }
+        }
+    }
+    LogArg(double value) : type(DOUBLE), d(value) {}
+    LogArg(const char *value) : type(STRING), s(value) {}
+};
+
+/// Messages below this level are removed from log<Level>() calls at compile time. Define LOG_COMPILE_MIN_LEVEL (e.g. as
+/// WARNING) to strip chatty messages from a release build.
+#ifndef LOG_COMPILE_MIN_LEVEL
+#define LOG_COMPILE_MIN_LEVEL INFORMATION
+#endif
+
+/// The largest number of arguments a deferred record can hold.
+constexpr size_t LOG_MAX_ARGS = 4;
+
+/// The number of records the deferred log can hold per core before it starts dropping them.
+constexpr size_t LOG_QUEUE_LENGTH = 64;
+
 /// Set the log level. Messages with a level below this threshold will be discarded.
 void setLogLevel(LogLevel newLevel);
 
-/// Log a new message.
+/// Log a new message. In deferred mode the message is copied (and truncated if it is very long).
 void log(LogLevel level, const char *msg);
+
+/// Log a printf-style message. In deferred mode only the format pointer and the arguments are stored, so the format
+/// must be a string literal. Conversions must match the argument types (e.g. %d for int, %f for double).
+void logValues(LogLevel level, const char *fmt, std::initializer_list<LogArg> args);
+
+/// Returns true if messages of this level pass the runtime threshold set by setLogLevel().
+bool logLevelEnabled(LogLevel level);
+
+/// Print (immediate mode) or queue (deferred mode) a message whose arguments have already been captured. Used by
+/// log<Level>() and logValues(); the level must already have been checked with logLevelEnabled().
+void logCaptured(LogLevel level, const char *fmt, const LogArg *args, size_t count);
+
+/// Log a printf-style message with a level fixed at compile time, e.g. `log<WARNING>("x=%d", x)`.
+/// - Calls below LOG_COMPILE_MIN_LEVEL compile to nothing.
+/// - The runtime threshold is checked before any argument is captured or formatted.
+/// - Arguments are captured by type, so a mismatched conversion (e.g. %d given a double) is converted rather than
+///   read as the wrong type. Formatting happens into a stack buffer, or later in logDrain() when deferred.
+template <LogLevel Level, typename... Args>
+inline void log(const char *fmt, Args... args)
+{
+    static_assert(sizeof...(Args) <= LOG_MAX_ARGS, "Too many arguments for one log record");
+    static_assert((std::is_constructible_v<LogArg, Args> && ...),
+                  "Log arguments must be integers, floating point or C strings");
+
+    if constexpr (Level >= LogLevel::LOG_COMPILE_MIN_LEVEL) {
+        if (!logLevelEnabled(Level)) {
+            return;
+        }
+        // The extra element keeps the array valid when there are no arguments
+        const LogArg captured[sizeof...(Args) + 1] = {LogArg(args)..., LogArg(0)};
+        logCaptured(Level, fmt, captured, sizeof...(Args));
+    }
+}
+
+/// Select immediate or deferred output.
+void setLogMode(LogMode mode);
+
+/// Format and print up to maxRecords queued records. Returns the number printed. Call this from a background context
+/// (e.g. core 1), or use logStartDrainOnCore1().
+size_t logDrain(size_t maxRecords = LOG_QUEUE_LENGTH);
+
+/// Launch core 1 (a thread in the native build) to drain the deferred log continuously. Core 1 allows core 0 to pause
+/// it with flash_safe_execute().
+void logStartDrainOnCore1();
+
+/// Number of records dropped because the queue was full.
+uint32_t logDroppedCount();
@@ -0,0 +1,329 @@
+// Flash sample recorder
+
+#include <string.h>
+#include "pico/stdlib.h"
+#include "pico/flash.h"
+#include "hardware/flash.h"
+
+#include "drivers/logging/logging.h"
+#include "recorder.h"
+
+static_assert(RECORDER_SECTOR_SIZE == FLASH_SECTOR_SIZE, "The recorder's sectors must be the flash's erase unit");
+
+#ifndef TEST_HARNESS
+// End of the program in flash, from the linker script
+extern char __flash_binary_end;
+#endif
+
+// How long flash_safe_execute() may wait for the other core to pause
+#define RECORDER_LOCKOUT_TIMEOUT_MS 100
+
+AccelRecorder::AccelRecorder(uint32_t flashOffset, uint32_t flashSize)
+    : flashOffset(flashOffset), sectorCount(flashSize / FLASH_SECTOR_SIZE), ready(false), pending(), pendingCount(0),
+      pendingFirstUs(0), pendingLastUs(0), sequence(0), firstSequence(0), hasSector(false), sectorOffset(0), page(),
+      pageStart(0), pageDirty(false), stats() {
+}
+
+// --- Flash access ---
+
+const uint8_t* AccelRecorder::sectorData(uint32_t seq) const {
+    return (const uint8_t*)(XIP_BASE + flashOffset + (seq % sectorCount) * FLASH_SECTOR_SIZE);
+}
+
+// An erase (no data) or a page write, passed through flash_safe_execute()
+struct FlashOperation {
+    uint32_t offset;
+    const uint8_t* data;
+};
+
+static void runFlashOperation(void* param) {
+    const FlashOperation& operation = *static_cast<const FlashOperation*>(param);
+    if (operation.data) {
+        flash_range_program(operation.offset, operation.data, FLASH_PAGE_SIZE);
+    } else {
+        flash_range_erase(operation.offset, FLASH_SECTOR_SIZE);
+    }
+}
+
+bool AccelRecorder::flashOperation(uint32_t offset, const uint8_t* data) {
+    FlashOperation operation = {offset, data};
+    int result = flash_safe_execute(runFlashOperation, &operation, RECORDER_LOCKOUT_TIMEOUT_MS);
+    if (result != 0) {
+        if (stats.flashErrors++ == 0) {
+            log<LogLevel::ERROR>("Recorder: Flash write failed (error %d). Has core 1 called "
+                                 "flash_safe_execute_core_init()?", result);
+        }
+        return false;
+    }
+    if (data) {
+        stats.pagesProgrammed++;
+    } else {
+        stats.sectorsErased++;
+    }
+    return true;
+}
+
+void AccelRecorder::programPage() {
+    uint32_t offset = flashOffset + (sequence % sectorCount) * FLASH_SECTOR_SIZE + pageStart;
+    if (flashOperation(offset, page)) {
+        pageDirty = false;
+    }
+}
+
+// --- Setup ---
+
+bool AccelRecorder::init() {
+    if (sectorCount == 0 || flashOffset % FLASH_SECTOR_SIZE != 0 ||
+        flashOffset + sectorCount * FLASH_SECTOR_SIZE > PICO_FLASH_SIZE_BYTES) {
+        log(LogLevel::ERROR, "Recorder: The flash region is not whole sectors within the flash.");
+        return false;
+    }
+#ifndef TEST_HARNESS
+    if (XIP_BASE + flashOffset < (uintptr_t)&__flash_binary_end) {
+        log(LogLevel::ERROR, "Recorder: The flash region overlaps the program.");
+        return false;
+    }
+#endif
+
+    stats = {};
+    pendingCount = 0;
+    pageDirty = false;
+    memset(page, 0xFF, sizeof(page));
+
+    RecorderExtent extent;
+    hasSector = recorderFindRecording((const uint8_t*)(XIP_BASE + flashOffset), sectorCount, extent);
+    stats.maxEraseCount = extent.maxEraseCount;
+    if (!hasSector) {
+        sequence = 0;
+        firstSequence = 0;
+        ready = true;
+        return true;
+    }
+
+    // Carry on after the last whole chunk. A damaged one (a write cut short by a reset) ends the sector.
+    sequence = extent.newest;
+    firstSequence = extent.oldest;
+    const uint8_t* sector = sectorData(sequence);
+    size_t offset = RECORDER_SECTOR_HEADER_SIZE;
+    RecorderSample samples[RECORDER_MAX_CHUNK_SAMPLES];
+    int result;
+    while ((result = recorderDecodeChunk(sector, offset, samples)) > 0) {
+    }
+    sectorOffset = result < 0 ? RECORDER_SECTOR_SIZE : (uint32_t)offset;
+
+    // The page the recording ends in is written again as it fills, so start from what it already holds
+    pageStart = sectorOffset / FLASH_PAGE_SIZE * FLASH_PAGE_SIZE;
+    if (pageStart < RECORDER_SECTOR_SIZE) {
+        memcpy(page, sector + pageStart, sectorOffset - pageStart);
+    }
+
+    ready = true;
+    log<LogLevel::INFORMATION>("Recorder: Resuming at sector %u of the recording, %u of %u bytes used",
+                               sequence - firstSequence + 1, sectorOffset, (uint32_t)RECORDER_SECTOR_SIZE);
+    return true;
+}
+
+// --- Writing ---
+
+void AccelRecorder::startSector() {
+    if (hasSector && pageDirty) {
+        programPage();
+    }
+    uint32_t next = hasSector ? sequence + 1 : sequence;
+    uint32_t offset = flashOffset + (next % sectorCount) * FLASH_SECTOR_SIZE;
+
+    // Keep the sector's erase count from its old header
+    RecorderSectorHeader header = {next, 1, firstSequence};
+    RecorderSectorHeader old;
+    if (recorderReadSectorHeader(sectorData(next), old)) {
+        header.eraseCount = old.eraseCount + 1;
+    }
+    if (!flashOperation(offset, nullptr)) {
+        return;
+    }
+    if (header.eraseCount > stats.maxEraseCount) {
+        stats.maxEraseCount = header.eraseCount;
+    }
+
+    // Write the header straight away, so the erase count survives a reset before the first page fills
+    sequence = next;
+    hasSector = true;
+    pageStart = 0;
+    memset(page, 0xFF, sizeof(page));
+    recorderWriteSectorHeader(page, header);
+    sectorOffset = RECORDER_SECTOR_HEADER_SIZE;
+    stats.bytes += RECORDER_SECTOR_HEADER_SIZE;
+    programPage();
+}
+
+void AccelRecorder::append(const uint8_t* data, size_t length) {
+    if (!hasSector || sectorOffset + length > RECORDER_SECTOR_SIZE) {
+        startSector();
+        if (!hasSector || sectorOffset + length > RECORDER_SECTOR_SIZE) {
+            return; // The erase failed
+        }
+    }
+    stats.bytes += (uint32_t)length;
+
+    bool crossedPage = false;
+    while (length > 0) {
+        size_t inPage = sectorOffset - pageStart;
+        size_t count = FLASH_PAGE_SIZE - inPage < length ? FLASH_PAGE_SIZE - inPage : length;
+        memcpy(page + inPage, data, count);
+        sectorOffset += (uint32_t)count;
+        data += count;
+        length -= count;
+        pageDirty = true;
+
+        if (sectorOffset - pageStart == FLASH_PAGE_SIZE) {
+            programPage();
+            pageStart += FLASH_PAGE_SIZE;
+            memset(page, 0xFF, sizeof(page));
+            pageDirty = false;
+            crossedPage = true;
+        }
+    }
+
+    // A chunk that ran into the next page would be left torn in flash until that page fills, and a reset then would
+    // lose the rest of the sector, so write its end now
+    if (crossedPage && pageDirty) {
+        programPage();
+    }
+}
+
+void AccelRecorder::writeChunk() {
+    if (pendingCount == 0) {
+        return;
+    }
+    uint32_t period = 0;
+    if (pendingCount > 1) {
+        uint32_t span = pendingLastUs - pendingFirstUs;
+        period = (span + (uint32_t)(pendingCount - 1) / 2) / (uint32_t)(pendingCount - 1);
+    }
+    uint8_t chunk[RECORDER_MAX_CHUNK_SIZE];
+    size_t length = recorderEncodeChunk(pending, pendingCount, pendingFirstUs, period, chunk);
+    pendingCount = 0;
+    append(chunk, length);
+}
+
+void AccelRecorder::record(const AccelSample* samples, size_t count) {
+    if (!ready) {
+        return;
+    }
+    for (size_t i = 0; i < count; ++i) {
+        const AccelSample& sample = samples[i];
+
+        // A gap in the samples, or a change of rate, would throw out the even spacing, so it starts a new chunk
+        if (pendingCount > 1) {
+            uint32_t period = (pendingLastUs - pendingFirstUs) / (uint32_t)(pendingCount - 1);
+            uint32_t step = sample.timestamp_us - pendingLastUs;
+            if (step > period + period / 2 || step < period / 2) {
+                writeChunk();
+            }
+        }
+
+        if (pendingCount == 0) {
+            pendingFirstUs = sample.timestamp_us;
+        }
+        pending[pendingCount][0] = sample.x_mg;
+        pending[pendingCount][1] = sample.y_mg;
+        pending[pendingCount][2] = sample.z_mg;
+        pendingLastUs = sample.timestamp_us;
+        if (++pendingCount == RECORDER_MAX_CHUNK_SAMPLES) {
+            writeChunk();
+        }
+    }
+    stats.samples += (uint32_t)count;
+}
+
+void AccelRecorder::flush() {
+    writeChunk();
+    if (hasSector && pageDirty) {
+        programPage();
+    }
+}
+
+void AccelRecorder::clear() {
+    if (!ready) {
+        return;
+    }
+    pendingCount = 0;
+    pageDirty = false;
+    firstSequence = hasSector ? sequence + 1 : sequence;
+    startSector();
+}
+
+// --- Reading ---
+
+RecorderCursor AccelRecorder::begin() const {
+    // As in recorderFindRecording(), the sectors before the last sectorCount have been reused
+    uint32_t oldest = firstSequence;
+    if (sequence >= sectorCount && sequence - sectorCount + 1 > oldest) {
+        oldest = sequence - sectorCount + 1;
+    }
+    return {oldest, RECORDER_SECTOR_HEADER_SIZE, 0};
+}
+
+size_t AccelRecorder::read(RecorderCursor& cursor, AccelSample* samples, size_t max) const {
+    if (!ready || !hasSector) {
+        return 0;
+    }
+    RecorderCursor oldest = begin();
+    if (cursor.sequence < oldest.sequence) {
+        cursor = oldest;
+    }
+
+    RecorderSample decoded[RECORDER_MAX_CHUNK_SAMPLES];
+    while (max > 0 && cursor.sequence <= sequence) {
+        const uint8_t* sector = sectorData(cursor.sequence);
+        RecorderSectorHeader header;
+        size_t offset = cursor.offset;
+        int count = 0;
+        if (recorderReadSectorHeader(sector, header) && header.sequence == cursor.sequence) {
+            count = recorderDecodeChunk(sector, offset, decoded);
+        }
+
+        // At the end of a sector (or a damaged chunk, or a sector missing after a failed erase) go on to the next,
+        // unless this is the one being written
+        if (count <= 0) {
+            if (cursor.sequence == sequence) {
+                break;
+            }
+            cursor = {cursor.sequence + 1, RECORDER_SECTOR_HEADER_SIZE, 0};
+            continue;
+        }
+
+        size_t available = (size_t)count - cursor.skip;
+        size_t take = available < max ? available : max;
+        for (size_t i = 0; i < take; ++i) {
+            const RecorderSample& sample = decoded[cursor.skip + i];
+            samples[i] = {sample.x_mg, sample.y_mg, sample.z_mg, AccelStatus::OK, sample.timestamp_us};
+        }
+        if (take == available) {
+            cursor.offset = (uint32_t)offset;
+            cursor.skip = 0;
+        } else {
+            cursor.skip += (uint32_t)take;
+        }
+        return take;
+    }
+    return 0;
+}
+
+// --- Statistics ---
+
+RecorderStats AccelRecorder::getStats() const {
+    return stats;
+}
+
+void AccelRecorder::logStats() const {
+    if (stats.samples > 0) {
+        log<LogLevel::INFORMATION>("Recorder: %u samples in %u bytes, %.2f bytes per sample", stats.samples,
+                                   stats.bytes, (double)stats.bytes / stats.samples);
+    }
+    log<LogLevel::INFORMATION>("Recorder: %u sectors erased, %u pages written, most erases of a sector %u",
+                               stats.sectorsErased, stats.pagesProgrammed, stats.maxEraseCount);
+    if (stats.flashErrors > 0) {
+        log<LogLevel::WARNING>("Recorder: %u flash writes failed", stats.flashErrors);
+    }
+}
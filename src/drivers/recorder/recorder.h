@@ -0,0 +1,128 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include "hardware/flash.h"
+#include "drivers/LIS3DH/LIS3DH.h"
+#include "recorder_format.h"
+
+// Flash given to the recorder: the last 256 KB, far past the end of the program. At 400 Hz and about 3 bytes per
+// sample that holds around three and a half minutes.
+#ifndef RECORDER_FLASH_SIZE
+#define RECORDER_FLASH_SIZE (256 * 1024)
+#endif
+#ifndef RECORDER_FLASH_OFFSET
+#define RECORDER_FLASH_OFFSET (PICO_FLASH_SIZE_BYTES - RECORDER_FLASH_SIZE)
+#endif
+
+// Counters since init()
+struct RecorderStats {
+    uint32_t samples;         // Samples recorded
+    uint32_t bytes;           // Flash those took, including the chunk and sector headers
+    uint32_t sectorsErased;
+    uint32_t pagesProgrammed; // Page writes, counting a page again each time flush() adds to it
+    uint32_t maxEraseCount;   // Most times any sector in the region has been erased, for wear
+    uint32_t flashErrors;     // Erases or writes that flash_safe_execute() refused
+};
+
+// Position in the recording, for reading it back
+struct RecorderCursor {
+    uint32_t sequence; // Sector being read
+    uint32_t offset;   // Next chunk in the sector
+    uint32_t skip;     // Samples of that chunk already read
+};
+
+// AccelRecorder keeps a record of accelerometer samples in flash, across resets.
+//
+// Samples are delta and varint encoded in batches of up to 32 (see recorder_format.h), built up in a page buffer in
+// RAM and written a page (256 bytes) at a time. The region is a circular log of 4 KB sectors: when it is full the
+// oldest sector is erased and reused, so sectors wear evenly and the newest samples are kept. init() finds the newest
+// sector again after a reset and carries on after it.
+//
+// Erasing a sector takes around 45 ms and writing a page under 1 ms, during which the other core is paused and
+// interrupts are disabled (flash_safe_execute()), so the other core, if it is running, must have called
+// flash_safe_execute_core_init().
+// An erase happens once every ~1300 samples; call record() just after draining the FIFO so it has room for them.
+class AccelRecorder {
+    private:
+        uint32_t flashOffset;
+        uint32_t sectorCount;
+        bool ready;
+
+        // Samples waiting to be encoded as a chunk, and the times of the first and last
+        int16_t pending[RECORDER_MAX_CHUNK_SAMPLES][3];
+        size_t pendingCount;
+        uint32_t pendingFirstUs;
+        uint32_t pendingLastUs;
+
+        // Sector being written (valid once hasSector is set), the first sector of the recording, and the bytes
+        // used in the sector
+        uint32_t sequence;
+        uint32_t firstSequence;
+        bool hasSector;
+        uint32_t sectorOffset;
+
+        // Page being filled, which starts at pageStart in the sector, and whether it holds bytes not yet in flash
+        uint8_t page[FLASH_PAGE_SIZE];
+        uint32_t pageStart;
+        bool pageDirty;
+
+        RecorderStats stats;
+
+        // sectorData() returns where the sector that holds [seq] can be read, through the XIP window
+        const uint8_t* sectorData(uint32_t seq) const;
+
+        // writeChunk() encodes the pending samples and adds them to the log
+        void writeChunk();
+
+        // append() adds a chunk to the page buffer, writing pages as they fill and starting a new sector if the chunk
+        // doesn't fit in this one
+        void append(const uint8_t* data, size_t length);
+
+        // startSector() finishes the current sector, then erases the next one in the ring and writes its header
+        void startSector();
+
+        // programPage() writes the page buffer to flash
+        void programPage();
+
+        // flashOperation() runs an erase or page write with the other core paused. Returns false if it didn't run.
+        bool flashOperation(uint32_t offset, const uint8_t* data);
+
+    public:
+        // The region must be whole sectors. It is fixed by the flash layout, so it is normally left at the default.
+        explicit AccelRecorder(uint32_t flashOffset = RECORDER_FLASH_OFFSET,
+                               uint32_t flashSize = RECORDER_FLASH_SIZE);
+
+        // init() checks the region and finds the end of the recording already in it. Returns false, and records
+        // nothing, if the region is not usable.
+        bool init();
+
+        // record() adds samples to the recording. The samples in each chunk are stored as evenly spaced, from the
+        // first timestamp to the last, which suits the consecutive FIFO drains they come from.
+        void record(const AccelSample* samples, size_t count);
+
+        // flush() writes every sample recorded so far to flash, e.g. before reading the recording back or powering
+        // down. The partly filled page is written again as it fills, which the flash allows.
+        void flush();
+
+        // clear() starts a new recording. It costs one sector erase however much was recorded: the old sectors are
+        // only erased as they are reused.
+        void clear();
+
+        // - Reading back -
+
+        // begin() returns a cursor at the oldest sample still in flash
+        RecorderCursor begin() const;
+
+        // read() reads up to [max] samples from [cursor] on, and moves the cursor past them. The samples come from
+        // one chunk, so they are evenly spaced in time. Returns 0 at the end of what has been written to flash (see
+        // flush()). A cursor whose sector has been reused since moves on to the oldest sample left.
+        size_t read(RecorderCursor& cursor, AccelSample* samples, size_t max) const;
+
+        // - Statistics -
+
+        RecorderStats getStats() const;
+
+        // logStats() logs the samples recorded, the bytes per sample and the wear on the region
+        void logStats() const;
+};
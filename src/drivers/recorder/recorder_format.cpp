@@ -0,0 +1,195 @@
+// Flash recorder layout: sector headers and delta-encoded sample chunks
+
+#include "recorder_format.h"
+#include "drivers/telemetry/telemetry_protocol.h"
+
+// --- Helpers
+
+static void putU16(uint8_t *out, uint16_t value)
+{
+    out[0] = (uint8_t)value;
+    out[1] = (uint8_t)(value >> 8);
+}
+
+static void putU32(uint8_t *out, uint32_t value)
+{
+    putU16(out, (uint16_t)value);
+    putU16(out + 2, (uint16_t)(value >> 16));
+}
+
+static uint16_t getU16(const uint8_t *in)
+{
+    return (uint16_t)(in[0] | (in[1] << 8));
+}
+
+static uint32_t getU32(const uint8_t *in)
+{
+    return (uint32_t)getU16(in) | ((uint32_t)getU16(in + 2) << 16);
+}
+
+/// Seven bits per byte, low bits first, with the top bit set on every byte but the last. Returns the bytes written.
+static size_t putVarint(uint8_t *out, uint32_t value)
+{
+    size_t length = 0;
+    while (value >= 0x80) {
+        out[length++] = (uint8_t)(value | 0x80);
+        value >>= 7;
+    }
+    out[length++] = (uint8_t)value;
+    return length;
+}
+
+/// Returns false if the varint runs past end or is longer than a uint32_t needs
+static bool getVarint(const uint8_t *&in, const uint8_t *end, uint32_t &value)
+{
+    value = 0;
+    for (int shift = 0; shift < 35; shift += 7) {
+        if (in == end) {
+            return false;
+        }
+        uint8_t byte = *in++;
+        value |= (uint32_t)(byte & 0x7F) << shift;
+        if (!(byte & 0x80)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+static uint32_t zigzag(int32_t value)
+{
+    return ((uint32_t)value << 1) ^ (uint32_t)(value >> 31);
+}
+
+static int32_t unzigzag(uint32_t value)
+{
+    return (int32_t)(value >> 1) ^ -(int32_t)(value & 1);
+}
+
+// --- Sectors
+
+void recorderWriteSectorHeader(uint8_t *out, const RecorderSectorHeader &header)
+{
+    putU32(out, RECORDER_MAGIC);
+    out[4] = RECORDER_VERSION;
+    out[5] = out[6] = out[7] = 0;
+    putU32(out + 8, header.sequence);
+    putU32(out + 12, header.eraseCount);
+    putU32(out + 16, header.firstSequence);
+}
+
+bool recorderReadSectorHeader(const uint8_t *sector, RecorderSectorHeader &header)
+{
+    if (getU32(sector) != RECORDER_MAGIC || sector[4] != RECORDER_VERSION) {
+        return false;
+    }
+    header.sequence = getU32(sector + 8);
+    header.eraseCount = getU32(sector + 12);
+    header.firstSequence = getU32(sector + 16);
+    return true;
+}
+
+bool recorderFindRecording(const uint8_t *region, size_t sectorCount, RecorderExtent &extent)
+{
+    bool found = false;
+    RecorderSectorHeader newest = {};
+    extent = {};
+    for (size_t index = 0; index < sectorCount; ++index) {
+        RecorderSectorHeader header;
+        if (!recorderReadSectorHeader(region + index * RECORDER_SECTOR_SIZE, header) ||
+            header.sequence % sectorCount != index) {
+            continue;
+        }
+        if (header.eraseCount > extent.maxEraseCount) {
+            extent.maxEraseCount = header.eraseCount;
+        }
+        if (!found || header.sequence > newest.sequence) {
+            newest = header;
+            found = true;
+        }
+    }
+    if (!found) {
+        return false;
+    }
+
+    // Sectors before the last sectorCount have been reused, and the ones before firstSequence were cleared
+    extent.newest = newest.sequence;
+    extent.oldest = newest.firstSequence;
+    if (newest.sequence >= sectorCount && newest.sequence - sectorCount + 1 > extent.oldest) {
+        extent.oldest = newest.sequence - (uint32_t)sectorCount + 1;
+    }
+    return true;
+}
+
+// --- Chunks
+
+size_t recorderEncodeChunk(const int16_t (*xyz)[3], size_t count, uint32_t timestamp_us, uint32_t period_us,
+                           uint8_t *out)
+{
+    uint8_t *payload = out + RECORDER_CHUNK_HEADER_SIZE;
+    uint8_t *p = payload;
+    putU32(p, timestamp_us);
+    p += 4;
+    p += putVarint(p, period_us);
+
+    int32_t previous[3] = {0, 0, 0};
+    for (size_t i = 0; i < count; ++i) {
+        for (int axis = 0; axis < 3; ++axis) {
+            p += putVarint(p, zigzag(xyz[i][axis] - previous[axis]));
+            previous[axis] = xyz[i][axis];
+        }
+    }
+
+    size_t length = (size_t)(p - payload);
+    out[0] = (uint8_t)count;
+    out[1] = RECORDER_CHUNK_SAMPLES;
+    putU16(out + 2, (uint16_t)length);
+    putU16(out + 4, telemetryCrc16(payload, length));
+    return RECORDER_CHUNK_HEADER_SIZE + length;
+}
+
+int recorderDecodeChunk(const uint8_t *sector, size_t &offset, RecorderSample *samples)
+{
+    if (offset >= RECORDER_SECTOR_SIZE || sector[offset] == RECORDER_END) {
+        return 0;
+    }
+    if (offset + RECORDER_CHUNK_HEADER_SIZE > RECORDER_SECTOR_SIZE) {
+        return -1;
+    }
+
+    const uint8_t *header = sector + offset;
+    size_t count = header[0];
+    size_t length = getU16(header + 2);
+    const uint8_t *p = header + RECORDER_CHUNK_HEADER_SIZE;
+    const uint8_t *end = p + length;
+    if (count == 0 || count > RECORDER_MAX_CHUNK_SAMPLES || header[1] != RECORDER_CHUNK_SAMPLES ||
+        offset + RECORDER_CHUNK_HEADER_SIZE + length > RECORDER_SECTOR_SIZE || length < 4 ||
+        telemetryCrc16(p, length) != getU16(header + 4)) {
+        return -1;
+    }
+
+    uint32_t timestamp = getU32(p);
+    p += 4;
+    uint32_t period;
+    if (!getVarint(p, end, period)) {
+        return -1;
+    }
+
+    int32_t values[3] = {0, 0, 0};
+    for (size_t i = 0; i < count; ++i) {
+        for (int axis = 0; axis < 3; ++axis) {
+            uint32_t delta;
+            if (!getVarint(p, end, delta)) {
+                return -1;
+            }
+            values[axis] += unzigzag(delta);
+        }
+        samples[i] = {timestamp + (uint32_t)i * period, (int16_t)values[0], (int16_t)values[1], (int16_t)values[2]};
+    }
+    if (p != end) {
+        return -1;
+    }
+
+    offset = (size_t)(end - sector);
+    return (int)count;
+}
@@ -0,0 +1,94 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+
+// Flash recorder layout, shared by the firmware and the host tools (so it must not depend on the Pico SDK).
+//
+// The recorder's region of flash is a ring of 4 KB sectors. They are written in order and each is erased just before
+// it is reused, so every sector wears at the same rate. Each sector starts with a header, little-endian:
+//
+//     u32  magic          RECORDER_MAGIC
+//     u8   version        RECORDER_VERSION
+//     u8   reserved[3]
+//     u32  sequence       Goes up by one for each sector written, so sector sequence % sectors is the next after it
+//     u32  erase count    Times this sector has been erased, carried over from its previous header
+//     u32  first          Sequence of the recording's first sector, so clearing a recording costs no erases
+//
+// Then come chunks, each a batch of up to RECORDER_MAX_CHUNK_SAMPLES evenly spaced samples:
+//
+//     u8   count          Samples in the chunk, 1 to RECORDER_MAX_CHUNK_SAMPLES
+//     u8   type           RECORDER_CHUNK_SAMPLES
+//     u16  length         Payload bytes
+//     u16  crc            CRC-16/CCITT-FALSE of the payload (see telemetry_protocol.h), to catch a torn write
+//     payload:
+//         u32     timestamp    Time of the first sample, microseconds since boot
+//         varint  period       Time between samples, microseconds
+//         count x { varint x, varint y, varint z }
+//
+// Each axis is in mg, zigzag encoded (0, -1, 1, -2... become 0, 1, 2, 3...) and stored as a LEB128 varint: the first
+// sample as it is and the rest as the change from the sample before. Consecutive samples differ by little, so most
+// changes take a byte, against two for a packed int16. A count of 0xFF (erased flash) ends the sector's chunks.
+
+/// "AREC"
+constexpr uint32_t RECORDER_MAGIC = 0x43455241;
+constexpr uint8_t RECORDER_VERSION = 1;
+
+/// Chunk type byte for a batch of accelerometer samples
+constexpr uint8_t RECORDER_CHUNK_SAMPLES = 1;
+
+/// Most samples in one chunk: a full LIS3DH FIFO
+constexpr size_t RECORDER_MAX_CHUNK_SAMPLES = 32;
+
+constexpr size_t RECORDER_SECTOR_SIZE = 4096;
+constexpr size_t RECORDER_SECTOR_HEADER_SIZE = 20;
+constexpr size_t RECORDER_CHUNK_HEADER_SIZE = 6;
+
+/// Largest chunk: the timestamp, a 5-byte period and three 3-byte varints per sample
+constexpr size_t RECORDER_MAX_CHUNK_SIZE = RECORDER_CHUNK_HEADER_SIZE + 4 + 5 + RECORDER_MAX_CHUNK_SAMPLES * 3 * 3;
+
+/// First byte of erased flash, where the next chunk would go
+constexpr uint8_t RECORDER_END = 0xFF;
+
+/// A decoded sector header
+struct RecorderSectorHeader {
+    uint32_t sequence;
+    uint32_t eraseCount;
+    uint32_t firstSequence;
+};
+
+/// A decoded sample, in the same units as AccelSample
+struct RecorderSample {
+    uint32_t timestamp_us;
+    int16_t x_mg;
+    int16_t y_mg;
+    int16_t z_mg;
+};
+
+/// Where a recording lies in a region, by sector sequence number
+struct RecorderExtent {
+    uint32_t oldest;        // Oldest sector still holding samples from the recording
+    uint32_t newest;        // Sector written last
+    uint32_t maxEraseCount; // Most times any sector in the region has been erased
+};
+
+/// Write a sector header into out, which must hold RECORDER_SECTOR_HEADER_SIZE bytes
+void recorderWriteSectorHeader(uint8_t *out, const RecorderSectorHeader &header);
+
+/// Read the header at the start of a sector. Returns false if there isn't one, as in an erased sector.
+bool recorderReadSectorHeader(const uint8_t *sector, RecorderSectorHeader &header);
+
+/// Find the recording in a region of sectorCount sectors, which sector sequence % sectorCount holds. Returns false if
+/// the region holds none. A header in the wrong sector for its sequence, as left by a region of a different size, is
+/// ignored.
+bool recorderFindRecording(const uint8_t *region, size_t sectorCount, RecorderExtent &extent);
+
+/// Encode count samples (1 to RECORDER_MAX_CHUNK_SAMPLES, x, y, z in mg), the first at timestamp_us and the rest
+/// period_us apart, as a chunk into out, which must hold RECORDER_MAX_CHUNK_SIZE bytes. Returns the chunk's length.
+size_t recorderEncodeChunk(const int16_t (*xyz)[3], size_t count, uint32_t timestamp_us, uint32_t period_us,
+                           uint8_t *out);
+
+/// Decode the chunk at offset in a sector into samples, which must hold RECORDER_MAX_CHUNK_SAMPLES. On success,
+/// returns the number of samples and moves offset past the chunk. Returns 0 at the end of the sector's chunks and -1
+/// if the chunk is damaged, leaving offset where it was.
+int recorderDecodeChunk(const uint8_t *sector, size_t &offset, RecorderSample *samples);
@@ -0,0 +1,79 @@
+// Binary telemetry output, using the style that state is global in the C file.
+
+#include "pico/stdlib.h"
+#include "hardware/uart.h"
+#include "telemetry.h"
+
+// --- Internal state
+
+/// Sequence number of the next frame
+static uint16_t nextSequence = 0;
+
+static TelemetryStats stats = {};
+
+/// Frame being built, with room for the CRC, and its encoded form
+static uint8_t rawFrame[TELEMETRY_MAX_RAW_SIZE];
+static uint8_t encodedFrame[TELEMETRY_MAX_ENCODED_SIZE];
+
+// --- Internal functions
+
+static void putU16(uint8_t *out, uint16_t value)
+{
+    out[0] = (uint8_t)value;
+    out[1] = (uint8_t)(value >> 8);
+}
+
+static void putU32(uint8_t *out, uint32_t value)
+{
+    putU16(out, (uint16_t)value);
+    putU16(out + 2, (uint16_t)(value >> 16));
+}
+
+/// Build, encode and write one frame of up to TELEMETRY_MAX_SAMPLES samples
+static void sendFrame(const AccelSample *samples, size_t count, uint32_t period)
+{
+    rawFrame[0] = TELEMETRY_TYPE_SAMPLES;
+    rawFrame[1] = (uint8_t)count;
+    putU16(rawFrame + 2, nextSequence++);
+    putU32(rawFrame + 4, samples[0].timestamp_us);
+    putU32(rawFrame + 8, period);
+
+    uint8_t *out = rawFrame + TELEMETRY_HEADER_SIZE;
+    for (size_t i = 0; i < count; ++i) {
+        putU16(out, (uint16_t)samples[i].x_mg);
+        putU16(out + 2, (uint16_t)samples[i].y_mg);
+        putU16(out + 4, (uint16_t)samples[i].z_mg);
+        out += TELEMETRY_SAMPLE_SIZE;
+    }
+
+    size_t length = telemetryFinishFrame(rawFrame, (size_t)(out - rawFrame), encodedFrame);
+    uart_write_blocking(uart_default, encodedFrame, length);
+
+    stats.frames++;
+    stats.samples += (uint32_t)count;
+    stats.bytes += (uint32_t)length;
+}
+
+// --- Telemetry functions
+
+void telemetrySendSamples(const AccelSample *samples, size_t count)
+{
+    if (count == 0) {
+        return;
+    }
+
+    // The spacing of the whole batch, so frames split from it share the same period
+    uint32_t period = count > 1 ? (samples[count - 1].timestamp_us - samples[0].timestamp_us) / (uint32_t)(count - 1) : 0;
+
+    while (count > 0) {
+        size_t frameCount = count < TELEMETRY_MAX_SAMPLES ? count : TELEMETRY_MAX_SAMPLES;
+        sendFrame(samples, frameCount, period);
+        samples += frameCount;
+        count -= frameCount;
+    }
+}
+
+TelemetryStats telemetryGetStats()
+{
+    return stats;
+}
@@ -0,0 +1,25 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include "drivers/LIS3DH/LIS3DH.h"
+#include "telemetry_protocol.h"
+
+/// Counters since boot
+struct TelemetryStats {
+    uint32_t frames;  // Frames sent
+    uint32_t samples; // Samples in those frames
+    uint32_t bytes;   // Bytes written to the UART, including framing
+};
+
+/// Send samples as binary telemetry frames (see telemetry_protocol.h) on the stdio UART, next to the log output. Up to
+/// TELEMETRY_MAX_SAMPLES go in each frame, at about 7 bytes per sample against 80 for a line of text. The samples must
+/// be evenly spaced in time, as a FIFO drain is: each frame stores the first timestamp and the period.
+///
+/// The frame is written in one go, but nothing stops the log writing between its bytes if another core is printing at
+/// the same time, which would damage it. Call this only from the core that drains the log, between calls to
+/// logDrain(), as the pipeline and the scheduled main loop do. Not reentrant: call it from one core only.
+void telemetrySendSamples(const AccelSample *samples, size_t count);
+
+/// Counters since boot
+TelemetryStats telemetryGetStats();
@@ -0,0 +1,139 @@
+// Binary telemetry framing: CRC, COBS and the frame layout
+
+#include <string.h>
+#include "telemetry_protocol.h"
+
+// --- CRC
+
+/// Table for one byte at a time, built at compile time
+struct Crc16Table {
+    uint16_t entries[256];
+
+    constexpr Crc16Table() : entries() {
+        for (int byte = 0; byte < 256; ++byte) {
+            uint16_t crc = (uint16_t)(byte << 8);
+            for (int bit = 0; bit < 8; ++bit) {
+                crc = (crc & 0x8000) ? (uint16_t)((crc << 1) ^ 0x1021) : (uint16_t)(crc << 1);
+            }
+            entries[byte] = crc;
+        }
+    }
+};
+static constexpr Crc16Table crcTable;
+
+uint16_t telemetryCrc16(const uint8_t *data, size_t length, uint16_t crc)
+{
+    for (size_t i = 0; i < length; ++i) {
+        crc = (uint16_t)((crc << 8) ^ crcTable.entries[(crc >> 8) ^ data[i]]);
+    }
+    return crc;
+}
+
+// --- COBS
+
+size_t cobsEncode(const uint8_t *data, size_t length, uint8_t *out)
+{
+    // Each block starts with a code byte: the distance to the next zero (or 0xFF for 254 non-zero bytes and no zero)
+    size_t codeIndex = 0;
+    size_t written = 1;
+    uint8_t code = 1;
+
+    for (size_t i = 0; i < length; ++i) {
+        if (data[i] != 0) {
+            out[written++] = data[i];
+            code++;
+        }
+        if (data[i] == 0 || code == 0xFF) {
+            out[codeIndex] = code;
+            codeIndex = written++;
+            code = 1;
+        }
+    }
+    out[codeIndex] = code;
+    return written;
+}
+
+size_t cobsDecode(const uint8_t *data, size_t length, uint8_t *out)
+{
+    size_t read = 0;
+    size_t written = 0;
+
+    while (read < length) {
+        uint8_t code = data[read++];
+        if (code == 0 || read + code - 1 > length) {
+            return 0;
+        }
+        for (uint8_t i = 1; i < code; ++i) {
+            if (data[read] == 0) {
+                return 0;
+            }
+            out[written++] = data[read++];
+        }
+        // A block shorter than 254 bytes stands for a zero, except at the end
+        if (code != 0xFF && read < length) {
+            out[written++] = 0;
+        }
+    }
+    return written;
+}
+
+// --- Frames
+
+static void putU16(uint8_t *out, uint16_t value)
+{
+    out[0] = (uint8_t)value;
+    out[1] = (uint8_t)(value >> 8);
+}
+
+static uint16_t getU16(const uint8_t *in)
+{
+    return (uint16_t)(in[0] | (in[1] << 8));
+}
+
+static uint32_t getU32(const uint8_t *in)
+{
+    return (uint32_t)in[0] | ((uint32_t)in[1] << 8) | ((uint32_t)in[2] << 16) | ((uint32_t)in[3] << 24);
+}
+
+size_t telemetryFinishFrame(uint8_t *raw, size_t length, uint8_t *out)
+{
+    putU16(raw + length, telemetryCrc16(raw, length));
+    out[0] = 0;
+    size_t encoded = cobsEncode(raw, length + TELEMETRY_CRC_SIZE, out + 1);
+    out[1 + encoded] = 0;
+    return encoded + 2;
+}
+
+bool telemetryDecodeFrame(const uint8_t *encoded, size_t length, TelemetryFrame &frame)
+{
+    // Anything longer than the largest frame is text, so don't decode it
+    uint8_t raw[TELEMETRY_MAX_ENCODED_SIZE];
+    if (length == 0 || length > TELEMETRY_MAX_ENCODED_SIZE - 2) {
+        return false;
+    }
+    size_t rawLength = cobsDecode(encoded, length, raw);
+    if (rawLength < TELEMETRY_HEADER_SIZE + TELEMETRY_SAMPLE_SIZE + TELEMETRY_CRC_SIZE ||
+        raw[0] != TELEMETRY_TYPE_SAMPLES) {
+        return false;
+    }
+
+    uint8_t count = raw[1];
+    size_t payload = TELEMETRY_HEADER_SIZE + count * TELEMETRY_SAMPLE_SIZE;
+    if (count == 0 || count > TELEMETRY_MAX_SAMPLES || rawLength != payload + TELEMETRY_CRC_SIZE ||
+        telemetryCrc16(raw, payload) != getU16(raw + payload)) {
+        return false;
+    }
+
+    frame.count = count;
+    frame.sequence = getU16(raw + 2);
+    frame.timestamp_us = getU32(raw + 4);
+    frame.period_us = getU32(raw + 8);
+    const uint8_t *sample = raw + TELEMETRY_HEADER_SIZE;
+    for (size_t i = 0; i < count; ++i) {
+        for (int axis = 0; axis < 3; ++axis) {
+            frame.samples[i][axis] = (int16_t)getU16(sample + 2 * axis);
+        }
+        sample += TELEMETRY_SAMPLE_SIZE;
+    }
+    return true;
+}
@@ -0,0 +1,66 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+
+// Binary telemetry frame format, shared by the firmware and the host decoder (so it must not depend on the Pico SDK).
+//
+// A frame carries a batch of accelerometer samples. Before encoding it is, little-endian:
+//
+//     u8   type         TELEMETRY_TYPE_SAMPLES
+//     u8   count        Samples in the frame, 1 to TELEMETRY_MAX_SAMPLES
+//     u16  sequence     Frame counter, wrapping at 65536, so the receiver can count lost frames
+//     u32  timestamp    Time of the first sample, microseconds since boot
+//     u32  period       Time between samples, microseconds
+//     count x { i16 x, i16 y, i16 z }    Acceleration in mg
+//     u16  crc          CRC-16/CCITT-FALSE of everything above
+//
+// It is then COBS encoded, which removes every zero byte, and sent between two zero bytes. Text written to the same
+// UART contains no zeros either, so the receiver splits the stream at zeros and keeps the pieces that decode with a
+// good CRC; anything else is text, or a frame damaged in transit.
+
+/// Frame type byte for a batch of accelerometer samples (the high nibble is the format version)
+constexpr uint8_t TELEMETRY_TYPE_SAMPLES = 0x11;
+
+/// Most samples in one frame: a full LIS3DH FIFO
+constexpr size_t TELEMETRY_MAX_SAMPLES = 32;
+
+constexpr size_t TELEMETRY_HEADER_SIZE = 12;
+constexpr size_t TELEMETRY_SAMPLE_SIZE = 6;
+constexpr size_t TELEMETRY_CRC_SIZE = 2;
+
+/// Largest frame before encoding
+constexpr size_t TELEMETRY_MAX_RAW_SIZE =
+    TELEMETRY_HEADER_SIZE + TELEMETRY_MAX_SAMPLES * TELEMETRY_SAMPLE_SIZE + TELEMETRY_CRC_SIZE;
+
+/// Largest frame on the wire: COBS adds a byte per 254, plus the two delimiters
+constexpr size_t TELEMETRY_MAX_ENCODED_SIZE = TELEMETRY_MAX_RAW_SIZE + TELEMETRY_MAX_RAW_SIZE / 254 + 1 + 2;
+
+/// A decoded frame
+struct TelemetryFrame {
+    uint16_t sequence;
+    uint32_t timestamp_us;
+    uint32_t period_us;
+    uint8_t count;
+    int16_t samples[TELEMETRY_MAX_SAMPLES][3]; // x, y, z in mg
+};
+
+/// CRC-16/CCITT-FALSE (polynomial 0x1021, initial value 0xFFFF). Pass the previous result as crc to continue a CRC
+/// over several buffers.
+uint16_t telemetryCrc16(const uint8_t *data, size_t length, uint16_t crc = 0xFFFF);
+
+/// COBS encode length bytes into out, which must hold length + length / 254 + 1 bytes. Returns the encoded length. The
+/// output contains no zero bytes.
+size_t cobsEncode(const uint8_t *data, size_t length, uint8_t *out);
+
+/// COBS decode length bytes (without delimiters) into out, which must hold length bytes. Returns the decoded length, or
+/// 0 if the input is not valid COBS.
+size_t cobsDecode(const uint8_t *data, size_t length, uint8_t *out);
+
+/// Append the CRC to a frame of length bytes (raw must have room for it), then COBS encode it between delimiters into
+/// out, which must hold TELEMETRY_MAX_ENCODED_SIZE bytes. Returns the number of bytes to send.
+size_t telemetryFinishFrame(uint8_t *raw, size_t length, uint8_t *out);
+
+/// Decode one COBS piece of the stream (the bytes between two zeros) into frame. Returns false if it is not a valid
+/// frame: bad COBS, wrong type or length, or a CRC mismatch.
+bool telemetryDecodeFrame(const uint8_t *encoded, size_t length, TelemetryFrame &frame);
@@ -0,0 +1,181 @@
+// Streaming fixed-point filters for accelerometer samples
+
+#include <math.h>
+#include "dsp.h"
+
+// --- Helpers ---
+
+uint32_t isqrt32(uint32_t value) {
+    // Digit-by-digit method: one result bit per iteration, no multiplies
+    uint32_t result = 0;
+    uint32_t bit = 1u << 30;
+    while (bit > value) {
+        bit >>= 2;
+    }
+    while (bit != 0) {
+        if (value >= result + bit) {
+            value -= result + bit;
+            result = (result >> 1) + bit;
+        } else {
+            result >>= 1;
+        }
+        bit >>= 2;
+    }
+    return result;
+}
+
+// Convert a coefficient to Q2.30, clamped to the representable range
+static q30_t toQ30(double value) {
+    double scaled = value * (double)(1 << Q30_SHIFT);
+    if (scaled >= 2147483647.0) {
+        return INT32_MAX;
+    }
+    if (scaled <= -2147483648.0) {
+        return INT32_MIN;
+    }
+    return (q30_t)lround(scaled);
+}
+
+// --- DspChain ---
+
+DspChain::DspChain() : stages(), stageCount(0) {}
+
+bool DspChain::add(DspStage &stage) {
+    if (stageCount == MAX_STAGES) {
+        return false;
+    }
+    stages[stageCount++] = &stage;
+    return true;
+}
+
+size_t DspChain::process(AccelSample *samples, size_t count) {
+    for (size_t i = 0; i < stageCount && count > 0; ++i) {
+        count = stages[i]->process(samples, count);
+    }
+    return count;
+}
+
+void DspChain::reset() {
+    for (size_t i = 0; i < stageCount; ++i) {
+        stages[i]->reset();
+    }
+}
+
+// --- Biquad design ---
+
+// RBJ audio EQ cookbook designs, normalised by a0
+static BiquadCoefficients normalise(double b0, double b1, double b2, double a0, double a1, double a2) {
+    return {toQ30(b0 / a0), toQ30(b1 / a0), toQ30(b2 / a0), toQ30(a1 / a0), toQ30(a2 / a0)};
+}
+
+BiquadCoefficients biquadLowPass(float sampleRateHz, float cutoffHz, float q) {
+    double w0 = 2.0 * M_PI * cutoffHz / sampleRateHz;
+    double cosW0 = cos(w0);
+    double alpha = sin(w0) / (2.0 * q);
+    return normalise((1.0 - cosW0) / 2.0, 1.0 - cosW0, (1.0 - cosW0) / 2.0, 1.0 + alpha, -2.0 * cosW0, 1.0 - alpha);
+}
+
+BiquadCoefficients biquadHighPass(float sampleRateHz, float cutoffHz, float q) {
+    double w0 = 2.0 * M_PI * cutoffHz / sampleRateHz;
+    double cosW0 = cos(w0);
+    double alpha = sin(w0) / (2.0 * q);
+    return normalise((1.0 + cosW0) / 2.0, -(1.0 + cosW0), (1.0 + cosW0) / 2.0, 1.0 + alpha, -2.0 * cosW0, 1.0 - alpha);
+}
+
+// --- BiquadStage ---
+
+// Extra fractional bits kept in the previous outputs
+#define BIQUAD_STATE_BITS 8
+
+BiquadStage::BiquadStage(const BiquadCoefficients &coefficients) : coefficients(coefficients) {
+    reset();
+}
+
+void BiquadStage::setCoefficients(const BiquadCoefficients &newCoefficients) {
+    coefficients = newCoefficients;
+}
+
+size_t BiquadStage::process(AccelSample *samples, size_t count) {
+    const int64_t b0 = coefficients.b0, b1 = coefficients.b1, b2 = coefficients.b2;
+    const int64_t a1 = coefficients.a1, a2 = coefficients.a2;
+    const int32_t stateMax = (int32_t)INT16_MAX << BIQUAD_STATE_BITS;
+    const int32_t stateMin = (int32_t)INT16_MIN << BIQUAD_STATE_BITS;
+    const int64_t round = (int64_t)1 << (Q30_SHIFT - 1);
+
+    for (size_t i = 0; i < count; ++i) {
+        int16_t *axes[3] = {&samples[i].x_mg, &samples[i].y_mg, &samples[i].z_mg};
+        for (int a = 0; a < 3; ++a) {
+            int16_t x0 = *axes[a];
+
+            // Inputs are scaled up to match the extra bits of the outputs, then the Q2.30 products are summed in Q38
+            int64_t acc = (b0 * x0 + b1 * x1[a] + b2 * x2[a]) * (1 << BIQUAD_STATE_BITS);
+            acc -= a1 * y1[a] + a2 * y2[a];
+            int64_t y = (acc + round) >> Q30_SHIFT;
+            int32_t y0 = y > stateMax ? stateMax : (y < stateMin ? stateMin : (int32_t)y);
+
+            x2[a] = x1[a];
+            x1[a] = x0;
+            y2[a] = y1[a];
+            y1[a] = y0;
+            *axes[a] = (int16_t)((y0 + (1 << (BIQUAD_STATE_BITS - 1))) >> BIQUAD_STATE_BITS);
+        }
+    }
+    return count;
+}
+
+void BiquadStage::reset() {
+    for (int a = 0; a < 3; ++a) {
+        x1[a] = x2[a] = 0;
+        y1[a] = y2[a] = 0;
+    }
+}
+
+// --- MagnitudeStage ---
+
+size_t MagnitudeStage::process(AccelSample *samples, size_t count) {
+    for (size_t i = 0; i < count; ++i) {
+        // Each square is at most 2^30, so the sum of three fits in 32 bits unsigned
+        int32_t x = samples[i].x_mg, y = samples[i].y_mg, z = samples[i].z_mg;
+        uint32_t squares = (uint32_t)(x * x) + (uint32_t)(y * y) + (uint32_t)(z * z);
+        samples[i].x_mg = saturate16((int32_t)isqrt32(squares));
+        samples[i].y_mg = 0;
+        samples[i].z_mg = 0;
+    }
+    return count;
+}
+
+void MagnitudeStage::reset() {}
+
+// --- DecimateStage ---
+
+DecimateStage::DecimateStage(uint8_t factor) : factor(factor > 0 ? factor : 1) {
+    reset();
+}
+
+size_t DecimateStage::process(AccelSample *samples, size_t count) {
+    size_t produced = 0;
+    for (size_t i = 0; i < count; ++i) {
+        sums[0] += samples[i].x_mg;
+        sums[1] += samples[i].y_mg;
+        sums[2] += samples[i].z_mg;
+        if (++collected < factor) {
+            continue;
+        }
+
+        // Written behind the read position, so the block can be compacted in place
+        AccelSample &out = samples[produced++];
+        out.x_mg = (int16_t)(sums[0] / factor);
+        out.y_mg = (int16_t)(sums[1] / factor);
+        out.z_mg = (int16_t)(sums[2] / factor);
+        out.status = samples[i].status;
+        out.timestamp_us = samples[i].timestamp_us;
+        collected = 0;
+        sums[0] = sums[1] = sums[2] = 0;
+    }
+    return produced;
+}
+
+void DecimateStage::reset() {
+    collected = 0;
+    sums[0] = sums[1] = sums[2] = 0;
+}
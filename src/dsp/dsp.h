@@ -0,0 +1,160 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include "drivers/LIS3DH/LIS3DH.h"
+
+// -- Streaming accelerometer filters --
+//
+// Stages filter blocks of AccelSample in place (e.g. one FIFO drain at a time) and keep their state between blocks,
+// so a long stream can be processed a block at a time with the same result as all at once. Everything runs in integer
+// arithmetic: the milli-g values are treated as Q15 (1.0 is 32768 mg), coefficients are Q2.30 and accumulators are 32
+// or 64 bits, so there is no floating point in the per-sample path. Chain stages together with DspChain.
+
+// Q2.30 fixed point, which holds -2.0 to just under 2.0: the range of biquad coefficients
+typedef int32_t q30_t;
+constexpr int Q30_SHIFT = 30;
+
+// saturate16() clamps a value to the int16_t range
+constexpr int16_t saturate16(int32_t value) {
+    return value > INT16_MAX ? INT16_MAX : (value < INT16_MIN ? INT16_MIN : (int16_t)value);
+}
+
+// isqrt32() returns the integer square root of value, rounded down
+uint32_t isqrt32(uint32_t value);
+
+// A filter stage
+class DspStage {
+    public:
+        virtual ~DspStage() = default;
+
+        // process() filters [count] samples in place, carrying on from the previous block, and returns the number of
+        // samples produced. Only decimating stages produce fewer samples than they were given.
+        virtual size_t process(AccelSample *samples, size_t count) = 0;
+
+        // reset() clears the state, as if no samples had been seen
+        virtual void reset() = 0;
+};
+
+// DspChain runs a block through its stages in the order they were added. The stages are not owned by the chain.
+class DspChain {
+    public:
+        static constexpr size_t MAX_STAGES = 8;
+
+        DspChain();
+
+        // add() appends a stage. Returns false if the chain is full.
+        bool add(DspStage &stage);
+
+        // process() runs the block through every stage and returns the number of samples left
+        size_t process(AccelSample *samples, size_t count);
+
+        // reset() resets every stage
+        void reset();
+
+    private:
+        DspStage *stages[MAX_STAGES];
+        size_t stageCount;
+};
+
+// -- Stages --
+
+// MovingAverageStage replaces each sample with the mean of the last Window samples on each axis. The window starts
+// full of the first sample, so there is no ramp up from zero.
+template <size_t Window>
+class MovingAverageStage : public DspStage {
+    static_assert(Window > 0 && Window <= 256, "Window must be 1-256 samples");
+
+    private:
+        int16_t history[3][Window];
+        int32_t sums[3];
+        size_t position;
+        bool primed;
+
+    public:
+        MovingAverageStage() { reset(); }
+
+        size_t process(AccelSample *samples, size_t count) override {
+            for (size_t i = 0; i < count; ++i) {
+                int16_t *axes[3] = {&samples[i].x_mg, &samples[i].y_mg, &samples[i].z_mg};
+                if (!primed) {
+                    for (int a = 0; a < 3; ++a) {
+                        for (size_t w = 0; w < Window; ++w) {
+                            history[a][w] = *axes[a];
+                        }
+                        sums[a] = (int32_t)*axes[a] * (int32_t)Window;
+                    }
+                    primed = true;
+                }
+                // Division by a constant, which is a shift if Window is a power of two
+                for (int a = 0; a < 3; ++a) {
+                    sums[a] += *axes[a] - history[a][position];
+                    history[a][position] = *axes[a];
+                    *axes[a] = (int16_t)(sums[a] / (int32_t)Window);
+                }
+                position = (position + 1 == Window) ? 0 : position + 1;
+            }
+            return count;
+        }
+
+        void reset() override {
+            position = 0;
+            primed = false;
+            sums[0] = sums[1] = sums[2] = 0;
+        }
+};
+
+// Biquad coefficients in Q2.30, normalised so that a0 is 1:
+// y[n] = b0 x[n] + b1 x[n-1] + b2 x[n-2] - a1 y[n-1] - a2 y[n-2]
+struct BiquadCoefficients {
+    q30_t b0, b1, b2;
+    q30_t a1, a2;
+};
+
+// biquadLowPass() and biquadHighPass() design second-order Butterworth filters (Q of 0.7071 by default) for a cutoff
+// frequency and sample rate. The design uses floating point, so do it once at setup rather than per block.
+BiquadCoefficients biquadLowPass(float sampleRateHz, float cutoffHz, float q = 0.70710678f);
+BiquadCoefficients biquadHighPass(float sampleRateHz, float cutoffHz, float q = 0.70710678f);
+
+// BiquadStage runs a biquad on each axis (direct form I). A high-pass well below the motion of interest removes
+// gravity, e.g. BiquadStage(biquadHighPass(400, 0.5f)); a low-pass smooths out noise. The previous outputs are kept
+// with 8 extra fractional bits and the sums are 64-bit, so filters with a cutoff far below the sample rate stay
+// accurate and stable.
+class BiquadStage : public DspStage {
+    private:
+        BiquadCoefficients coefficients;
+        int16_t x1[3], x2[3]; // Previous inputs
+        int32_t y1[3], y2[3]; // Previous outputs, Q15 with 8 extra fractional bits
+
+    public:
+        explicit BiquadStage(const BiquadCoefficients &coefficients);
+
+        // setCoefficients() changes the filter without clearing its state
+        void setCoefficients(const BiquadCoefficients &newCoefficients);
+
+        size_t process(AccelSample *samples, size_t count) override;
+        void reset() override;
+};
+
+// MagnitudeStage replaces each vector with its length, which goes in x_mg (y_mg and z_mg are set to 0) so that later
+// stages filter the magnitude. Lengths beyond the int16_t range saturate.
+class MagnitudeStage : public DspStage {
+    public:
+        size_t process(AccelSample *samples, size_t count) override;
+        void reset() override;
+};
+
+// DecimateStage reduces the sample rate by [factor] (1-255), replacing each group of factor samples with their mean
+// (a simple anti-aliasing filter) stamped with the time of the group's last sample. Groups may span blocks.
+class DecimateStage : public DspStage {
+    private:
+        uint8_t factor;
+        uint8_t collected;
+        int32_t sums[3];
+
+    public:
+        explicit DecimateStage(uint8_t factor);
+
+        size_t process(AccelSample *samples, size_t count) override;
+        void reset() override;
+};
@@ -0,0 +1,299 @@
+// Frame-budgeted LED effects engine
+
+#include <algorithm>
+#include "pico/stdlib.h"
+#include "pico/time.h"
+#include "effects.h"
+
+// --- Helpers ---
+
+// lerpColor() blends each channel of two packed colours
+uint32_t lerpColor(uint32_t a, uint32_t b, uint32_t t) {
+    if (t >= 256) {
+        return b;
+    }
+    uint32_t r = (packedRed(a) * (256 - t) + packedRed(b) * t) >> 8;
+    uint32_t g = (packedGreen(a) * (256 - t) + packedGreen(b) * t) >> 8;
+    uint32_t bl = (packedBlue(a) * (256 - t) + packedBlue(b) * t) >> 8;
+    return packRGB(r, g, bl);
+}
+
+// Default time source: microseconds since boot
+static uint64_t sdkTimeSource() {
+    return to_us_since_boot(get_absolute_time());
+}
+
+// --- Effect ---
+
+Effect::Effect(int first, int count) : first(first), count(count) {}
+
+// --- FillEffect ---
+
+FillEffect::FillEffect(int first, int count, uint32_t color) : Effect(first, count), color(color), changed(true) {}
+
+void FillEffect::setColor(uint32_t newColor) {
+    changed |= (newColor != color);
+    color = newColor;
+}
+
+bool FillEffect::update(uint64_t now_us) {
+    return changed;
+}
+
+void FillEffect::draw(LEDController& leds) {
+    leds.fillRange(first, count, color);
+    changed = false;
+}
+
+void FillEffect::restart() {
+    changed = true;
+}
+
+// --- GradientEffect ---
+
+GradientEffect::GradientEffect(int first, int count, HSV from, HSV to)
+    : Effect(first, count), from(from), to(to), changed(true) {}
+
+bool GradientEffect::update(uint64_t now_us) {
+    return changed;
+}
+
+void GradientEffect::draw(LEDController& leds) {
+    // Hue wraps, so take the signed 16-bit difference to go the short way round
+    int32_t dh = (int16_t)(to.h - from.h);
+    int32_t ds = (int32_t)to.s - from.s;
+    int32_t dv = (int32_t)to.v - from.v;
+    int steps = std::max(count - 1, 1);
+
+    int end = std::min(first + count, leds.count());
+    for (int i = std::max(first, 0); i < end; ++i) {
+        int k = i - first;
+        uint16_t h = (uint16_t)(from.h + dh * k / steps);
+        uint8_t s = (uint8_t)(from.s + ds * k / steps);
+        uint8_t v = (uint8_t)(from.v + dv * k / steps);
+        leds.getLED(i).setPackedColor(hsvToPacked(h, s, v));
+    }
+    changed = false;
+}
+
+void GradientEffect::restart() {
+    changed = true;
+}
+
+// --- ChaseEffect ---
+
+ChaseEffect::ChaseEffect(int first, int count, uint32_t color, uint32_t ledsPerSecond, int tailLength)
+    : Effect(first, count), color(color), ledsPerSecond(ledsPerSecond), tailLength(tailLength), startTime(0),
+      started(false), position(0), drawnPosition(-1) {}
+
+bool ChaseEffect::update(uint64_t now_us) {
+    if (!started) {
+        startTime = now_us;
+        started = true;
+    }
+    if (count <= 0) {
+        return false;
+    }
+    position = (int)(((now_us - startTime) * ledsPerSecond / 1000000) % (uint64_t)count);
+    return position != drawnPosition;
+}
+
+void ChaseEffect::draw(LEDController& leds) {
+    // Head at full brightness, each tail LED at half the brightness of the one in front
+    uint32_t shade = color;
+    for (int i = 0; i <= tailLength && i < count; ++i) {
+        int index = first + (position - i + count) % count;
+        if (index >= 0 && index < leds.count()) {
+            leds.getLED(index).setPackedColor(shade);
+        }
+        shade = lerpColor(0, shade, 128);
+    }
+    drawnPosition = position;
+}
+
+void ChaseEffect::restart() {
+    started = false;
+    drawnPosition = -1;
+}
+
+// --- FadeEffect ---
+
+FadeEffect::FadeEffect(int first, int count, uint32_t from, uint32_t to, uint32_t durationMs, bool repeat)
+    : Effect(first, count), from(from), to(to), durationUs(std::max<uint32_t>(durationMs, 1) * 1000), repeat(repeat),
+      startTime(0), started(false), color(from), changed(true) {}
+
+bool FadeEffect::update(uint64_t now_us) {
+    if (!started) {
+        startTime = now_us;
+        started = true;
+    }
+
+    uint64_t elapsed = now_us - startTime;
+    uint32_t t;
+    if (repeat) {
+        // Triangle wave: from -> to -> from
+        uint64_t phase = elapsed % (2ull * durationUs);
+        uint64_t ramp = phase < durationUs ? phase : 2ull * durationUs - phase;
+        t = (uint32_t)(ramp * 256 / durationUs);
+    } else {
+        t = elapsed >= durationUs ? 256 : (uint32_t)(elapsed * 256 / durationUs);
+    }
+
+    uint32_t next = lerpColor(from, to, t);
+    changed |= (next != color);
+    color = next;
+    return changed;
+}
+
+void FadeEffect::draw(LEDController& leds) {
+    leds.fillRange(first, count, color);
+    changed = false;
+}
+
+void FadeEffect::restart() {
+    started = false;
+    changed = true;
+}
+
+// --- KeyframeEffect ---
+
+KeyframeEffect::KeyframeEffect(int first, int count, const Keyframe* keyframes, size_t numKeyframes, bool loop)
+    : Effect(first, count), keyframes(keyframes), numKeyframes(numKeyframes), loop(loop), startTime(0), started(false),
+      color(numKeyframes > 0 ? keyframes[0].color : 0), changed(true) {}
+
+bool KeyframeEffect::update(uint64_t now_us) {
+    if (numKeyframes == 0) {
+        return false;
+    }
+    if (!started) {
+        startTime = now_us;
+        started = true;
+    }
+
+    uint32_t lengthMs = keyframes[numKeyframes - 1].timeMs;
+    uint64_t elapsedMs = (now_us - startTime) / 1000;
+    if (loop && lengthMs > 0) {
+        elapsedMs %= lengthMs;
+    }
+
+    // Hold the first colour until the first keyframe (on every pass when looping), otherwise find the pair of
+    // keyframes either side of the current time
+    uint32_t next = keyframes[numKeyframes - 1].color;
+    if (elapsedMs < keyframes[0].timeMs) {
+        next = keyframes[0].color;
+    } else {
+        for (size_t i = 1; i < numKeyframes; ++i) {
+            if (elapsedMs < keyframes[i].timeMs) {
+                const Keyframe& a = keyframes[i - 1];
+                const Keyframe& b = keyframes[i];
+                uint32_t span = b.timeMs - a.timeMs;
+                uint32_t t = span ? (uint32_t)((elapsedMs - a.timeMs) * 256 / span) : 256;
+                next = lerpColor(a.color, b.color, t);
+                break;
+            }
+        }
+    }
+
+    changed |= (next != color);
+    color = next;
+    return changed;
+}
+
+void KeyframeEffect::draw(LEDController& leds) {
+    leds.fillRange(first, count, color);
+    changed = false;
+}
+
+void KeyframeEffect::restart() {
+    started = false;
+    changed = true;
+}
+
+// --- EffectsEngine ---
+
+EffectsEngine::EffectsEngine(LEDController& leds, uint32_t frameRateHz, EffectTimeSource clock)
+    : leds(leds), effects(), numEffects(0), framePeriodUs(1000000 / std::max<uint32_t>(frameRateHz, 1)),
+      clock(clock ? clock : sdkTimeSource), nextFrameTime(0), started(false), outputPending(false), stats() {}
+
+bool EffectsEngine::addEffect(Effect* effect) {
+    if (numEffects == MAX_EFFECTS) {
+        return false;
+    }
+    effects[numEffects++] = effect;
+    effect->restart();
+    outputPending = true; // Redraw so the new effect appears even if it is static
+    return true;
+}
+
+void EffectsEngine::removeEffect(Effect* effect) {
+    for (int i = 0; i < numEffects; ++i) {
+        if (effects[i] == effect) {
+            std::copy(effects + i + 1, effects + numEffects, effects + i);
+            numEffects--;
+            outputPending = true; // Redraw without it
+            return;
+        }
+    }
+}
+
+void EffectsEngine::clearEffects() {
+    numEffects = 0;
+    outputPending = true;
+}
+
+bool EffectsEngine::tick() {
+    uint64_t now = clock();
+    if (!started) {
+        nextFrameTime = now;
+        started = true;
+    }
+    if (now < nextFrameTime) {
+        return false;
+    }
+
+    // Count any whole frame slots the caller slept through, and schedule from the current slot
+    uint64_t late = now - nextFrameTime;
+    if (late >= framePeriodUs) {
+        stats.framesMissed += (uint32_t)(late / framePeriodUs);
+    }
+    nextFrameTime += (late / framePeriodUs + 1) * framePeriodUs;
+
+    // Advance every effect; only redraw if something changed
+    bool changed = outputPending;
+    for (int i = 0; i < numEffects; ++i) {
+        changed |= effects[i]->update(now);
+    }
+
+    bool sent = false;
+    if (!changed) {
+        stats.framesSkipped++;
+    } else {
+        leds.resetLEDs();
+        for (int i = 0; i < numEffects; ++i) {
+            effects[i]->draw(leds);
+        }
+        sent = leds.updateLEDsAsync();
+        outputPending = !sent;
+        if (sent) {
+            stats.framesSent++;
+        } else {
+            stats.framesDeferred++;
+        }
+    }
+
+    uint64_t renderTime = clock() - now;
+    stats.maxRenderUs = std::max(stats.maxRenderUs, (uint32_t)renderTime);
+    if (renderTime > framePeriodUs) {
+        stats.overruns++;
+    }
+    return sent;
+}
+
+uint64_t EffectsEngine::timeUntilNextFrame() const {
+    uint64_t now = clock();
+    return now >= nextFrameTime ? 0 : nextFrameTime - now;
+}
+
+EffectsStats EffectsEngine::getStats() const {
+    return stats;
+}
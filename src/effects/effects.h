@@ -0,0 +1,174 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include "drivers/LEDs/LEDs.h"
+
+// -- Effects --
+
+// Source of time for effects, in microseconds. The default reads the SDK clock; a test can supply its own to step
+// through an animation deterministically.
+typedef uint64_t (*EffectTimeSource)();
+
+// An effect draws into a range of LEDs as a function of time. Each frame the engine calls update() on every effect,
+// and only if one of them changed does it clear the LEDs and call draw() on them all, in order.
+class Effect {
+    protected:
+        // First LED and number of LEDs the effect draws into
+        int first;
+        int count;
+
+    public:
+        Effect(int first, int count);
+        virtual ~Effect() = default;
+
+        // update() advances the effect to time now_us. Returns true if its output changed since the last draw().
+        virtual bool update(uint64_t now_us) = 0;
+
+        // draw() writes the effect's current output into its range of LEDs
+        virtual void draw(LEDController& leds) = 0;
+
+        // restart() makes time-based effects start again from the beginning on the next render
+        virtual void restart() {}
+};
+
+// FillEffect sets every LED in its range to one colour
+class FillEffect : public Effect {
+    private:
+        uint32_t color;
+        bool changed;
+    public:
+        FillEffect(int first, int count, uint32_t color);
+        void setColor(uint32_t newColor);
+        bool update(uint64_t now_us) override;
+        void draw(LEDController& leds) override;
+        void restart() override;
+};
+
+// GradientEffect blends from one HSV colour to another across its range, going the short way round the hue circle
+class GradientEffect : public Effect {
+    private:
+        HSV from, to;
+        bool changed;
+    public:
+        GradientEffect(int first, int count, HSV from, HSV to);
+        bool update(uint64_t now_us) override;
+        void draw(LEDController& leds) override;
+        void restart() override;
+};
+
+// ChaseEffect moves a lit LED with a fading tail along its range, wrapping at the end
+class ChaseEffect : public Effect {
+    private:
+        uint32_t color;
+        uint32_t ledsPerSecond;
+        int tailLength;
+        uint64_t startTime;
+        bool started;
+        int position;
+        int drawnPosition;
+    public:
+        ChaseEffect(int first, int count, uint32_t color, uint32_t ledsPerSecond, int tailLength = 3);
+        bool update(uint64_t now_us) override;
+        void draw(LEDController& leds) override;
+        void restart() override;
+};
+
+// FadeEffect fades its range from one colour to another over a duration, optionally going back and forth forever
+class FadeEffect : public Effect {
+    private:
+        uint32_t from, to;
+        uint32_t durationUs;
+        bool repeat;
+        uint64_t startTime;
+        bool started;
+        uint32_t color;
+        bool changed;
+    public:
+        FadeEffect(int first, int count, uint32_t from, uint32_t to, uint32_t durationMs, bool repeat = false);
+        bool update(uint64_t now_us) override;
+        void draw(LEDController& leds) override;
+        void restart() override;
+};
+
+// One point in a KeyframeEffect: the colour to show at a time offset
+struct Keyframe {
+    uint32_t timeMs;
+    uint32_t color;
+};
+
+// KeyframeEffect interpolates its range between keyframes (sorted by time), optionally looping after the last one.
+// The first keyframe's colour is held until its time, on every pass when looping.
+// The keyframes are not copied, so they must outlive the effect.
+class KeyframeEffect : public Effect {
+    private:
+        const Keyframe* keyframes;
+        size_t numKeyframes;
+        bool loop;
+        uint64_t startTime;
+        bool started;
+        uint32_t color;
+        bool changed;
+    public:
+        KeyframeEffect(int first, int count, const Keyframe* keyframes, size_t numKeyframes, bool loop = true);
+        bool update(uint64_t now_us) override;
+        void draw(LEDController& leds) override;
+        void restart() override;
+};
+
+// lerpColor() blends two packed colours, with t from 0 (all a) to 256 (all b)
+uint32_t lerpColor(uint32_t a, uint32_t b, uint32_t t);
+
+// -- Engine --
+
+// Counters kept by the engine
+struct EffectsStats {
+    uint32_t framesSent;     // Frames that changed something and were handed to the LEDs
+    uint32_t framesSkipped;  // Frames where no effect changed anything, so nothing was sent
+    uint32_t framesDeferred; // Frames that could not be sent because the previous one was still being latched
+    uint32_t framesMissed;   // Frame slots that passed without a tick (the caller was late)
+    uint32_t overruns;       // Frames whose rendering took longer than the frame period
+    uint32_t maxRenderUs;    // Longest time spent rendering one frame
+};
+
+// EffectsEngine renders a set of effects into an LEDController at a fixed frame rate.
+// It does not own the effects; they must outlive the engine or be removed first.
+class EffectsEngine {
+    private:
+        static constexpr int MAX_EFFECTS = 8;
+
+        LEDController& leds;
+        Effect* effects[MAX_EFFECTS];
+        int numEffects;
+        uint32_t framePeriodUs;
+        EffectTimeSource clock;
+        uint64_t nextFrameTime;
+        bool started;
+
+        // A changed frame could not be sent yet, so it must be sent on the next tick even if nothing else changes
+        bool outputPending;
+
+        EffectsStats stats;
+
+    public:
+        EffectsEngine(LEDController& leds, uint32_t frameRateHz, EffectTimeSource clock = nullptr);
+
+        // addEffect() adds an effect, drawn after (on top of) the existing ones. Returns false if the engine is full.
+        bool addEffect(Effect* effect);
+
+        // removeEffect() removes an effect, if present
+        void removeEffect(Effect* effect);
+
+        // clearEffects() removes every effect
+        void clearEffects();
+
+        // tick() renders and sends a frame if one is due. Call it often (at least once per frame period).
+        // Returns true if a frame was sent.
+        bool tick();
+
+        // timeUntilNextFrame() returns how long until the next frame is due, for sleeping between ticks
+        uint64_t timeUntilNextFrame() const;
+
+        // getStats() returns the counters
+        EffectsStats getStats() const;
+};
@@ -1,5 +1,7 @@
 #include <stdio.h>
+#include <algorithm>
 #include "pico/stdlib.h"
+#include "pico/time.h"
 #include "hardware/gpio.h"
 #include "hardware/pio.h"
 
@@ -8,48 +10,295 @@
 #include "drivers/LEDs/LEDs.h"
 #include "drivers/Board/Board.h"
 #include "drivers/LIS3DH/LIS3DH.h"
+#include "drivers/telemetry/telemetry.h"
+#include "drivers/recorder/recorder.h"
+#include "pipeline/pipeline.h"
+#include "scheduler/scheduler.h"
+#include "drivers/instrumentation/instrumentation.h"
+
+#ifdef TEST_HARNESS
+#include <math.h>
+#include <stdlib.h>
+#include "devices/lis3dh_sim.h"
+
+// Simulated accelerometer for the native build: a slow tilt back and forth on X, or a recorded trace if
+// LIS3DH_TRACE names a CSV file
+static LIS3DHSim simulatedAccelerometer;
+
+static void simulatedTilt(double seconds, float mg[3], void* context)
+{
+    const double TWO_PI = 6.283185307179586;
+    double angle = 0.6 * sin(TWO_PI * 0.2 * seconds);
+    mg[0] = (float)(1000 * sin(angle));
+    mg[1] = (float)(150 * sin(TWO_PI * 0.05 * seconds));
+    mg[2] = (float)(1000 * cos(angle));
+}
+
+static void attachSimulatedAccelerometer()
+{
+    const char* trace = getenv("LIS3DH_TRACE");
+    if (!trace || !simulatedAccelerometer.loadTrace(trace)) {
+        simulatedAccelerometer.setWaveform(simulatedTilt, nullptr);
+    }
+    simulatedAccelerometer.attach(I2C_INSTANCE, I2C_ADDRESS, ACCEL_INT1_PIN, ACCEL_INT2_PIN);
+    simulatedAccelerometer.setReportInterval(5 * 1000 * 1000);
+}
+#endif
+
+// Set to 0 to run acquisition, rendering and logging as scheduled tasks on core 0 (core 1 then only drains the log,
+// unless telemetry or the recorder needs the UART to itself)
+#ifndef PIPELINE_MODE
+#define PIPELINE_MODE 1
+#endif
+
+// Set to 1 to stream every sample as binary telemetry frames instead of logging them as text. Decode a capture of the
+// UART with the telemetry_decode tool.
+#ifndef TELEMETRY_MODE
+#define TELEMETRY_MODE 0
+#endif
+
+// Set to 1 (with PIPELINE_MODE 0) to record every sample to flash as well. Type 'd' on the console to dump the
+// recording as telemetry frames (decode it with telemetry_decode), 'c' to start a new one.
+#ifndef RECORDER_MODE
+#define RECORDER_MODE 0
+#endif
+
+#if RECORDER_MODE && PIPELINE_MODE
+#error "RECORDER_MODE needs the scheduled mode (PIPELINE_MODE 0)"
+#endif
+
+#if !PIPELINE_MODE
+// Task periods for the scheduled (single core) mode. At 400 Hz the FIFO gains 8 samples per sensor period, well short
+// of its 32.
+#define SENSOR_PERIOD_US (20 * 1000)
+#define RENDER_PERIOD_US (33 * 1000)
+#define OUTPUT_PERIOD_US (100 * 1000)
+#define STATS_PERIOD_US (5 * 1000 * 1000)
+
+// The console task sends one frame of a dump each run, which keeps the UART about half busy
+#define CONSOLE_PERIOD_US (40 * 1000)
+
+// Telemetry frames (including a recorder dump) and log lines share the UART, and a line printed by core 1 in the
+// middle of a frame would damage it. In those modes the log is drained by a task on core 0, between frames, instead.
+#define LOG_ON_CORE0 (TELEMETRY_MODE || RECORDER_MODE)
+
+// A few lines each run keeps the UART time of one run short of the sensor period
+#define LOG_PERIOD_US (20 * 1000)
+#define LOG_RECORDS_PER_RUN 2
+
+// State shared by the scheduled tasks
+struct TaskContext {
+    accelDriver& accelerometer;
+    LEDController& leds;
+    Scheduler& scheduler;
+    AccelSample latest;
+    bool haveSample;
+
+    // Samples waiting for the output task (telemetry mode)
+    AccelSample batch[2 * TELEMETRY_MAX_SAMPLES];
+    size_t batchCount;
+
+#if RECORDER_MODE
+    AccelRecorder* recorder;
+
+    // Dump in progress: recording pauses until it is done
+    bool dumping;
+    RecorderCursor dumpCursor;
+    uint32_t dumpSamples;
+#endif
+};
+
+// sensorTask() drains whatever the FIFO holds
+static void sensorTask(void* context)
+{
+    TaskContext& task = *static_cast<TaskContext*>(context);
+    AccelRawFrame frames[ACCEL_FIFO_DEPTH];
+    AccelSample samples[ACCEL_FIFO_DEPTH];
+
+    size_t count = task.accelerometer.drainFifo(frames, ACCEL_FIFO_DEPTH);
+    if (count == 0) {
+        return;
+    }
+    task.accelerometer.convertFrames(frames, samples, count, (uint32_t)to_us_since_boot(get_absolute_time()));
+    task.latest = samples[count - 1];
+    task.haveSample = true;
+
+#if RECORDER_MODE
+    if (task.recorder && !task.dumping) {
+        task.recorder->record(samples, count);
+    }
+#endif
+
+#if TELEMETRY_MODE
+    // Send early rather than drop samples if the output task has fallen behind
+    if (task.batchCount + count > sizeof(task.batch) / sizeof(task.batch[0])) {
+        telemetrySendSamples(task.batch, task.batchCount);
+        task.batchCount = 0;
+    }
+    std::copy(samples, samples + count, task.batch + task.batchCount);
+    task.batchCount += count;
+#endif
+}
+
+// renderTask() shows the tilt on X as a bar growing from the middle of the strip
+static void renderTask(void* context)
+{
+    TaskContext& task = *static_cast<TaskContext*>(context);
+    if (!task.haveSample) {
+        return;
+    }
+
+    int n = task.leds.count();
+    int x = std::clamp<int>(task.latest.x_mg, -1000, 1000);
+    int middle = n / 2;
+    int end = middle + x * (n - middle) / 1000;
+    task.leds.resetLEDs();
+    if (end >= middle) {
+        task.leds.fillRange(middle, end - middle + 1, packRGB(0, 64, 255));
+    } else {
+        task.leds.fillRange(end, middle - end, packRGB(255, 64, 0));
+    }
+    task.leds.updateLEDsAsync();
+}
+
+// outputTask() sends the samples collected since it last ran, or logs the newest
+static void outputTask(void* context)
+{
+    TaskContext& task = *static_cast<TaskContext*>(context);
+#if TELEMETRY_MODE
+    telemetrySendSamples(task.batch, task.batchCount);
+    task.batchCount = 0;
+#else
+    if (task.haveSample) {
+        const AccelSample& sample = task.latest;
+        log<LogLevel::INFORMATION>("Accelerometer Data: X: %d mG, Y: %d mG, Z: %d mG", sample.x_mg, sample.y_mg,
+                                   sample.z_mg);
+    }
+#endif
+}
+
+static void statsTask(void* context)
+{
+    TaskContext& task = *static_cast<TaskContext*>(context);
+    task.scheduler.logStats();
+    instrumentDump();
+#if RECORDER_MODE
+    if (task.recorder) {
+        task.recorder->logStats();
+    }
+#endif
+}
+
+#if LOG_ON_CORE0
+// logTask() prints some of the queued log
+static void logTask(void* context)
+{
+    logDrain(LOG_RECORDS_PER_RUN);
+}
+#endif
+
+#if RECORDER_MODE
+// consoleTask() handles the recorder's commands and sends the next frame of a dump
+static void consoleTask(void* context)
+{
+    TaskContext& task = *static_cast<TaskContext*>(context);
+    AccelRecorder& recorder = *task.recorder;
+
+    if (task.dumping) {
+        AccelSample samples[TELEMETRY_MAX_SAMPLES];
+        size_t count = recorder.read(task.dumpCursor, samples, TELEMETRY_MAX_SAMPLES);
+        if (count > 0) {
+            telemetrySendSamples(samples, count);
+            task.dumpSamples += (uint32_t)count;
+        } else {
+            task.dumping = false;
+            log<LogLevel::INFORMATION>("Recorder: Dumped %u samples, recording again", task.dumpSamples);
+        }
+        return;
+    }
+
+    switch (getchar_timeout_us(0)) {
+        case 'd':
+            recorder.flush();
+            task.dumping = true;
+            task.dumpCursor = recorder.begin();
+            task.dumpSamples = 0;
+            log(LogLevel::INFORMATION, "Recorder: Dumping the recording");
+            break;
+        case 'c':
+            recorder.clear();
+            log(LogLevel::INFORMATION, "Recorder: Started a new recording");
+            break;
+        default:
+            break;
+    }
+}
+#endif
+#endif
 
 int main()
 {
     stdio_init_all();
 
-    // initialize the LEDController
-    // LEDController ledController; // Initialize with Default Number of LEDs (12), to change this,
-    // pass the desired number to the constructor in LEDController ledController(num_leds) format.
-    // For example, to initialize with 6 LEDs, use LEDController ledController(6);
-    // ledController.initLEDs();
+#ifdef TEST_HARNESS
+    attachSimulatedAccelerometer();
+#endif
+
+    // Queue log messages so that formatting and UART output happen later, on core 1 or in the log task
+    setLogMode(LogMode::DEFERRED);
+
     // Initialize the accelerometer driver
     accelDriver accelerometer;
     accelerometer.accelInit();
 
+    // Let the sensor collect samples in its FIFO and interrupt once 25 are waiting (about 16 times a second at 400 Hz)
+    accelerometer.enableFifo(AccelFifoMode::STREAM, 25);
+    accelerometer.enableInterrupt(AccelInterrupt::FIFO_WATERMARK);
 
-    for (;;) {
-        // ledController.getLED(0).setColor(255, 0, 0); // Set first LED to red
-        // ledController.getLED(1).setColor(0, 255, 0); // Set second LED to green
-        // ledController.getLED(2).setColor(0, 0, 255); // Set third LED to blue
-        // ledController.setLEDGroup({5, 9, 11}, 255, 0, 255); // Set LEDs 5, 9, and 11 to magenta
-        // ledController.updateLEDs(); // Update the LEDs to reflect the changes
-        // sleep_ms(1000); // Wait for 1 second before the next update
-        // ledController.getLED(7).setColor(255, 255, 0); // Set the 8th LED to yellow
-        // ledController.updateLEDs(); // Update the LEDs to reflect the changes
-        // sleep_ms(1000); // Wait for 1 second before the next update
-        // ledController.resetLEDs(); // Reset all LEDs to off state
-        // ledController.updateLEDs(); // Update the LEDs to reflect the reset
-
-        std::vector<float> accelData = accelerometer.readAccelerometer();
-        if (accelData.size() < 1) {
-            log(LogLevel::ERROR, "Failed to read accelerometer data");
-            continue; // Skip this iteration if data is not valid
-        }
+#if PIPELINE_MODE
+    // Core 0 acquires samples, core 1 renders them on the LEDs and drains the log
+    LEDController ledController;
+    ledController.initLEDs();
+    Pipeline pipeline(accelerometer, ledController);
+
+    // Smooth out sensor noise before rendering: a 5 Hz low-pass at the 400 Hz data rate
+    BiquadStage smoothing(biquadLowPass(400, 5));
+    DspChain filter;
+    filter.add(smoothing);
+    pipeline.setFilter(&filter);
+    pipeline.setTelemetry(TELEMETRY_MODE);
+
+    pipeline.start();
+    pipeline.runAcquisition();
+#else
+    // Core 0 runs the sensor, render and output tasks from a scheduler, each at its own rate; core 1 drains the log
+    // (or a task on core 0 does, see LOG_ON_CORE0)
+#if !LOG_ON_CORE0
+    logStartDrainOnCore1();
+#endif
+    LEDController ledController;
+    ledController.initLEDs();
 
-        // Log the accelerometer data
-        std::string logMessage = "Accelerometer Data: X: " + std::to_string(accelData[0]) +
-                                " G, Y: " + std::to_string(accelData[1]) +
-                                " G, Z: " + std::to_string(accelData[2]) + " G";
-        log(LogLevel::INFORMATION, logMessage.c_str());
+    Scheduler scheduler;
+    TaskContext context = {accelerometer, ledController, scheduler};
+    scheduler.addPeriodic("sensor", SENSOR_PERIOD_US, sensorTask, &context, 2);
+    scheduler.addPeriodic("render", RENDER_PERIOD_US, renderTask, &context, 1);
+    scheduler.addPeriodic("output", OUTPUT_PERIOD_US, outputTask, &context, 0);
+    scheduler.addPeriodic("stats", STATS_PERIOD_US, statsTask, &context, 0, STATS_PERIOD_US);
+#if LOG_ON_CORE0
+    scheduler.addPeriodic("log", LOG_PERIOD_US, logTask, &context, 0);
+#endif
 
-        sleep_ms(500); // Wait for 1 second before the next iteration
+#if RECORDER_MODE
+    // Core 1 is not running (the log is drained on core 0), so the recorder only has to keep this core off the flash
+    AccelRecorder recorder;
+    if (recorder.init()) {
+        context.recorder = &recorder;
+        scheduler.addPeriodic("console", CONSOLE_PERIOD_US, consoleTask, &context, 0);
     }
+#endif
+    scheduler.run();
+#endif
 
     return 0;
 }
@@ -0,0 +1,207 @@
+// Dual-core acquisition and render pipeline
+
+#include <stdio.h>
+#include "pico/stdlib.h"
+#include "pico/time.h"
+#include "pico/multicore.h"
+
+#include "drivers/logging/logging.h"
+#include "drivers/instrumentation/instrumentation.h"
+#include "pipeline.h"
+
+// How often core 0 logs the pipeline counters and the latency probes
+#define STATS_INTERVAL_US (5 * 1000 * 1000)
+
+Pipeline* Pipeline::active = nullptr;
+
+// Each counter has one writer, so a relaxed load and store is enough, and avoids a locked read-modify-write on the
+// M0+, which has no atomic instructions
+static void increment(std::atomic<uint32_t>& counter, uint32_t amount = 1) {
+    counter.store(counter.load(std::memory_order_relaxed) + amount, std::memory_order_relaxed);
+}
+
+// Constructor to connect the pipeline to the accelerometer (core 0) and the LEDs (core 1)
+Pipeline::Pipeline(accelDriver& accelerometer, LEDController& leds)
+    : accelerometer(accelerometer), leds(leds), queue(), filter(nullptr), framePending(false), telemetry(false),
+      telemetryCount(0), stats() {}
+
+void Pipeline::setFilter(DspChain* chain) {
+    filter = chain;
+}
+
+void Pipeline::setTelemetry(bool enabled) {
+    telemetry = enabled;
+}
+
+void Pipeline::start() {
+    active = this;
+    multicore_launch_core1(core1Entry);
+}
+
+void Pipeline::core1Entry() {
+    active->renderLoop();
+}
+
+bool Pipeline::send(const PipelineMessage& message) {
+    if (!queue.push(message)) {
+        increment(stats.messagesDropped);
+        return false;
+    }
+    increment(stats.messagesSent);
+    return true;
+}
+
+void Pipeline::runAcquisition() {
+    AccelRawFrame frames[ACCEL_FIFO_DEPTH];
+    AccelSample samples[ACCEL_FIFO_DEPTH];
+    uint64_t nextStats = to_us_since_boot(get_absolute_time()) + STATS_INTERVAL_US;
+
+    for (;;) {
+        if (accelerometer.waitForData(500 * 1000)) {
+            size_t count = accelerometer.drainFifo(frames, ACCEL_FIFO_DEPTH);
+            accelerometer.convertFrames(frames, samples, count, (uint32_t)to_us_since_boot(get_absolute_time()));
+            if (filter) {
+                count = filter->process(samples, count);
+            }
+
+            PipelineMessage message;
+            message.type = PipelineMessage::SAMPLE;
+            for (size_t i = 0; i < count; ++i) {
+                message.sample = samples[i];
+                send(message);
+            }
+        } else {
+            log<LogLevel::WARNING>("Timed out waiting for accelerometer data");
+        }
+
+        uint64_t now = to_us_since_boot(get_absolute_time());
+        if (now >= nextStats) {
+            logStats();
+            instrumentDump();
+            nextStats = now + STATS_INTERVAL_US;
+        }
+    }
+}
+
+void Pipeline::renderLoop() {
+    for (;;) {
+        // Take everything that is waiting, keeping only the latest sample: rendering older ones would be wasted work
+        PipelineMessage message;
+        AccelSample latest;
+        bool haveSample = false;
+        bool changed = false;
+
+        uint32_t depth = queue.size();
+        if (depth > stats.maxQueueDepth.load(std::memory_order_relaxed)) {
+            stats.maxQueueDepth.store(depth, std::memory_order_relaxed);
+        }
+
+        while (queue.pop(message)) {
+            increment(stats.messagesReceived);
+            switch (message.type) {
+                case PipelineMessage::SAMPLE:
+                    latest = message.sample;
+                    haveSample = true;
+                    if (telemetry) {
+                        // Sent from this core, which also prints the log, so the two never interleave
+                        telemetryBatch[telemetryCount++] = message.sample;
+                        if (telemetryCount == TELEMETRY_MAX_SAMPLES) {
+                            telemetrySendSamples(telemetryBatch, telemetryCount);
+                            increment(stats.samplesStreamed, (uint32_t)telemetryCount);
+                            telemetryCount = 0;
+                        }
+                    }
+                    break;
+                case PipelineMessage::SET_PIXEL:
+                    if (message.pixel.index < leds.count()) {
+                        leds.getLED(message.pixel.index).setColor(message.pixel.r, message.pixel.g, message.pixel.b);
+                        changed = true;
+                    }
+                    break;
+                case PipelineMessage::CLEAR:
+                    leds.resetLEDs();
+                    changed = true;
+                    break;
+            }
+        }
+
+        if (haveSample) {
+            render(latest);
+            changed = true;
+        }
+
+        // Hand the frame to the DMA without waiting; if the last frame is still latching, keep it pending so the
+        // next pass retries even if nothing more arrives
+        framePending |= changed;
+        if (framePending) {
+            if (leds.updateLEDsAsync()) {
+                increment(stats.framesSent);
+                framePending = false;
+            }
+
+            // The controller's counters are only safe to read on this core, so publish a copy for core 0
+            LEDFrameStats ledStats = leds.getFrameStats();
+            stats.ledFramesSent.store(ledStats.framesSent, std::memory_order_relaxed);
+            stats.ledFramesSkipped.store(ledStats.framesSkipped, std::memory_order_relaxed);
+            stats.ledPixelsSent.store(ledStats.pixelsSent, std::memory_order_relaxed);
+            stats.ledPixelsSaved.store(ledStats.pixelsSaved, std::memory_order_relaxed);
+        }
+
+        // Core 1 also owns the log output in this mode. A pending frame goes out as soon as the latch ends, so spin
+        // rather than sleep past it.
+        if (logDrain(4) == 0) {
+            if (framePending) {
+                tight_loop_contents();
+            } else {
+                sleep_us(100);
+            }
+        }
+    }
+}
+
+void Pipeline::render(const AccelSample& sample) {
+    int n = leds.count();
+    if (n == 0) {
+        return;
+    }
+
+    // Map -1g..+1g on the X axis onto the strip
+    int x = sample.x_mg;
+    if (x < -1000) x = -1000;
+    if (x > 1000) x = 1000;
+    int position = (x + 1000) * (n - 1) / 2000;
+
+    // Green when level, shading to red as the Y tilt grows
+    int y = sample.y_mg < 0 ? -sample.y_mg : sample.y_mg;
+    if (y > 1000) y = 1000;
+    uint8_t red = (uint8_t)(y * 255 / 1000);
+
+    leds.resetLEDs();
+    leds.getLED(position).setColor(red, 255 - red, 0);
+}
+
+PipelineStats Pipeline::getStats() const {
+    PipelineStats snapshot;
+    snapshot.messagesSent = stats.messagesSent.load(std::memory_order_relaxed);
+    snapshot.messagesDropped = stats.messagesDropped.load(std::memory_order_relaxed);
+    snapshot.messagesReceived = stats.messagesReceived.load(std::memory_order_relaxed);
+    snapshot.framesSent = stats.framesSent.load(std::memory_order_relaxed);
+    snapshot.samplesStreamed = stats.samplesStreamed.load(std::memory_order_relaxed);
+    snapshot.maxQueueDepth = stats.maxQueueDepth.load(std::memory_order_relaxed);
+    snapshot.leds.framesSent = stats.ledFramesSent.load(std::memory_order_relaxed);
+    snapshot.leds.framesSkipped = stats.ledFramesSkipped.load(std::memory_order_relaxed);
+    snapshot.leds.pixelsSent = stats.ledPixelsSent.load(std::memory_order_relaxed);
+    snapshot.leds.pixelsSaved = stats.ledPixelsSaved.load(std::memory_order_relaxed);
+    return snapshot;
+}
+
+void Pipeline::logStats() const {
+    PipelineStats snapshot = getStats();
+    log<LogLevel::INFORMATION>("Pipeline: sent %u, dropped %u, received %u, frames %u", snapshot.messagesSent,
+                               snapshot.messagesDropped, snapshot.messagesReceived, snapshot.framesSent);
+    log<LogLevel::INFORMATION>("LEDs: %u frames skipped, %u pixels sent, %u saved", snapshot.leds.framesSkipped,
+                               snapshot.leds.pixelsSent, snapshot.leds.pixelsSaved);
+    if (telemetry) {
+        log<LogLevel::INFORMATION>("Pipeline: streamed %u samples", snapshot.samplesStreamed);
+    }
+}
@@ -0,0 +1,113 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include "drivers/LEDs/LEDs.h"
+#include "drivers/LIS3DH/LIS3DH.h"
+#include "drivers/telemetry/telemetry.h"
+#include "dsp/dsp.h"
+#include "utils/SPSCQueue.h"
+
+// Message passed from the acquisition core to the render core
+struct PipelineMessage {
+    enum Type : uint8_t {
+        SAMPLE,    // Render the tilt indicator for a new accelerometer sample
+        SET_PIXEL, // Set one LED to a colour
+        CLEAR,     // Turn every LED off
+    };
+
+    Type type;
+    union {
+        AccelSample sample;
+        struct {
+            uint16_t index;
+            uint8_t r, g, b;
+        } pixel;
+    };
+};
+
+// Counters kept by the pipeline. Each is only written by one core.
+struct PipelineStats {
+    uint32_t messagesSent;     // Messages queued by core 0
+    uint32_t messagesDropped;  // Messages core 0 could not queue because the queue was full
+    uint32_t messagesReceived; // Messages processed by core 1
+    uint32_t framesSent;       // Frames core 1 handed to the LEDs
+    uint32_t samplesStreamed;  // Samples core 1 sent as telemetry
+    uint32_t maxQueueDepth;    // Deepest the queue has been when core 1 looked
+    LEDFrameStats leds;        // The LED controller's counters, as core 1 last copied them
+};
+
+// Pipeline runs acquisition on core 0 and LED rendering on core 1, connected by a lock-free queue.
+// In the native build core 1 is a std::thread, so the same code can be used to measure throughput.
+class Pipeline {
+    private:
+        static constexpr size_t QUEUE_LENGTH = 128;
+
+        accelDriver& accelerometer;
+        LEDController& leds;
+        SPSCQueue<PipelineMessage, QUEUE_LENGTH> queue;
+
+        // Filters applied to each FIFO drain before it is sent, or null
+        DspChain* filter;
+
+        // A change has not reached the LEDs yet because the last frame was still latching (core 1 only)
+        bool framePending;
+
+        // Samples waiting to go out as one telemetry frame (core 1 only)
+        bool telemetry;
+        AccelSample telemetryBatch[TELEMETRY_MAX_SAMPLES];
+        size_t telemetryCount;
+
+        // The counters, as in PipelineStats. Core 0 writes the first two and core 1 the rest, and either core reads
+        // them, so each is a relaxed atomic: a snapshot is exact per counter, but not across them.
+        struct SharedStats {
+            std::atomic<uint32_t> messagesSent{0};
+            std::atomic<uint32_t> messagesDropped{0};
+            std::atomic<uint32_t> messagesReceived{0};
+            std::atomic<uint32_t> framesSent{0};
+            std::atomic<uint32_t> samplesStreamed{0};
+            std::atomic<uint32_t> maxQueueDepth{0};
+            std::atomic<uint32_t> ledFramesSent{0};
+            std::atomic<uint32_t> ledFramesSkipped{0};
+            std::atomic<uint32_t> ledPixelsSent{0};
+            std::atomic<uint32_t> ledPixelsSaved{0};
+        };
+        SharedStats stats;
+
+        // Entry point for core 1, which cannot take arguments
+        static Pipeline* active;
+        static void core1Entry();
+
+        // renderLoop() is core 1's main loop: drain the queue, render, send frames and flush the log
+        void renderLoop();
+
+        // render() draws a spirit-level style tilt indicator: the lit LED follows the X axis, coloured by tilt
+        void render(const AccelSample& sample);
+
+    public:
+        Pipeline(accelDriver& accelerometer, LEDController& leds);
+
+        // setFilter() runs every block of samples through [chain] (e.g. smoothing or gravity removal) before it is
+        // sent to core 1. Pass nullptr to send the samples as read. Call before runAcquisition().
+        void setFilter(DspChain* chain);
+
+        // setTelemetry() makes core 1 stream every sample it receives as binary telemetry frames, a full FIFO's worth
+        // per frame, alongside the log output. Call before start().
+        void setTelemetry(bool enabled);
+
+        // start() launches the render loop on core 1
+        void start();
+
+        // send() queues a message for core 1. Returns false (and counts a drop) if the queue is full. Core 0 only.
+        bool send(const PipelineMessage& message);
+
+        // runAcquisition() is core 0's main loop: wait for the FIFO watermark, drain it and send every sample.
+        // The accelerometer must already be streaming with the watermark interrupt enabled. Never returns.
+        void runAcquisition();
+
+        // getStats() returns a snapshot of the counters. Safe to call from either core.
+        PipelineStats getStats() const;
+
+        // logStats() writes the counters to the log. Safe to call from either core.
+        void logStats() const;
+};
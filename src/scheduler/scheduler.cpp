@@ -0,0 +1,264 @@
+// Cooperative deadline scheduler
+
+#include <stdint.h>
+#include "pico/stdlib.h"
+#include "pico/time.h"
+#include "hardware/sync.h"
+
+#include "drivers/logging/logging.h"
+#include "scheduler.h"
+
+// Default time source: microseconds since boot
+static uint64_t sdkTimeSource() {
+    return to_us_since_boot(get_absolute_time());
+}
+
+Scheduler::Scheduler(SchedulerTimeSource clock)
+    : tasks(), clock(clock ? clock : sdkTimeSource), statsStart(0), stats(), alarmFired(false) {
+    statsStart = this->clock();
+}
+
+// --- Tasks ---
+
+int Scheduler::addPeriodic(const char* name, uint32_t periodUs, TaskFunction function, void* context,
+                           uint8_t priority, uint32_t firstDelayUs) {
+    if (periodUs == 0) {
+        return -1;
+    }
+    int id = addOneShotAt(name, clock() + firstDelayUs, function, context, priority);
+    if (id >= 0) {
+        tasks[id].periodUs = periodUs;
+    }
+    return id;
+}
+
+int Scheduler::addOneShot(const char* name, uint32_t delayUs, TaskFunction function, void* context,
+                          uint8_t priority) {
+    return addOneShotAt(name, clock() + delayUs, function, context, priority);
+}
+
+int Scheduler::addOneShotAt(const char* name, uint64_t deadline, TaskFunction function, void* context,
+                            uint8_t priority) {
+    for (int id = 0; id < MAX_TASKS; ++id) {
+        if (!tasks[id].active) {
+            tasks[id] = {function, context, deadline, 0, priority, true, {}};
+            tasks[id].stats.name = name;
+            return id;
+        }
+    }
+    log(LogLevel::ERROR, "Scheduler: No room for another task.");
+    return -1;
+}
+
+void Scheduler::remove(int id) {
+    if (id >= 0 && id < MAX_TASKS) {
+        tasks[id].active = false;
+    }
+}
+
+bool Scheduler::setDeadline(int id, uint64_t deadline) {
+    if (id < 0 || id >= MAX_TASKS || !tasks[id].active) {
+        return false;
+    }
+    tasks[id].deadline = deadline;
+    return true;
+}
+
+// --- Running ---
+
+// The due task with the highest priority, and among those the earliest deadline
+int Scheduler::nextDue(uint64_t now) const {
+    int best = -1;
+    for (int id = 0; id < MAX_TASKS; ++id) {
+        const Task& task = tasks[id];
+        if (!task.active || task.deadline > now) {
+            continue;
+        }
+        if (best < 0 || task.priority > tasks[best].priority ||
+            (task.priority == tasks[best].priority && task.deadline < tasks[best].deadline)) {
+            best = id;
+        }
+    }
+    return best;
+}
+
+void Scheduler::runTask(int id, uint64_t now) {
+    Task& task = tasks[id];
+    TaskFunction function = task.function;
+    void* context = task.context;
+
+    uint32_t jitter = (uint32_t)(now - task.deadline);
+    task.stats.runs++;
+    task.stats.totalJitterUs += jitter;
+    if (jitter > task.stats.maxJitterUs) {
+        task.stats.maxJitterUs = jitter;
+    }
+
+    // Schedule the next run before this one, so the task can move or remove itself. Whole periods that have already
+    // passed are skipped rather than run back to back.
+    if (task.periodUs > 0) {
+        uint64_t late = now - task.deadline;
+        if (late >= task.periodUs) {
+            task.stats.missed += (uint32_t)(late / task.periodUs);
+        }
+        task.deadline += (late / task.periodUs + 1) * task.periodUs;
+    } else {
+        task.active = false;
+    }
+
+    function(context);
+
+    uint64_t end = clock();
+    uint32_t runUs = (uint32_t)(end - now);
+    stats.busyUs += runUs;
+
+    // The slot may have been given to a new task while this one ran
+    if (task.function != function || task.context != context) {
+        return;
+    }
+    task.stats.totalRunUs += runUs;
+    if (runUs > task.stats.maxRunUs) {
+        task.stats.maxRunUs = runUs;
+    }
+    if (task.active && task.periodUs > 0 && end > task.deadline) {
+        task.stats.overruns++;
+    }
+}
+
+int Scheduler::runPending() {
+    int ran = 0;
+    for (;;) {
+        uint64_t now = clock();
+        int id = nextDue(now);
+        if (id < 0) {
+            return ran;
+        }
+        runTask(id, now);
+        ran++;
+    }
+}
+
+// Timer alarm that wakes the core from __wfi() at the deadline
+int64_t Scheduler::alarmCallback(int32_t id, void* user_data) {
+    static_cast<Scheduler*>(user_data)->alarmFired = true;
+    return 0;
+}
+
+void Scheduler::sleepUntil(uint64_t deadline) {
+    uint64_t start = clock();
+    if (deadline <= start) {
+        return;
+    }
+    stats.wakeups++;
+
+    if (deadline - start < MIN_SLEEP_US) {
+        while (clock() < deadline) {
+            tight_loop_contents();
+        }
+    } else {
+        alarmFired = false;
+        alarm_id_t alarm = add_alarm_in_us(deadline - start, alarmCallback, this, true);
+        for (;;) {
+            // Check and sleep with interrupts disabled so an alarm between the two still wakes the core
+            uint32_t irqStatus = save_and_disable_interrupts();
+            if (alarmFired) {
+                restore_interrupts(irqStatus);
+                break;
+            }
+            __wfi();
+            restore_interrupts(irqStatus);
+        }
+        if (alarm > 0) {
+            cancel_alarm(alarm);
+        }
+    }
+
+    stats.idleUs += clock() - start;
+}
+
+void Scheduler::run() {
+    for (;;) {
+        runPending();
+        uint64_t wait = timeUntilNextDeadline();
+        if (wait == UINT64_MAX) {
+            __wfi(); // Nothing to do until an interrupt adds a task
+        } else {
+            sleepUntil(clock() + wait);
+        }
+    }
+}
+
+void Scheduler::runFor(uint64_t durationUs) {
+    uint64_t end = clock() + durationUs;
+    for (;;) {
+        runPending();
+        uint64_t now = clock();
+        if (now >= end) {
+            return;
+        }
+        uint64_t wait = timeUntilNextDeadline();
+        sleepUntil(wait < end - now ? now + wait : end);
+    }
+}
+
+uint64_t Scheduler::timeUntilNextDeadline() const {
+    uint64_t now = clock();
+    uint64_t next = UINT64_MAX;
+    for (const Task& task : tasks) {
+        if (task.active && task.deadline < next) {
+            next = task.deadline;
+        }
+    }
+    if (next == UINT64_MAX) {
+        return UINT64_MAX;
+    }
+    return next <= now ? 0 : next - now;
+}
+
+// --- Statistics ---
+
+TaskStats Scheduler::getTaskStats(int id) const {
+    if (id < 0 || id >= MAX_TASKS || !tasks[id].active) {
+        return {};
+    }
+    return tasks[id].stats;
+}
+
+SchedulerStats Scheduler::getStats() const {
+    SchedulerStats snapshot = stats;
+    snapshot.elapsedUs = clock() - statsStart;
+    return snapshot;
+}
+
+void Scheduler::resetStats() {
+    for (Task& task : tasks) {
+        const char* name = task.stats.name;
+        task.stats = {};
+        task.stats.name = name;
+    }
+    stats = {};
+    statsStart = clock();
+}
+
+void Scheduler::logStats() const {
+    SchedulerStats snapshot = getStats();
+    uint64_t elapsed = snapshot.elapsedUs > 0 ? snapshot.elapsedUs : 1;
+
+    for (const Task& task : tasks) {
+        const TaskStats& taskStats = task.stats;
+        if (!task.active || taskStats.runs == 0) {
+            continue;
+        }
+        log<LogLevel::INFORMATION>("Task %s: %u runs, jitter mean %u us, max %u us", taskStats.name, taskStats.runs,
+                                   (uint32_t)(taskStats.totalJitterUs / taskStats.runs), taskStats.maxJitterUs);
+        log<LogLevel::INFORMATION>("Task %s: run mean %u us, max %u us, %.2f%% CPU", taskStats.name,
+                                   (uint32_t)(taskStats.totalRunUs / taskStats.runs), taskStats.maxRunUs,
+                                   100.0 * taskStats.totalRunUs / elapsed);
+        if (taskStats.overruns > 0 || taskStats.missed > 0) {
+            log<LogLevel::WARNING>("Task %s: %u overruns, %u periods missed", taskStats.name, taskStats.overruns,
+                                   taskStats.missed);
+        }
+    }
+    log<LogLevel::INFORMATION>("Scheduler: %.2f%% busy, %.2f%% asleep, %u wakeups", 100.0 * snapshot.busyUs / elapsed,
+                               100.0 * snapshot.idleUs / elapsed, snapshot.wakeups);
+}
@@ -0,0 +1,132 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+
+// -- Tasks --
+
+// A task's body. Tasks run to completion: nothing else runs on this core until the function returns, so it should do
+// a bounded amount of work and leave any waiting to the scheduler.
+typedef void (*TaskFunction)(void* context);
+
+// Source of time for the scheduler, in microseconds. The default reads the SDK clock (the mock clock in the native
+// build); a test can supply its own to step through a schedule deterministically.
+typedef uint64_t (*SchedulerTimeSource)();
+
+// Counters kept for each task. Times are in microseconds.
+struct TaskStats {
+    const char* name;
+    uint32_t runs;
+    uint32_t overruns;      // Runs that finished after the task's next deadline
+    uint32_t missed;        // Periods skipped because the task started too late to catch up with them
+    uint32_t maxJitterUs;   // Latest start after the deadline
+    uint64_t totalJitterUs;
+    uint32_t maxRunUs;      // Longest run
+    uint64_t totalRunUs;
+};
+
+// Counters for the scheduler as a whole, since it was created or its stats were reset
+struct SchedulerStats {
+    uint64_t elapsedUs; // Time covered by the counters
+    uint64_t busyUs;    // Time spent running tasks
+    uint64_t idleUs;    // Time spent asleep waiting for the next deadline
+    uint32_t wakeups;   // Times the core went to sleep and woke again
+};
+
+// -- Scheduler --
+
+// Scheduler runs periodic and one-shot tasks on one core, each at its own absolute deadline. When several tasks are
+// due, the one with the highest priority runs first, then the one with the earliest deadline. Between tasks the core
+// sleeps in __wfi() until the next deadline, woken by a timer alarm.
+//
+// Periodic deadlines advance by exactly one period, so a late start does not push later runs back. A task that starts
+// more than a whole period late skips the periods it missed rather than running several times in a row.
+class Scheduler {
+    public:
+        static constexpr int MAX_TASKS = 12;
+
+        // Deadlines closer than this are waited for by spinning, as setting up an alarm would take longer
+        static constexpr uint64_t MIN_SLEEP_US = 50;
+
+    private:
+        struct Task {
+            TaskFunction function;
+            void* context;
+            uint64_t deadline; // Absolute, in microseconds since boot
+            uint32_t periodUs; // 0 for a one-shot task
+            uint8_t priority;
+            bool active;
+            TaskStats stats;
+        };
+
+        Task tasks[MAX_TASKS];
+        SchedulerTimeSource clock;
+
+        // Stats window, and whether the timer alarm for the current sleep has fired
+        uint64_t statsStart;
+        SchedulerStats stats;
+        volatile bool alarmFired;
+
+        // nextDue() returns the task to run next if one is due at [now], or -1
+        int nextDue(uint64_t now) const;
+
+        // runTask() runs a due task and schedules its next run
+        void runTask(int id, uint64_t now);
+
+        // sleepUntil() sleeps until [deadline], waking on other interrupts only to go back to sleep
+        void sleepUntil(uint64_t deadline);
+
+        static int64_t alarmCallback(int32_t id, void* user_data);
+
+    public:
+        explicit Scheduler(SchedulerTimeSource clock = nullptr);
+
+        // addPeriodic() adds a task that runs every [periodUs], first [firstDelayUs] from now. Higher [priority] tasks
+        // run first when several are due. Returns the task's id, or -1 if the scheduler is full. [name] is stored by
+        // pointer, so it must outlive the task (e.g. a string literal).
+        int addPeriodic(const char* name, uint32_t periodUs, TaskFunction function, void* context = nullptr,
+                        uint8_t priority = 0, uint32_t firstDelayUs = 0);
+
+        // addOneShot() adds a task that runs once, [delayUs] from now. The task is removed after it runs.
+        int addOneShot(const char* name, uint32_t delayUs, TaskFunction function, void* context = nullptr,
+                       uint8_t priority = 0);
+
+        // addOneShotAt() adds a task that runs once at [deadline], in microseconds since boot
+        int addOneShotAt(const char* name, uint64_t deadline, TaskFunction function, void* context = nullptr,
+                         uint8_t priority = 0);
+
+        // remove() stops a task. A task may remove itself or another task while running.
+        void remove(int id);
+
+        // setDeadline() moves a task's next run to [deadline], in microseconds since boot. For a periodic task the
+        // runs after it follow on from the new deadline.
+        bool setDeadline(int id, uint64_t deadline);
+
+        // runPending() runs every task that is due, highest priority first, and returns the number run. It does not
+        // sleep, so a test with its own time source can call it after stepping the clock.
+        int runPending();
+
+        // run() runs tasks as they fall due and sleeps in between, forever
+        void run();
+
+        // runFor() runs tasks and sleeps in between for [durationUs]
+        void runFor(uint64_t durationUs);
+
+        // timeUntilNextDeadline() returns how long until the next task is due (0 if one is due now, UINT64_MAX if
+        // there are no tasks)
+        uint64_t timeUntilNextDeadline() const;
+
+        // - Statistics -
+
+        // getTaskStats() returns a task's counters, or all zeros (with a null name) for an unused id
+        TaskStats getTaskStats(int id) const;
+
+        // getStats() returns the scheduler's counters, up to now
+        SchedulerStats getStats() const;
+
+        // resetStats() clears every counter and starts a new stats window
+        void resetStats();
+
+        // logStats() logs each task's run count, jitter, run time, overruns and share of the CPU, and the overall load
+        void logStats() const;
+};
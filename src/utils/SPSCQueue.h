@@ -0,0 +1,56 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+// Bounded, lock-free queue for exactly one producer and one consumer, e.g. core 0 handing data to core 1.
+// Only atomic loads and stores are used (no read-modify-write), which the Cortex-M0+ supports without locks.
+// The indices increase forever and are masked on use, so all Capacity slots are usable.
+template <typename T, size_t Capacity>
+class SPSCQueue {
+    static_assert(Capacity > 0 && (Capacity & (Capacity - 1)) == 0, "Capacity must be a power of two");
+
+    private:
+        T items[Capacity];
+        std::atomic<uint32_t> head{0}; // Next slot to write, only changed by the producer
+        std::atomic<uint32_t> tail{0}; // Next slot to read, only changed by the consumer
+
+    public:
+        // push() copies item into the queue. Returns false if the queue is full. Producer only.
+        bool push(const T& item) {
+            uint32_t h = head.load(std::memory_order_relaxed);
+            if (h - tail.load(std::memory_order_acquire) >= Capacity) {
+                return false;
+            }
+            items[h & (Capacity - 1)] = item;
+            head.store(h + 1, std::memory_order_release);
+            return true;
+        }
+
+        // pop() moves the oldest item into item. Returns false if the queue is empty. Consumer only.
+        bool pop(T& item) {
+            uint32_t t = tail.load(std::memory_order_relaxed);
+            if (t == head.load(std::memory_order_acquire)) {
+                return false;
+            }
+            item = items[t & (Capacity - 1)];
+            tail.store(t + 1, std::memory_order_release);
+            return true;
+        }
+
+        // size() returns the number of queued items. Exact from either side's own thread, approximate otherwise.
+        size_t size() const {
+            // Read tail first: head can only have moved further on since, so the difference never underflows
+            uint32_t t = tail.load(std::memory_order_acquire);
+            return head.load(std::memory_order_acquire) - t;
+        }
+
+        bool empty() const {
+            return size() == 0;
+        }
+
+        static constexpr size_t capacity() {
+            return Capacity;
+        }
+};
@@ -0,0 +1,879 @@
+// Microbenchmarks for the driver hot paths, run natively against the Pico SDK mocks.
+//
+// Usage: labs_bench [--format=json|csv] [--out=FILE] [--filter=TEXT] [--min-time-ms=N] [--trace=FILE]
+//
+// Each benchmark reports the time per operation, heap allocations per operation and throughput. Results are written
+// as JSON (default) or CSV to stdout or FILE, so runs from two commits can be diffed. Everything the drivers print
+// while the benchmarks run is discarded. The recorder benchmarks record the samples in --trace (a CSV trace, as
+// LIS3DH_TRACE takes) if given, so their compression can be measured on real data.
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <atomic>
+#include <chrono>
+#include <filesystem>
+#include <new>
+#include <string>
+#include <vector>
+
+#ifdef _WIN32
+#include <io.h>
+#define dup _dup
+#define dup2 _dup2
+#define fileno _fileno
+#define close _close
+#define NULL_DEVICE "NUL"
+#else
+#include <unistd.h>
+#define NULL_DEVICE "/dev/null"
+#endif
+
+#include "pico/stdlib.h"
+#include "hardware/pio.h"
+#include "WS2812.pio.h"
+#include "drivers/LEDs/LEDs.h"
+#include "drivers/LEDs/StaticLEDController.h"
+#include "drivers/LIS3DH/LIS3DH.h"
+#include "drivers/logging/logging.h"
+#include "drivers/telemetry/telemetry.h"
+#include "drivers/recorder/recorder.h"
+#include "drivers/Board/Board.h"
+#include "dsp/dsp.h"
+#include "effects/effects.h"
+#include "scheduler/scheduler.h"
+#include "devices/lis3dh_sim.h"
+#include "hardware/flash.h"
+
+// --- Allocation counting
+
+static std::atomic<uint64_t> allocationCount{0};
+
+void* operator new(size_t size)
+{
+    allocationCount.fetch_add(1, std::memory_order_relaxed);
+    if (void* p = malloc(size ? size : 1)) {
+        return p;
+    }
+    throw std::bad_alloc();
+}
+
+void operator delete(void* p) noexcept
+{
+    free(p);
+}
+
+void operator delete(void* p, size_t) noexcept
+{
+    free(p);
+}
+
+// --- WS2812 sink
+// Stands in for tests/mocks/ws2812.cpp, counting pixels instead of printing them.
+
+static uint64_t pixelsSent = 0;
+
+static void ws2812_sink(PIO pio, unsigned int sm, uint32_t data)
+{
+    pixelsSent++;
+}
+
+pio_program_t ws2812_program = ws2812_sink;
+
+void ws2812_program_init(PIO pio, unsigned int sm, unsigned int offset, unsigned int pin, float freq, bool rgbw)
+{
+    pio_sm_init(pio, sm, offset, nullptr);
+}
+
+// --- Benchmark harness
+
+typedef std::chrono::steady_clock Clock;
+
+struct Result {
+    std::string name;
+    uint64_t iterations;
+    double nsPerOp;
+    double allocsPerOp;
+    uint32_t itemsPerOp;
+    double itemsPerSecond;
+};
+
+// Time excluded from the measurement, for setup that has to happen between operations
+static Clock::duration pausedTime;
+static Clock::time_point pauseStart;
+
+static void pauseTiming()
+{
+    pauseStart = Clock::now();
+}
+
+static void resumeTiming()
+{
+    pausedTime += Clock::now() - pauseStart;
+}
+
+struct Options {
+    const char* format = "json";
+    const char* outPath = nullptr;
+    const char* filter = nullptr;
+    uint32_t minTimeMs = 200;
+    const char* tracePath = nullptr;
+};
+
+static Options options;
+static std::vector<Result> results;
+
+// Whether the filter selects a benchmark (or group of benchmarks) by name
+static bool selected(const char* name)
+{
+    return !options.filter || strstr(name, options.filter) || strstr(options.filter, name);
+}
+
+// Run op in growing batches until the measured time reaches the minimum, then record the result
+template <typename Op>
+static void benchmark(const char* name, uint32_t itemsPerOp, Op op)
+{
+    if (!selected(name)) {
+        return;
+    }
+
+    // Warm up (first-use allocations, caches)
+    op();
+
+    uint64_t batch = 1;
+    for (;;) {
+        pausedTime = Clock::duration::zero();
+        uint64_t allocationsBefore = allocationCount.load();
+        auto start = Clock::now();
+        for (uint64_t i = 0; i < batch; ++i) {
+            op();
+        }
+        auto elapsed = Clock::now() - start - pausedTime;
+        uint64_t allocations = allocationCount.load() - allocationsBefore;
+
+        double ns = (double)std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count();
+        if (ns >= options.minTimeMs * 1e6 || batch >= (1ull << 32)) {
+            double nsPerOp = ns / batch;
+            results.push_back({name, batch, nsPerOp, (double)allocations / batch, itemsPerOp,
+                               nsPerOp > 0 ? itemsPerOp * 1e9 / nsPerOp : 0.0});
+            return;
+        }
+        batch *= 2;
+    }
+}
+
+// --- Benchmarks
+
+static const int NUM_LEDS = 300;
+
+static void ledBenchmarks()
+{
+    LEDController leds(NUM_LEDS);
+    leds.initLEDs();
+    for (int i = 0; i < NUM_LEDS; ++i) {
+        leds.getLED(i).setColor(i, 255 - i, i * 7);
+    }
+
+    // Frame packing and the DMA handoff; waiting for the previous frame to latch is not timed
+    benchmark("led_update_frame_300", NUM_LEDS, [&] {
+        pauseTiming();
+        leds.waitForFrame();
+        resumeTiming();
+        leds.markAllDirty();
+        leds.updateLEDsAsync();
+    });
+
+    // Clearing and redrawing the same frame: the update finds nothing changed and skips the transfer
+    benchmark("led_update_unchanged_300", NUM_LEDS, [&] {
+        leds.resetLEDs();
+        for (int i = 0; i < NUM_LEDS; ++i) {
+            leds.getLED(i).setColor(i, 255 - i, i * 7);
+        }
+        leds.updateLEDsAsync();
+    });
+
+    // Pixels sent by a five-LED comet crossing the first 60 LEDs, redrawn from black each frame as the effects do,
+    // against resending the whole strip. Reported on stderr, as it is not a timing.
+    if (selected("led_update")) {
+        LEDFrameStats before = leds.getFrameStats();
+        const int FRAMES = 120;
+        for (int frame = 0; frame < FRAMES; ++frame) {
+            leds.resetLEDs();
+            for (int i = 0; i < NUM_LEDS; ++i) {
+                leds.getLED(i).setColor(i, 255 - i, i * 7);
+            }
+            leds.fillRange(frame / 2, 5, packRGB(255, 255, 255)); // Moves every other frame
+            leds.updateLEDs();
+        }
+        LEDFrameStats after = leds.getFrameStats();
+        fprintf(stderr, "LED updates: %u of %d frames skipped, %.1f pixels sent per frame of %d\n",
+                after.framesSkipped - before.framesSkipped, FRAMES,
+                (double)(after.pixelsSent - before.pixelsSent) / FRAMES, NUM_LEDS);
+    }
+
+    // The same frame through the compile-time specialised controller, on a second state machine
+    static StaticLEDController<NUM_LEDS> staticLeds;
+    staticLeds.init(LED_PIN + 1);
+    for (int i = 0; i < NUM_LEDS; ++i) {
+        staticLeds.setColor(i, i, 255 - i, i * 7);
+    }
+    benchmark("led_static_update_frame_300", NUM_LEDS, [&] {
+        pauseTiming();
+        staticLeds.waitForFrame();
+        resumeTiming();
+        staticLeds.updateAsync();
+    });
+
+    std::vector<int> group;
+    for (int i = 0; i < NUM_LEDS; i += 3) {
+        group.push_back(i);
+    }
+    uint8_t level = 0;
+    benchmark("led_set_group_100", (uint32_t)group.size(), [&] {
+        leds.setLEDGroup(group, level++, 0, 255);
+    });
+
+    int hue = 0;
+    benchmark("led_hsv_to_rgb", 1, [&] {
+        std::vector<uint8_t> rgb = leds.HSVtoRGB(hue, 255, 255);
+        hue = (hue + 1) % 360;
+    });
+
+    HSV rainbow[NUM_LEDS];
+    for (int i = 0; i < NUM_LEDS; ++i) {
+        rainbow[i] = {(uint16_t)(i * 65536 / NUM_LEDS), 255, 255};
+    }
+    benchmark("led_hsv_range_300", NUM_LEDS, [&] {
+        rainbow[0].h++;
+        leds.setHSVRange(0, rainbow, NUM_LEDS);
+    });
+
+    benchmark("led_get_summary_300", NUM_LEDS, [&] {
+        std::string summary = leds.getSummary();
+    });
+
+    static char report[16384];
+    benchmark("led_write_summary_300", NUM_LEDS, [&] {
+        leds.writeSummary(report, sizeof(report));
+    });
+
+    size_t reportBytes = 0;
+    ReportSink countBytes = [](void* context, const char* text, size_t length) { *(size_t*)context += length; };
+    benchmark("led_write_summary_sink_300", NUM_LEDS, [&] {
+        leds.writeSummary(countBytes, &reportBytes);
+    });
+
+    // A strip that is up to date, then one with a filled run and a few single LEDs waiting
+    for (int i = 0; i < NUM_LEDS; ++i) {
+        leds.getLED(i).applyColor();
+    }
+    benchmark("led_write_dirty_clean_300", NUM_LEDS, [&] {
+        leds.writeDirty(report, sizeof(report));
+    });
+    leds.fillRange(100, 50, packRGB(255, 0, 0));
+    for (int i = 0; i < NUM_LEDS; i += 37) {
+        leds.getLED(i).setColor(0, 0, 255);
+    }
+    benchmark("led_write_dirty_300", NUM_LEDS, [&] {
+        leds.writeDirty(report, sizeof(report));
+    });
+
+    leds.waitForFrame();
+    staticLeds.waitForFrame();
+}
+
+// Stepped by the effects benchmarks instead of sleeping
+static uint64_t effectsNow = 0;
+
+static uint64_t effectsClock()
+{
+    return effectsNow;
+}
+
+// Stands in for an effect that is slow to draw: drawing it the first time moves the effects clock on by drawUs
+class SlowEffect : public Effect {
+    private:
+        uint32_t drawUs;
+        bool pending;
+    public:
+        SlowEffect(uint32_t drawUs) : Effect(0, 0), drawUs(drawUs), pending(true) {}
+        bool update(uint64_t now_us) override { return pending; }
+        void draw(LEDController& leds) override
+        {
+            if (pending) {
+                effectsNow += drawUs;
+                pending = false;
+            }
+        }
+};
+
+static const uint32_t EFFECTS_FRAME_RATE = 30;
+
+static void effectsBenchmarks()
+{
+    LEDController leds(NUM_LEDS);
+    leds.initLEDs();
+    const uint64_t framePeriod = 1000000 / EFFECTS_FRAME_RATE;
+
+    // Red held until 500 ms, then to green and blue, looping every 2 s
+    static const Keyframe keyframes[] = {
+        {500, packRGB(255, 0, 0)}, {1000, packRGB(0, 255, 0)}, {2000, packRGB(0, 0, 255)}};
+    FillEffect fill(0, NUM_LEDS, packRGB(0, 0, 16));
+    ChaseEffect chase(0, 60, packRGB(255, 255, 255), 10);
+    FadeEffect fade(60, 60, packRGB(0, 0, 0), packRGB(255, 128, 0), 1000);
+    KeyframeEffect keyframe(120, 60, keyframes, sizeof(keyframes) / sizeof(keyframes[0]));
+
+    // All four at once, one frame per step of the clock; waiting for the previous frame to latch is not timed
+    EffectsEngine engine(leds, EFFECTS_FRAME_RATE, effectsClock);
+    engine.addEffect(&fill);
+    engine.addEffect(&chase);
+    engine.addEffect(&fade);
+    engine.addEffect(&keyframe);
+    benchmark("effects_tick_300", NUM_LEDS, [&] {
+        effectsNow += framePeriod;
+        pauseTiming();
+        leds.waitForFrame();
+        resumeTiming();
+        engine.tick();
+    });
+
+    // Each effect on its own for 2 s of the clock, then a draw that takes 50 ms and a caller that sleeps through
+    // frames. The frame counts depend only on the clock, so they are the same on every run. Reported on stderr, as
+    // they are not timings.
+    if (selected("effects_")) {
+        const int FRAMES = 2 * EFFECTS_FRAME_RATE;
+        EffectsEngine sequence(leds, EFFECTS_FRAME_RATE, effectsClock);
+        struct Phase {
+            const char* name;
+            Effect* effect;
+        };
+        const Phase phases[] = {{"fill", &fill}, {"chase", &chase}, {"fade", &fade}, {"keyframes", &keyframe}};
+        for (const Phase& phase : phases) {
+            sequence.clearEffects();
+            sequence.addEffect(phase.effect);
+            EffectsStats before = sequence.getStats();
+            for (int frame = 0; frame < FRAMES; ++frame) {
+                leds.waitForFrame();
+                sequence.tick();
+                effectsNow += framePeriod;
+            }
+            EffectsStats after = sequence.getStats();
+            fprintf(stderr, "Effects: %-9s %2u of %d frames sent, %2u skipped, %u deferred\n", phase.name,
+                    after.framesSent - before.framesSent, FRAMES, after.framesSkipped - before.framesSkipped,
+                    after.framesDeferred - before.framesDeferred);
+        }
+
+        // The slow draw overruns its frame and makes the next tick one frame late; sleeping through four more
+        // frame periods misses four more
+        SlowEffect slow(50000);
+        sequence.clearEffects();
+        sequence.addEffect(&slow);
+        EffectsStats before = sequence.getStats();
+        leds.waitForFrame();
+        sequence.tick();
+        effectsNow += framePeriod;
+        sequence.tick();
+        effectsNow += 5 * framePeriod;
+        sequence.tick();
+        EffectsStats after = sequence.getStats();
+        fprintf(stderr, "Effects: %u overruns (expected 1), %u frames missed (expected 5), longest frame %u us\n",
+                after.overruns - before.overruns, after.framesMissed - before.framesMissed, after.maxRenderUs);
+    }
+
+    leds.waitForFrame();
+}
+
+static void accelBenchmarks()
+{
+    accelDriver accel;
+    AccelRawFrame frames[ACCEL_FIFO_DEPTH];
+    AccelSample samples[ACCEL_FIFO_DEPTH];
+    float gs[3 * ACCEL_FIFO_DEPTH];
+    for (size_t i = 0; i < ACCEL_FIFO_DEPTH; ++i) {
+        frames[i] = {(int16_t)(i * 512), (int16_t)(-(int)i * 256), 16000};
+    }
+
+    uint32_t timestamp = 0;
+    benchmark("accel_convert_mg_32", ACCEL_FIFO_DEPTH, [&] {
+        accel.convertFrames(frames, samples, ACCEL_FIFO_DEPTH, timestamp += 80000);
+    });
+
+    benchmark("accel_convert_gs_32", ACCEL_FIFO_DEPTH, [&] {
+        accel.convertFramesToGs(frames, gs, ACCEL_FIFO_DEPTH);
+    });
+
+    int16_t raw = 0;
+    volatile float sink;
+    benchmark("accel_convert_to_gs", 1, [&] {
+        sink = accel.convertToGs(raw++);
+    });
+
+    // Draining a full FIFO over the simulated bus. The sensor is left powered down so only the injected samples
+    // reach the FIFO.
+    static LIS3DHSim sensor;
+    sensor.attach(I2C_INSTANCE, I2C_ADDRESS, ACCEL_INT1_PIN);
+    accel.enableFifo(AccelFifoMode::STREAM, 0);
+    benchmark("accel_drain_fifo_32", ACCEL_FIFO_DEPTH, [&] {
+        pauseTiming();
+        sensor.injectSamples(ACCEL_FIFO_DEPTH);
+        resumeTiming();
+        accel.drainFifo(frames, ACCEL_FIFO_DEPTH);
+    });
+    sensor.detach();
+}
+
+// Float reference for the DSP stages: the same filters in single precision, as they would be written without fixed
+// point, to compare speed and accuracy against
+struct FloatBiquad {
+    float b0, b1, b2, a1, a2;
+    float x1[3], x2[3], y1[3], y2[3];
+
+    FloatBiquad(bool highPass, float sampleRateHz, float cutoffHz)
+        : x1(), x2(), y1(), y2()
+    {
+        float w0 = 2.0f * (float)M_PI * cutoffHz / sampleRateHz;
+        float cosW0 = cosf(w0);
+        float alpha = sinf(w0) / (2.0f * 0.70710678f);
+        float a0 = 1.0f + alpha;
+        float b = highPass ? (1.0f + cosW0) / 2.0f : (1.0f - cosW0) / 2.0f;
+        b0 = b / a0;
+        b1 = (highPass ? -2.0f * b : 2.0f * b) / a0;
+        b2 = b / a0;
+        a1 = -2.0f * cosW0 / a0;
+        a2 = (1.0f - alpha) / a0;
+    }
+
+    void process(float* xyz, size_t count)
+    {
+        for (size_t i = 0; i < count; ++i) {
+            for (int a = 0; a < 3; ++a) {
+                float x0 = xyz[3 * i + a];
+                float y0 = b0 * x0 + b1 * x1[a] + b2 * x2[a] - a1 * y1[a] - a2 * y2[a];
+                x2[a] = x1[a];
+                x1[a] = x0;
+                y2[a] = y1[a];
+                y1[a] = y0;
+                xyz[3 * i + a] = y0;
+            }
+        }
+    }
+};
+
+static void floatMagnitude(float* xyz, size_t count)
+{
+    for (size_t i = 0; i < count; ++i) {
+        float* v = &xyz[3 * i];
+        v[0] = sqrtf(v[0] * v[0] + v[1] * v[1] + v[2] * v[2]);
+        v[1] = v[2] = 0.0f;
+    }
+}
+
+static const float DSP_RATE_HZ = 400.0f;
+
+// One FIFO drain of a 2 Hz wobble on top of gravity, continuing from the previous block
+static void dspTestBlock(AccelSample* samples, float* xyz, size_t count, uint32_t& n)
+{
+    for (size_t i = 0; i < count; ++i, ++n) {
+        float t = n / DSP_RATE_HZ;
+        float wobble = 800.0f * sinf(2.0f * (float)M_PI * 2.0f * t);
+        int16_t x = (int16_t)wobble;
+        int16_t y = (int16_t)(0.5f * wobble + (int)(n * 7919 % 61) - 30); // Plus some noise
+        int16_t z = (int16_t)(1000.0f + 0.25f * wobble);
+        samples[i] = {x, y, z, AccelStatus::OK, n * 2500};
+        xyz[3 * i + 0] = x;
+        xyz[3 * i + 1] = y;
+        xyz[3 * i + 2] = z;
+    }
+}
+
+// Largest difference between the fixed-point and float outputs on any axis
+static float maxError(const AccelSample* samples, const float* xyz, size_t count)
+{
+    float error = 0.0f;
+    for (size_t i = 0; i < count; ++i) {
+        error = fmaxf(error, fabsf(samples[i].x_mg - xyz[3 * i + 0]));
+        error = fmaxf(error, fabsf(samples[i].y_mg - xyz[3 * i + 1]));
+        error = fmaxf(error, fabsf(samples[i].z_mg - xyz[3 * i + 2]));
+    }
+    return error;
+}
+
+static void dspBenchmarks()
+{
+    const size_t BLOCK = ACCEL_FIFO_DEPTH;
+    AccelSample input[BLOCK], samples[BLOCK];
+    float inputXyz[3 * BLOCK], xyz[3 * BLOCK];
+    uint32_t n = 0;
+    dspTestBlock(input, inputXyz, BLOCK, n);
+
+    BiquadStage lowPass(biquadLowPass(DSP_RATE_HZ, 5.0f));
+    benchmark("dsp_biquad_q15_32", BLOCK, [&] {
+        memcpy(samples, input, sizeof(samples));
+        lowPass.process(samples, BLOCK);
+    });
+
+    FloatBiquad floatLowPass(false, DSP_RATE_HZ, 5.0f);
+    benchmark("dsp_biquad_float_32", BLOCK, [&] {
+        memcpy(xyz, inputXyz, sizeof(xyz));
+        floatLowPass.process(xyz, BLOCK);
+    });
+
+    MovingAverageStage<8> average;
+    benchmark("dsp_moving_average_8_32", BLOCK, [&] {
+        memcpy(samples, input, sizeof(samples));
+        average.process(samples, BLOCK);
+    });
+
+    MagnitudeStage magnitude;
+    benchmark("dsp_magnitude_q15_32", BLOCK, [&] {
+        memcpy(samples, input, sizeof(samples));
+        magnitude.process(samples, BLOCK);
+    });
+
+    benchmark("dsp_magnitude_float_32", BLOCK, [&] {
+        memcpy(xyz, inputXyz, sizeof(xyz));
+        floatMagnitude(xyz, BLOCK);
+    });
+
+    // Gravity removal and smoothing with 4x decimation, as a consumer wanting 100 Hz motion data would set it up
+    BiquadStage gravity(biquadHighPass(DSP_RATE_HZ, 0.5f));
+    BiquadStage smoothing(biquadLowPass(DSP_RATE_HZ, 20.0f));
+    DecimateStage decimate(4);
+    DspChain chain;
+    chain.add(gravity);
+    chain.add(smoothing);
+    chain.add(decimate);
+    benchmark("dsp_chain_32", BLOCK, [&] {
+        memcpy(samples, input, sizeof(samples));
+        chain.process(samples, BLOCK);
+    });
+
+    // Accuracy of the fixed-point filters against the float reference over 10 seconds of samples, after a second to
+    // settle. Reported on stderr, as it is not a timing.
+    if (!selected("dsp_")) {
+        return;
+    }
+    BiquadStage fixedLow(biquadLowPass(DSP_RATE_HZ, 5.0f)), fixedHigh(biquadHighPass(DSP_RATE_HZ, 0.5f));
+    FloatBiquad referenceLow(false, DSP_RATE_HZ, 5.0f), referenceHigh(true, DSP_RATE_HZ, 0.5f);
+    AccelSample lowSamples[BLOCK];
+    float lowXyz[3 * BLOCK];
+    float lowError = 0.0f, highError = 0.0f;
+    n = 0;
+    while (n < 10 * DSP_RATE_HZ) {
+        dspTestBlock(samples, xyz, BLOCK, n);
+        memcpy(lowSamples, samples, sizeof(samples));
+        memcpy(lowXyz, xyz, sizeof(xyz));
+        fixedLow.process(lowSamples, BLOCK);
+        referenceLow.process(lowXyz, BLOCK);
+        fixedHigh.process(samples, BLOCK);
+        referenceHigh.process(xyz, BLOCK);
+        if (n > DSP_RATE_HZ) {
+            lowError = fmaxf(lowError, maxError(lowSamples, lowXyz, BLOCK));
+            highError = fmaxf(highError, maxError(samples, xyz, BLOCK));
+        }
+    }
+    fprintf(stderr, "DSP error against float: low-pass %.1f mg, high-pass %.1f mg\n", lowError, highError);
+}
+
+static void telemetryBenchmarks()
+{
+    AccelSample samples[TELEMETRY_MAX_SAMPLES];
+    for (size_t i = 0; i < TELEMETRY_MAX_SAMPLES; ++i) {
+        samples[i] = {(int16_t)(i * 31 - 500), (int16_t)(i * 7), 1000, AccelStatus::OK, (uint32_t)(i * 2500)};
+    }
+
+    // A full FIFO as one frame, written to the (discarded) UART
+    TelemetryStats before = telemetryGetStats();
+    benchmark("telemetry_send_32", TELEMETRY_MAX_SAMPLES, [&] {
+        telemetrySendSamples(samples, TELEMETRY_MAX_SAMPLES);
+    });
+    TelemetryStats after = telemetryGetStats();
+
+    uint8_t encoded[TELEMETRY_MAX_ENCODED_SIZE];
+    size_t encodedLength = 0;
+    {
+        uint8_t raw[TELEMETRY_MAX_RAW_SIZE] = {TELEMETRY_TYPE_SAMPLES, (uint8_t)TELEMETRY_MAX_SAMPLES};
+        encodedLength = telemetryFinishFrame(raw, TELEMETRY_MAX_RAW_SIZE - TELEMETRY_CRC_SIZE, encoded);
+    }
+    TelemetryFrame frame;
+    benchmark("telemetry_decode_32", TELEMETRY_MAX_SAMPLES, [&] {
+        telemetryDecodeFrame(encoded + 1, encodedLength - 2, frame);
+    });
+
+    // Wire cost per sample against logging each one as text. Reported on stderr, as it is not a timing.
+    if (after.samples == before.samples) {
+        return;
+    }
+    double binaryBytes = (double)(after.bytes - before.bytes) / (after.samples - before.samples);
+    char line[128];
+    int textBytes = snprintf(line, sizeof(line),
+                             "[%u.%03u Information]: Accelerometer Data: X: %d mG, Y: %d mG, Z: %d mG\n", 1234u, 567u,
+                             -1012, 388, 1000);
+    const double BYTES_PER_SECOND = 115200 / 10.0; // 8N1
+    fprintf(stderr, "Telemetry: %.1f bytes per sample (%.0f samples/s at 115200 baud), text: %d (%.0f samples/s)\n",
+            binaryBytes, BYTES_PER_SECOND / binaryBytes, textBytes, BYTES_PER_SECOND / textBytes);
+}
+
+// Samples for the recorder benchmarks: the --trace file at 400 Hz, or a minute of the DSP test signal. The trace is
+// read as LIS3DHSim::loadTrace() reads it.
+static std::vector<AccelSample> recorderInput()
+{
+    std::vector<AccelSample> samples;
+    if (options.tracePath) {
+        FILE* file = fopen(options.tracePath, "r");
+        if (!file) {
+            fprintf(stderr, "Could not open %s, using the test signal\n", options.tracePath);
+        } else {
+            char line[256];
+            while (fgets(line, sizeof(line), file)) {
+                float values[4];
+                int count = sscanf(line, "%f,%f,%f,%f", &values[0], &values[1], &values[2], &values[3]);
+                if (count == 3 || count == 4) {
+                    const float* xyz = values + (count - 3);
+                    samples.push_back({(int16_t)lrintf(xyz[0]), (int16_t)lrintf(xyz[1]), (int16_t)lrintf(xyz[2]),
+                                       AccelStatus::OK, (uint32_t)(samples.size() * 2500)});
+                }
+            }
+            fclose(file);
+        }
+    }
+    if (samples.size() < ACCEL_FIFO_DEPTH) {
+        samples.resize(60 * (size_t)DSP_RATE_HZ / ACCEL_FIFO_DEPTH * ACCEL_FIFO_DEPTH);
+        std::vector<float> xyz(3 * samples.size());
+        uint32_t n = 0;
+        dspTestBlock(samples.data(), xyz.data(), samples.size(), n);
+    }
+    return samples;
+}
+
+static void recorderBenchmarks()
+{
+    if (!selected("recorder_")) {
+        return;
+    }
+
+    // Back the flash with a memory-mapped file, as the native build does with PICO_MOCK_FLASH_FILE
+    std::string path = (std::filesystem::temp_directory_path() / "labs_bench_flash.bin").string();
+    remove(path.c_str());
+    if (!mock_flash_open(path.c_str())) {
+        fprintf(stderr, "Could not map %s as flash, skipping the recorder benchmarks\n", path.c_str());
+        return;
+    }
+    std::vector<AccelSample> input = recorderInput();
+    size_t blocks = input.size() / ACCEL_FIFO_DEPTH;
+
+    int16_t xyz[ACCEL_FIFO_DEPTH][3];
+    for (size_t i = 0; i < ACCEL_FIFO_DEPTH; ++i) {
+        xyz[i][0] = input[i].x_mg;
+        xyz[i][1] = input[i].y_mg;
+        xyz[i][2] = input[i].z_mg;
+    }
+    uint8_t chunk[RECORDER_MAX_CHUNK_SIZE];
+    benchmark("recorder_encode_32", ACCEL_FIFO_DEPTH, [&] {
+        recorderEncodeChunk(xyz, ACCEL_FIFO_DEPTH, 0, 2500, chunk);
+    });
+
+    // A FIFO's worth at a time, with the page writes and sector erases that fall due. The input repeats, going back
+    // in time at the end, which starts a new chunk once a pass.
+    AccelRecorder recorder;
+    recorder.init();
+    size_t block = 0;
+    benchmark("recorder_record_32", ACCEL_FIFO_DEPTH, [&] {
+        recorder.record(&input[block * ACCEL_FIFO_DEPTH], ACCEL_FIFO_DEPTH);
+        block = (block + 1) % blocks;
+    });
+    recorder.flush();
+
+    RecorderCursor cursor = recorder.begin();
+    AccelSample samples[ACCEL_FIFO_DEPTH];
+    benchmark("recorder_read_32", ACCEL_FIFO_DEPTH, [&] {
+        if (recorder.read(cursor, samples, ACCEL_FIFO_DEPTH) == 0) {
+            cursor = recorder.begin();
+        }
+    });
+
+    // Flash used by one pass over the input, against 6 bytes for a packed sample. Reported on stderr, as it is not a
+    // timing.
+    recorder.clear();
+    RecorderStats before = recorder.getStats();
+    for (size_t i = 0; i < blocks; ++i) {
+        recorder.record(&input[i * ACCEL_FIFO_DEPTH], ACCEL_FIFO_DEPTH);
+    }
+    recorder.flush();
+    RecorderStats after = recorder.getStats();
+    uint32_t recorded = after.samples - before.samples;
+    double bytesPerSample = (double)(after.bytes - before.bytes) / recorded;
+    fprintf(stderr, "Recorder: %.2f bytes per sample on %s (%.2fx smaller than raw), %.0f seconds at 400 Hz in %u KB\n",
+            bytesPerSample, options.tracePath ? options.tracePath : "the test signal", 6.0 / bytesPerSample,
+            RECORDER_FLASH_SIZE / bytesPerSample / 400, RECORDER_FLASH_SIZE / 1024);
+    fprintf(stderr, "Recorder: %.1f page writes and %.2f sector erases per 1000 samples\n",
+            1000.0 * (after.pagesProgrammed - before.pagesProgrammed) / recorded,
+            1000.0 * (after.sectorsErased - before.sectorsErased) / recorded);
+
+    mock_flash_close();
+    remove(path.c_str());
+}
+
+// Stepped by the scheduler benchmark instead of sleeping
+static uint64_t schedulerNow = 0;
+
+static uint64_t schedulerClock()
+{
+    return schedulerNow;
+}
+
+static void schedulerBenchmarks()
+{
+    // Four tasks at the rates the scheduled main loop uses, stepped 1 ms at a time: about one task runs per step
+    Scheduler scheduler(schedulerClock);
+    uint32_t runs = 0;
+    TaskFunction count = [](void* context) { ++*static_cast<uint32_t*>(context); };
+    scheduler.addPeriodic("sensor", 20000, count, &runs, 2);
+    scheduler.addPeriodic("render", 33000, count, &runs, 1);
+    scheduler.addPeriodic("output", 100000, count, &runs, 0);
+    scheduler.addPeriodic("stats", 5000000, count, &runs, 0);
+    benchmark("scheduler_step_1ms", 1, [&] {
+        schedulerNow += 1000;
+        scheduler.runPending();
+    });
+
+    // Every task due at once, so each step dispatches all four in priority order
+    benchmark("scheduler_dispatch_4", 4, [&] {
+        schedulerNow += 5000000;
+        scheduler.runPending();
+    });
+}
+
+static void logBenchmarks()
+{
+    int value = 0;
+
+    // Below the runtime threshold, so nothing should be captured or formatted
+    setLogLevel(LogLevel::ERROR);
+    benchmark("log_filtered", 1, [&] {
+        log<LogLevel::INFORMATION>("x=%d y=%d", value++, 42);
+    });
+    setLogLevel(LogLevel::INFORMATION);
+
+    setLogMode(LogMode::IMMEDIATE);
+    benchmark("log_immediate", 1, [&] {
+        log<LogLevel::INFORMATION>("x=%d y=%d", value++, 42);
+    });
+
+    // Queue records, draining (untimed) before the queue fills
+    setLogMode(LogMode::DEFERRED);
+    size_t queued = 0;
+    benchmark("log_deferred", 1, [&] {
+        if (queued == LOG_QUEUE_LENGTH) {
+            pauseTiming();
+            logDrain();
+            queued = 0;
+            resumeTiming();
+        }
+        log<LogLevel::INFORMATION>("x=%d y=%d", value++, 42);
+        queued++;
+    });
+    logDrain();
+
+    // Formatting and printing a full queue
+    benchmark("log_drain_64", LOG_QUEUE_LENGTH, [&] {
+        pauseTiming();
+        for (size_t i = 0; i < LOG_QUEUE_LENGTH; ++i) {
+            log<LogLevel::INFORMATION>("x=%d y=%d", value++, 42);
+        }
+        resumeTiming();
+        logDrain();
+    });
+    setLogMode(LogMode::IMMEDIATE);
+}
+
+// --- Output
+
+static void writeResults(FILE* out)
+{
+    if (strcmp(options.format, "csv") == 0) {
+        fprintf(out, "name,iterations,ns_per_op,allocs_per_op,items_per_op,items_per_second\n");
+        for (const Result& r : results) {
+            fprintf(out, "%s,%llu,%.2f,%.3f,%u,%.0f\n", r.name.c_str(), (unsigned long long)r.iterations, r.nsPerOp,
+                    r.allocsPerOp, r.itemsPerOp, r.itemsPerSecond);
+        }
+        return;
+    }
+
+    fprintf(out, "{\n  \"benchmarks\": [\n");
+    for (size_t i = 0; i < results.size(); ++i) {
+        const Result& r = results[i];
+        fprintf(out,
+                "    {\"name\": \"%s\", \"iterations\": %llu, \"ns_per_op\": %.2f, \"allocs_per_op\": %.3f, "
+                "\"items_per_op\": %u, \"items_per_second\": %.0f}%s\n",
+                r.name.c_str(), (unsigned long long)r.iterations, r.nsPerOp, r.allocsPerOp, r.itemsPerOp,
+                r.itemsPerSecond, i + 1 < results.size() ? "," : "");
+    }
+    fprintf(out, "  ]\n}\n");
+}
+
+static bool parseArguments(int argc, char** argv)
+{
+    for (int i = 1; i < argc; ++i) {
+        const char* arg = argv[i];
+        if (strncmp(arg, "--format=", 9) == 0) {
+            options.format = arg + 9;
+        } else if (strncmp(arg, "--out=", 6) == 0) {
+            options.outPath = arg + 6;
+        } else if (strncmp(arg, "--filter=", 9) == 0) {
+            options.filter = arg + 9;
+        } else if (strncmp(arg, "--min-time-ms=", 14) == 0) {
+            options.minTimeMs = (uint32_t)atoi(arg + 14);
+        } else if (strncmp(arg, "--trace=", 8) == 0) {
+            options.tracePath = arg + 8;
+        } else {
+            fprintf(stderr,
+                    "Usage: %s [--format=json|csv] [--out=FILE] [--filter=TEXT] [--min-time-ms=N] [--trace=FILE]\n",
+                    argv[0]);
+            return false;
+        }
+    }
+    return true;
+}
+
+int main(int argc, char** argv)
+{
+    if (!parseArguments(argc, argv)) {
+        return 1;
+    }
+
+    // Discard the drivers' and mocks' own output while benchmarking
+    fflush(stdout);
+    int savedStdout = dup(fileno(stdout));
+    if (!freopen(NULL_DEVICE, "w", stdout)) {
+        return 1;
+    }
+
+    ledBenchmarks();
+    effectsBenchmarks();
+    accelBenchmarks();
+    dspBenchmarks();
+    schedulerBenchmarks();
+    telemetryBenchmarks();
+    recorderBenchmarks();
+    logBenchmarks();
+
+    fflush(stdout);
+    dup2(savedStdout, fileno(stdout));
+    close(savedStdout);
+
+    FILE* out = stdout;
+    if (options.outPath) {
+        out = fopen(options.outPath, "w");
+        if (!out) {
+            fprintf(stderr, "Could not open %s\n", options.outPath);
+            return 1;
+        }
+    }
+    writeResults(out);
+    if (out != stdout) {
+        fclose(out);
+    }
+    return 0;
+}
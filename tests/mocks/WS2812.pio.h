@@ -0,0 +1,60 @@
+#pragma once
+#include <stdint.h>
+#include <stddef.h>
+#include <vector>
+#include "hardware/pio.h"
+
+extern pio_program_t ws2812_program;
+
+void ws2812_program_init(PIO pio, unsigned int sm, unsigned int offset, unsigned int pin, float freq, bool rgbw);
+
+// Mock only: frame capture. Words sent to the program are collected into preallocated frame buffers and a frame is
+// latched once the line has been idle for 280 us, as on the real LEDs. Each state machine running the program is a
+// separate LED chain, captured separately. Latched frames are passed to the enabled sinks (console, binary file,
+// memory) on a background thread, away from the code sending the data.
+
+// A latched frame. Pixels are the raw words sent to the state machine (colour in the top 24 or 32 bits).
+struct mock_ws2812_frame {
+    uint64_t timestamp_us; // Time the frame latched
+    unsigned int pio;      // The chain it was sent on: PIO index and state machine
+    unsigned int sm;
+    std::vector<uint32_t> pixels;
+};
+
+struct mock_ws2812_stats {
+    uint64_t frames;           // Frames latched
+    uint64_t pixels;           // Pixels in the latched frames
+    uint64_t frames_dropped;   // Frames lost because every capture buffer was waiting to be processed
+    uint64_t pixels_dropped;   // Pixels lost to dropped frames or frames longer than MOCK_WS2812_MAX_PIXELS
+    double frames_per_second;  // Rates between the first and last latched frames
+    double pixels_per_second;
+};
+
+// Longest frame that can be captured, and the number of frames that can wait to be processed
+#define MOCK_WS2812_MAX_PIXELS 4096
+#define MOCK_WS2812_FRAME_SLOTS 32
+
+// Print every frame to stdout (on by default). The words are decoded as a real WS2812 would, in GRB order (GRBW for
+// RGBW chains), so a strip packed in the wrong colour order shows up with its channels swapped. Chains other than pio0
+// sm0 are labelled with their PIO and state machine.
+void mock_ws2812_set_console_output(bool enabled);
+
+// Append every frame to a binary file, replacing any previous recording. Returns false if the file can't be opened.
+// Format (little-endian): the header "W2FR", u8 version (2), 3 reserved bytes; then per frame: u64 timestamp_us, u32
+// pixel count, u8 PIO index, u8 state machine, u8 bytes per pixel (3, or 4 for RGBW), u8 reserved, and each pixel's
+// top bytes, most significant first.
+bool mock_ws2812_start_recording(const char* path);
+void mock_ws2812_stop_recording();
+
+// Keep up to max_frames of the latest frames in memory for assertions (0 to stop keeping them)
+void mock_ws2812_keep_frames(size_t max_frames);
+
+// Return and forget the frames kept in memory
+std::vector<mock_ws2812_frame> mock_ws2812_take_frames();
+
+// Wait until at least count frames have latched since the capture started. Returns false on timeout.
+bool mock_ws2812_wait_for_frames(uint64_t count, uint32_t timeout_ms);
+
+// Counters and rates since the capture started
+mock_ws2812_stats mock_ws2812_get_stats();
+void mock_ws2812_print_stats();
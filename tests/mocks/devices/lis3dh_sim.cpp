@@ -0,0 +1,814 @@
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include "devices/lis3dh_sim.h"
+#include "hardware/gpio.h"
+
+// Register map (LIS3DH datasheet section 7). Kept separate from the driver's definitions so that a mistake there
+// isn't hidden by the simulator.
+#define REG_WHO_AM_I 0x0F
+#define REG_CTRL_REG0 0x1E
+#define REG_CTRL_REG1 0x20
+#define REG_CTRL_REG2 0x21
+#define REG_CTRL_REG3 0x22
+#define REG_CTRL_REG4 0x23
+#define REG_CTRL_REG5 0x24
+#define REG_CTRL_REG6 0x25
+#define REG_STATUS 0x27
+#define REG_OUT_X_L 0x28
+#define REG_OUT_Z_H 0x2D
+#define REG_FIFO_CTRL 0x2E
+#define REG_FIFO_SRC 0x2F
+#define REG_INT1_CFG 0x30
+#define REG_INT1_SRC 0x31
+#define REG_INT2_SRC 0x35
+#define REG_CLICK_CFG 0x38
+#define REG_CLICK_SRC 0x39
+#define REG_CLICK_THS 0x3A
+#define REG_TIME_LIMIT 0x3B
+#define REG_TIME_LATENCY 0x3C
+#define REG_TIME_WINDOW 0x3D
+
+// Offsets from INTx_CFG to the rest of a generator's registers, and from INT1_CFG to INT2_CFG
+#define GEN_THS 2
+#define GEN_DURATION 3
+#define GEN_STRIDE 4
+
+#define WHO_AM_I_VALUE 0x33
+#define SUB_AUTO_INCREMENT 0x80
+
+#define CTRL_REG1_LPEN 0x08
+#define CTRL_REG2_HPCLICK 0x04
+#define CTRL_REG3_I1_CLICK 0x80
+#define CTRL_REG3_I1_IA1 0x40
+#define CTRL_REG3_I1_IA2 0x20
+#define CTRL_REG3_I1_DRDY1 0x10
+#define CTRL_REG3_I1_WTM 0x04
+#define CTRL_REG3_I1_OVERRUN 0x02
+#define CTRL_REG4_HR 0x08
+#define CTRL_REG5_FIFO_EN 0x40
+#define CTRL_REG5_LIR_INT1 0x08
+#define CTRL_REG5_LIR_INT2 0x02
+#define CTRL_REG6_I2_CLICK 0x80
+#define CTRL_REG6_I2_IA1 0x40
+#define CTRL_REG6_I2_IA2 0x20
+#define CTRL_REG6_INT_POLARITY 0x02
+
+#define INT_CFG_AOI 0x80
+#define INT_CFG_6D 0x40
+#define INT_CFG_EVENTS 0x3F
+#define INT_SRC_IA 0x40
+
+#define CLICK_SRC_IA 0x40
+#define CLICK_SRC_DCLICK 0x20
+#define CLICK_SRC_SCLICK 0x10
+#define CLICK_SRC_SIGN 0x08
+#define CLICK_THS_LIR 0x80
+
+#define FIFO_MODE_MASK 0xC0
+#define FIFO_MODE_BYPASS 0x00
+#define FIFO_MODE_FIFO 0x40
+#define FIFO_FTH_MASK 0x1F
+
+#define FIFO_SRC_WTM 0x80
+#define FIFO_SRC_OVRN 0x40
+#define FIFO_SRC_EMPTY 0x20
+
+#define STATUS_ZYXDA 0x0F
+#define STATUS_ZYXOR 0xF0
+
+// Longest the alarm sleeps between checks, so config changes and reports are never far behind
+#define MAX_TICK_US 10000
+
+// Sensitivity in mg/digit, indexed by [mode][full scale] (datasheet table 4)
+static const float sensitivityTable[3][4] = {
+    {16, 32, 64, 192}, // Low-power (8-bit)
+    {4, 8, 16, 48},    // Normal (10-bit)
+    {1, 2, 4, 12},     // High-resolution (12-bit)
+};
+static const int bitsTable[3] = {8, 10, 12};
+
+// Threshold register LSB in mg, indexed by full scale (datasheet table 85)
+static const float thresholdLsbTable[4] = {16, 32, 62, 186};
+
+// Weight of each new sample in the running average removed by the click high-pass filter
+#define CLICK_HP_WEIGHT (1.0f / 16)
+
+// ODR field of CTRL_REG1 in Hz, for normal/high-resolution and low-power modes (datasheet table 31)
+static const uint32_t dataRateTable[2][16] = {
+    {0, 1, 10, 25, 50, 100, 200, 400, 0, 1344},
+    {0, 1, 10, 25, 50, 100, 200, 400, 1600, 5376},
+};
+
+static uint64_t now_us()
+{
+    return to_us_since_boot(get_absolute_time());
+}
+
+LIS3DHSim::LIS3DHSim()
+    : address(0), autoIncrement(false), bus(nullptr), busAddress(0), int1Pin(0), int2Pin(-1), int1Level(false),
+      int2Level(false), alarm(0), scheduleStartUs(0), scheduleIndex(0), odrHz(0), fifoHead(0), fifoCount(0), output(),
+      outputUnread(false), outputOverrun(false), generators(), click(), constant{0, 0, 1000}, waveform(nullptr),
+      waveformContext(nullptr), traceIndex(0), reportIntervalUs(0), nextReportUs(0), stats()
+{
+    memset(registers, 0, sizeof(registers));
+    registers[REG_WHO_AM_I] = WHO_AM_I_VALUE;
+    registers[REG_CTRL_REG0] = 0x10;
+    registers[REG_CTRL_REG1] = 0x07; // Power down, all axes enabled
+    createdUs = now_us();
+}
+
+LIS3DHSim::~LIS3DHSim()
+{
+    detach();
+}
+
+void LIS3DHSim::attach(i2c_inst_t* i2c, uint8_t address, unsigned int int1Pin, int int2Pin)
+{
+    detach();
+    std::lock_guard<std::recursive_mutex> guard(mutex);
+    bus = i2c;
+    busAddress = address;
+    this->int1Pin = int1Pin;
+    this->int2Pin = int2Pin;
+    restartSchedule(now_us());
+    mock_i2c_attach_device(i2c, address, i2cWrite, i2cRead, this);
+    alarm = add_alarm_in_us(MAX_TICK_US, tick, this, true);
+}
+
+void LIS3DHSim::detach()
+{
+    std::lock_guard<std::recursive_mutex> guard(mutex);
+    if (alarm > 0) {
+        cancel_alarm(alarm);
+        alarm = 0;
+    }
+    if (bus) {
+        mock_i2c_detach_device(bus, busAddress);
+        bus = nullptr;
+    }
+}
+
+void LIS3DHSim::setConstant(float x_mg, float y_mg, float z_mg)
+{
+    std::lock_guard<std::recursive_mutex> guard(mutex);
+    constant[0] = x_mg;
+    constant[1] = y_mg;
+    constant[2] = z_mg;
+    waveform = nullptr;
+    trace.clear();
+}
+
+void LIS3DHSim::setWaveform(LIS3DHWaveform waveform, void* context)
+{
+    std::lock_guard<std::recursive_mutex> guard(mutex);
+    this->waveform = waveform;
+    waveformContext = context;
+    trace.clear();
+}
+
+void LIS3DHSim::setTrace(const std::vector<float>& xyz_mg)
+{
+    std::lock_guard<std::recursive_mutex> guard(mutex);
+    trace.assign(xyz_mg.begin(), xyz_mg.begin() + (xyz_mg.size() / 3) * 3);
+    traceIndex = 0;
+}
+
+bool LIS3DHSim::loadTrace(const char* path)
+{
+    FILE* file = fopen(path, "r");
+    if (!file) {
+        return false;
+    }
+
+    std::vector<float> samples;
+    char line[256];
+    while (fgets(line, sizeof(line), file)) {
+        float values[4];
+        int count = sscanf(line, "%f,%f,%f,%f", &values[0], &values[1], &values[2], &values[3]);
+        if (count == 3 || count == 4) {
+            const float* xyz = values + (count - 3);
+            samples.insert(samples.end(), xyz, xyz + 3);
+        }
+    }
+    fclose(file);
+
+    if (samples.empty()) {
+        return false;
+    }
+    setTrace(samples);
+    return true;
+}
+
+void LIS3DHSim::injectSamples(size_t count)
+{
+    PinUpdate pins;
+    {
+        std::lock_guard<std::recursive_mutex> guard(mutex);
+        uint64_t now = now_us();
+        catchUp(now);
+        for (size_t i = 0; i < count; ++i) {
+            produce(now);
+        }
+        pins = updateInterrupts();
+    }
+    drivePins(pins);
+}
+
+void LIS3DHSim::setReportInterval(uint64_t interval_us)
+{
+    std::lock_guard<std::recursive_mutex> guard(mutex);
+    reportIntervalUs = interval_us;
+    nextReportUs = now_us() + interval_us;
+}
+
+LIS3DHSimStats LIS3DHSim::getStats()
+{
+    std::lock_guard<std::recursive_mutex> guard(mutex);
+    catchUp(now_us());
+    return stats;
+}
+
+void LIS3DHSim::resetStats()
+{
+    std::lock_guard<std::recursive_mutex> guard(mutex);
+    stats = LIS3DHSimStats();
+}
+
+void LIS3DHSim::printStats()
+{
+    LIS3DHSimStats snapshot = getStats();
+    printf("Debug: LIS3DH sim at %u Hz: %llu generated, %llu read, %llu dropped, latency avg %llu us, max %llu us\n",
+           odrHz, (unsigned long long)snapshot.samplesGenerated, (unsigned long long)snapshot.samplesRead,
+           (unsigned long long)snapshot.samplesDropped,
+           (unsigned long long)(snapshot.samplesRead ? snapshot.totalLatencyUs / snapshot.samplesRead : 0),
+           (unsigned long long)snapshot.maxLatencyUs);
+}
+
+uint8_t LIS3DHSim::readRegister(uint8_t reg)
+{
+    std::lock_guard<std::recursive_mutex> guard(mutex);
+    catchUp(now_us());
+    return registerValue(reg & 0x3F);
+}
+
+// --- I2C transfers
+
+int LIS3DHSim::i2cWrite(void* context, const uint8_t* src, size_t len, bool nostop)
+{
+    return static_cast<LIS3DHSim*>(context)->write(src, len);
+}
+
+int LIS3DHSim::i2cRead(void* context, uint8_t* dst, size_t len, bool nostop)
+{
+    return static_cast<LIS3DHSim*>(context)->read(dst, len);
+}
+
+// The first byte written is the sub-address, with the MSB requesting auto-increment. Any further bytes are written to
+// consecutive registers.
+int LIS3DHSim::write(const uint8_t* src, size_t len)
+{
+    PinUpdate pins;
+    {
+        std::lock_guard<std::recursive_mutex> guard(mutex);
+        uint64_t now = now_us();
+        catchUp(now);
+        stats.transactions++;
+
+        if (len > 0) {
+            address = src[0] & 0x7F;
+            autoIncrement = (src[0] & SUB_AUTO_INCREMENT) != 0;
+        }
+        for (size_t i = 1; i < len; ++i) {
+            writeRegister(address, src[i], now);
+            if (autoIncrement) {
+                address = (address + 1) & 0x7F;
+            }
+        }
+        pins = updateInterrupts();
+    }
+    drivePins(pins);
+    return (int)len;
+}
+
+int LIS3DHSim::read(uint8_t* dst, size_t len)
+{
+    PinUpdate pins;
+    {
+        std::lock_guard<std::recursive_mutex> guard(mutex);
+        uint64_t now = now_us();
+        catchUp(now);
+        stats.transactions++;
+
+        for (size_t i = 0; i < len; ++i) {
+            dst[i] = readAndAdvance(now);
+        }
+        pins = updateInterrupts();
+    }
+    drivePins(pins);
+    return (int)len;
+}
+
+uint8_t LIS3DHSim::registerValue(uint8_t reg)
+{
+    if (reg >= REG_OUT_X_L && reg <= REG_OUT_Z_H) {
+        const Sample& sample = currentOutput();
+        int16_t value = (reg < REG_OUT_X_L + 2) ? sample.x : (reg < REG_OUT_X_L + 4) ? sample.y : sample.z;
+        return (reg & 1) ? (uint8_t)((uint16_t)value >> 8) : (uint8_t)(value & 0xFF);
+    }
+    switch (reg) {
+        case REG_STATUS:
+            return statusRegister();
+        case REG_FIFO_SRC:
+            return fifoSource();
+        case REG_INT1_SRC:
+            return generators[0].source;
+        case REG_INT2_SRC:
+            return generators[1].source;
+        case REG_CLICK_SRC:
+            return click.source;
+        default:
+            return reg < sizeof(registers) ? registers[reg] : 0;
+    }
+}
+
+uint8_t LIS3DHSim::readAndAdvance(uint64_t now)
+{
+    uint8_t reg = address;
+    uint8_t value = registerValue(reg);
+
+    // Reading OUT_Z_H completes a sample: pop it from the FIFO, or mark the output registers as read
+    if (reg == REG_OUT_Z_H) {
+        if (fifoActive()) {
+            if (fifoCount > 0) {
+                output = fifo[fifoHead];
+                fifoHead = (fifoHead + 1) % FIFO_DEPTH;
+                fifoCount--;
+                consume(output, now);
+            }
+        } else if (outputUnread) {
+            consume(output, now);
+            outputUnread = false;
+            outputOverrun = false;
+        }
+    }
+
+    // Reading an event source releases its latched interrupt
+    if (reg == REG_INT1_SRC || reg == REG_INT2_SRC) {
+        generators[reg == REG_INT2_SRC].source = 0;
+    } else if (reg == REG_CLICK_SRC) {
+        click.source = 0;
+    }
+
+    if (autoIncrement) {
+        // With the FIFO enabled the pointer wraps within the output registers so a single read can drain it
+        if (reg == REG_OUT_Z_H && fifoActive()) {
+            address = REG_OUT_X_L;
+        } else {
+            address = (reg + 1) & 0x7F;
+        }
+    }
+    return value;
+}
+
+void LIS3DHSim::writeRegister(uint8_t reg, uint8_t value, uint64_t now)
+{
+    // Read-only and reserved registers ignore writes
+    bool writable = (reg >= REG_CTRL_REG0 && reg <= 0x26) || reg == REG_FIFO_CTRL ||
+                    (reg >= 0x30 && reg <= 0x3F && reg != REG_INT1_SRC && reg != REG_INT2_SRC &&
+                     reg != REG_CLICK_SRC);
+    if (!writable) {
+        return;
+    }
+
+    uint8_t previous = registers[reg];
+    registers[reg] = value;
+
+    switch (reg) {
+        case REG_CTRL_REG1:
+            // Samples so far were produced at the old rate, later ones at the new rate
+            if (dataRateHz() != odrHz) {
+                restartSchedule(now);
+            }
+            break;
+        case REG_CTRL_REG5:
+            if ((previous & CTRL_REG5_FIFO_EN) && !(value & CTRL_REG5_FIFO_EN)) {
+                clearFifo();
+            }
+            break;
+        case REG_FIFO_CTRL:
+            // Bypass mode empties the FIFO
+            if ((value & FIFO_MODE_MASK) == FIFO_MODE_BYPASS) {
+                clearFifo();
+            }
+            break;
+    }
+}
+
+// --- Sample production
+
+int64_t LIS3DHSim::tick(alarm_id_t id, void* user_data)
+{
+    LIS3DHSim* sim = static_cast<LIS3DHSim*>(user_data);
+    uint64_t delay;
+    PinUpdate pins;
+    bool report = false;
+    {
+        std::lock_guard<std::recursive_mutex> guard(sim->mutex);
+        uint64_t now = now_us();
+        delay = sim->catchUp(now);
+        pins = sim->updateInterrupts();
+        if (sim->reportIntervalUs && now >= sim->nextReportUs) {
+            sim->nextReportUs = now + sim->reportIntervalUs;
+            report = true;
+        }
+    }
+    sim->drivePins(pins);
+    if (report) {
+        sim->printStats();
+    }
+    return (int64_t)delay;
+}
+
+uint64_t LIS3DHSim::catchUp(uint64_t now)
+{
+    if (odrHz == 0) {
+        return MAX_TICK_US;
+    }
+
+    for (;;) {
+        uint64_t due = scheduleStartUs + (scheduleIndex + 1) * 1000000 / odrHz;
+        if (due > now) {
+            break;
+        }
+        produce(due);
+        scheduleIndex++;
+    }
+
+    // Sleep until INT1 could next change. Without the data-ready interrupt, INT1 only changes when the FIFO reaches
+    // the watermark or fills, so there is no need to wake for every sample.
+    // The event engines can change it on any sample.
+    uint64_t ahead = 1;
+    uint8_t ctrl3 = registers[REG_CTRL_REG3];
+    bool engines = registers[REG_CLICK_CFG] || registers[REG_INT1_CFG] || registers[REG_INT1_CFG + GEN_STRIDE];
+    if (fifoActive() && !(ctrl3 & CTRL_REG3_I1_DRDY1) && !engines) {
+        size_t threshold = registers[REG_FIFO_CTRL] & FIFO_FTH_MASK;
+        if ((ctrl3 & CTRL_REG3_I1_WTM) && fifoCount < threshold) {
+            ahead = threshold - fifoCount;
+        } else if (fifoCount < FIFO_DEPTH) {
+            ahead = FIFO_DEPTH - fifoCount;
+        }
+    }
+    uint64_t next = scheduleStartUs + (scheduleIndex + ahead) * 1000000 / odrHz;
+    uint64_t delay = next > now ? next - now : 1;
+    return delay < MAX_TICK_US ? delay : MAX_TICK_US;
+}
+
+void LIS3DHSim::produce(uint64_t now)
+{
+    Sample sample = makeSample(now);
+    stats.samplesGenerated++;
+    detectEvents(sample);
+
+    if (!fifoActive()) {
+        if (outputUnread) {
+            stats.samplesDropped++;
+            outputOverrun = true;
+        }
+        output = sample;
+        outputUnread = true;
+        return;
+    }
+
+    if (fifoCount == FIFO_DEPTH) {
+        stats.samplesDropped++;
+        if ((registers[REG_FIFO_CTRL] & FIFO_MODE_MASK) == FIFO_MODE_FIFO) {
+            return; // FIFO mode stops collecting when full
+        }
+        // Stream modes discard the oldest sample
+        fifoHead = (fifoHead + 1) % FIFO_DEPTH;
+        fifoCount--;
+    }
+    fifo[(fifoHead + fifoCount) % FIFO_DEPTH] = sample;
+    fifoCount++;
+}
+
+LIS3DHSim::Sample LIS3DHSim::makeSample(uint64_t now)
+{
+    float mg[3];
+    if (!trace.empty()) {
+        memcpy(mg, &trace[traceIndex * 3], sizeof(mg));
+        traceIndex = (traceIndex + 1) % (trace.size() / 3);
+    } else if (waveform) {
+        waveform((now - createdUs) * 1e-6, mg, waveformContext);
+    } else {
+        memcpy(mg, constant, sizeof(mg));
+    }
+
+    // Quantise to the current mode and range, then left-justify as the output registers do
+    int mode = operatingMode();
+    int range = (registers[REG_CTRL_REG4] >> 4) & 0x03;
+    float sensitivity = sensitivityTable[mode][range];
+    int bits = bitsTable[mode];
+    long maxCount = (1L << (bits - 1)) - 1;
+
+    int16_t axes[3];
+    for (int i = 0; i < 3; ++i) {
+        long counts = lroundf(mg[i] / sensitivity);
+        if (counts > maxCount) counts = maxCount;
+        if (counts < -maxCount - 1) counts = -maxCount - 1;
+        // Disabled axes read as zero
+        if (!(registers[REG_CTRL_REG1] & (1 << i))) counts = 0;
+        axes[i] = (int16_t)(counts * (1L << (16 - bits)));
+    }
+
+    return {axes[0], axes[1], axes[2], now};
+}
+
+// Index into the mode tables: low-power, normal or high-resolution
+int LIS3DHSim::operatingMode() const
+{
+    return (registers[REG_CTRL_REG1] & CTRL_REG1_LPEN) ? 0 : (registers[REG_CTRL_REG4] & CTRL_REG4_HR) ? 2 : 1;
+}
+
+void LIS3DHSim::restartSchedule(uint64_t now)
+{
+    scheduleStartUs = now;
+    scheduleIndex = 0;
+    odrHz = dataRateHz();
+}
+
+uint32_t LIS3DHSim::dataRateHz() const
+{
+    uint8_t ctrl1 = registers[REG_CTRL_REG1];
+    return dataRateTable[(ctrl1 & CTRL_REG1_LPEN) ? 1 : 0][ctrl1 >> 4];
+}
+
+// --- FIFO and status
+
+bool LIS3DHSim::fifoActive() const
+{
+    return (registers[REG_CTRL_REG5] & CTRL_REG5_FIFO_EN) &&
+           (registers[REG_FIFO_CTRL] & FIFO_MODE_MASK) != FIFO_MODE_BYPASS;
+}
+
+void LIS3DHSim::clearFifo()
+{
+    stats.samplesDropped += fifoCount;
+    fifoHead = 0;
+    fifoCount = 0;
+}
+
+uint8_t LIS3DHSim::fifoSource() const
+{
+    if (!fifoActive()) {
+        return FIFO_SRC_EMPTY;
+    }
+
+    // FSS only has five bits, so a full FIFO reads 31 with OVRN set
+    size_t threshold = registers[REG_FIFO_CTRL] & FIFO_FTH_MASK;
+    uint8_t value = (uint8_t)(fifoCount < FIFO_DEPTH ? fifoCount : FIFO_DEPTH - 1);
+    if (fifoCount >= threshold) value |= FIFO_SRC_WTM;
+    if (fifoCount == FIFO_DEPTH) value |= FIFO_SRC_OVRN;
+    if (fifoCount == 0) value |= FIFO_SRC_EMPTY;
+    return value;
+}
+
+uint8_t LIS3DHSim::statusRegister() const
+{
+    if (fifoActive()) {
+        return (fifoCount > 0 ? STATUS_ZYXDA : 0) | (fifoCount == FIFO_DEPTH ? STATUS_ZYXOR : 0);
+    }
+    return (outputUnread ? STATUS_ZYXDA : 0) | (outputOverrun ? STATUS_ZYXOR : 0);
+}
+
+const LIS3DHSim::Sample& LIS3DHSim::currentOutput() const
+{
+    return (fifoActive() && fifoCount > 0) ? fifo[fifoHead] : output;
+}
+
+void LIS3DHSim::consume(const Sample& sample, uint64_t now)
+{
+    uint64_t latency = now > sample.createdUs ? now - sample.createdUs : 0;
+    stats.samplesRead++;
+    stats.totalLatencyUs += latency;
+    if (latency > stats.maxLatencyUs) {
+        stats.maxLatencyUs = latency;
+    }
+}
+
+// --- Embedded engines
+
+void LIS3DHSim::detectEvents(const Sample& sample)
+{
+    // The engines work on the same data as the output registers
+    int mode = operatingMode();
+    int range = (registers[REG_CTRL_REG4] >> 4) & 0x03;
+    float scale = sensitivityTable[mode][range] / (float)(1 << (16 - bitsTable[mode]));
+    float mg[3] = {sample.x * scale, sample.y * scale, sample.z * scale};
+
+    updateGenerator(0, mg);
+    updateGenerator(1, mg);
+    updateClick(mg);
+}
+
+float LIS3DHSim::thresholdMg(uint8_t reg) const
+{
+    return (registers[reg] & 0x7F) * thresholdLsbTable[(registers[REG_CTRL_REG4] >> 4) & 0x03];
+}
+
+void LIS3DHSim::updateGenerator(int index, const float mg[3])
+{
+    Generator& generator = generators[index];
+    uint8_t base = REG_INT1_CFG + index * GEN_STRIDE;
+    uint8_t cfg = registers[base];
+    bool latched = registers[REG_CTRL_REG5] & (index == 0 ? CTRL_REG5_LIR_INT1 : CTRL_REG5_LIR_INT2);
+    uint8_t enabled = cfg & INT_CFG_EVENTS;
+    bool sixD = cfg & INT_CFG_6D;
+
+    // An unlatched source follows the latest sample
+    if (!latched) {
+        generator.source = 0;
+    }
+    if (!enabled) {
+        generator.run = 0;
+        return;
+    }
+
+    // Per axis, a high and a low flag (X in the lowest bits). Normally they compare the size of the acceleration with
+    // the threshold; in 6D mode they mark the axis beyond +threshold or -threshold.
+    float threshold = thresholdMg(base + GEN_THS);
+    uint8_t flags = 0;
+    for (int axis = 0; axis < 3; ++axis) {
+        bool high = sixD ? mg[axis] > threshold : fabsf(mg[axis]) > threshold;
+        bool low = sixD ? mg[axis] < -threshold : fabsf(mg[axis]) < threshold;
+        flags |= (high ? 2 : 0) << (2 * axis);
+        flags |= (low ? 1 : 0) << (2 * axis);
+    }
+    flags &= enabled;
+
+    bool condition;
+    if (sixD) {
+        // A known position has exactly one axis beyond the threshold. Position mode holds while it lasts, movement
+        // mode fires once on entering a new one.
+        bool known = flags != 0 && (flags & (flags - 1)) == 0;
+        condition = (cfg & INT_CFG_AOI) ? known : known && flags != generator.position;
+    } else {
+        condition = (cfg & INT_CFG_AOI) ? flags == enabled : flags != 0;
+    }
+
+    generator.run = condition ? generator.run + 1 : 0;
+    bool fired = generator.run > registers[base + GEN_DURATION];
+    if (fired && sixD) {
+        generator.position = flags;
+    }
+
+    // A latched event is kept until the source is read
+    if (!(generator.source & INT_SRC_IA)) {
+        generator.source = (fired ? INT_SRC_IA : 0) | flags;
+    }
+}
+
+void LIS3DHSim::updateClick(const float mg[3])
+{
+    uint8_t cfg = registers[REG_CLICK_CFG];
+    if (!(registers[REG_CLICK_THS] & CLICK_THS_LIR)) {
+        click.source = 0;
+    }
+
+    // High-pass filter, so that gravity doesn't count towards the threshold
+    float value[3];
+    for (int axis = 0; axis < 3; ++axis) {
+        value[axis] = mg[axis];
+        if (registers[REG_CTRL_REG2] & CTRL_REG2_HPCLICK) {
+            value[axis] -= click.baseline[axis];
+        }
+        click.baseline[axis] += (mg[axis] - click.baseline[axis]) * CLICK_HP_WEIGHT;
+    }
+
+    if (!cfg) {
+        click.phase = ClickPhase::IDLE;
+        return;
+    }
+
+    // The enabled axis furthest above the threshold, if any
+    float threshold = thresholdMg(REG_CLICK_THS);
+    int axis = -1;
+    float peak = threshold;
+    for (int a = 0; a < 3; ++a) {
+        if ((cfg & (0x03 << (2 * a))) && fabsf(value[a]) > peak) {
+            axis = a;
+            peak = fabsf(value[a]);
+        }
+    }
+    bool above = axis >= 0;
+
+    uint32_t limit = registers[REG_TIME_LIMIT] & 0x7F;
+    switch (click.phase) {
+        case ClickPhase::IDLE:
+            if (above) {
+                click.phase = ClickPhase::FIRST;
+                click.count = 1;
+                click.axis = (uint8_t)axis;
+                click.negative = value[axis] < 0;
+            }
+            break;
+        case ClickPhase::FIRST:
+            if (above) {
+                if (++click.count > limit) {
+                    click.phase = ClickPhase::WAIT_RELEASE; // Too long to be a click
+                }
+                break;
+            }
+            if (cfg & (0x01 << (2 * click.axis))) {
+                reportClick(CLICK_SRC_SCLICK);
+            }
+            click.phase = (cfg & (0x02 << (2 * click.axis))) ? ClickPhase::LATENCY : ClickPhase::IDLE;
+            click.count = 0;
+            break;
+        case ClickPhase::LATENCY:
+            if (++click.count >= registers[REG_TIME_LATENCY]) {
+                click.phase = ClickPhase::WINDOW;
+                click.count = 0;
+            }
+            break;
+        case ClickPhase::WINDOW:
+            if (above) {
+                click.phase = ClickPhase::SECOND;
+                click.count = 1;
+            } else if (++click.count >= registers[REG_TIME_WINDOW]) {
+                click.phase = ClickPhase::IDLE;
+            }
+            break;
+        case ClickPhase::SECOND:
+            if (above) {
+                if (++click.count > limit) {
+                    click.phase = ClickPhase::WAIT_RELEASE;
+                }
+                break;
+            }
+            reportClick(CLICK_SRC_DCLICK);
+            click.phase = ClickPhase::IDLE;
+            break;
+        case ClickPhase::WAIT_RELEASE:
+            if (!above) {
+                click.phase = ClickPhase::IDLE;
+            }
+            break;
+    }
+}
+
+void LIS3DHSim::reportClick(uint8_t kind)
+{
+    // A double click arriving before the single click was read shows both
+    click.source |= CLICK_SRC_IA | kind | (click.negative ? CLICK_SRC_SIGN : 0) | (1 << click.axis);
+}
+
+// --- INT1 and INT2
+
+LIS3DHSim::PinUpdate LIS3DHSim::updateInterrupts()
+{
+    uint8_t ctrl3 = registers[REG_CTRL_REG3];
+    uint8_t ctrl6 = registers[REG_CTRL_REG6];
+    bool active;
+    if (fifoActive()) {
+        size_t threshold = registers[REG_FIFO_CTRL] & FIFO_FTH_MASK;
+        active = ((ctrl3 & CTRL_REG3_I1_DRDY1) && fifoCount > 0) ||
+                 ((ctrl3 & CTRL_REG3_I1_WTM) && fifoCount >= threshold) ||
+                 ((ctrl3 & CTRL_REG3_I1_OVERRUN) && fifoCount == FIFO_DEPTH);
+    } else {
+        active = (ctrl3 & CTRL_REG3_I1_DRDY1) && outputUnread;
+    }
+
+    bool clickActive = click.source & CLICK_SRC_IA;
+    bool ia1 = generators[0].source & INT_SRC_IA;
+    bool ia2 = generators[1].source & INT_SRC_IA;
+    active = active || ((ctrl3 & CTRL_REG3_I1_CLICK) && clickActive) || ((ctrl3 & CTRL_REG3_I1_IA1) && ia1) ||
+             ((ctrl3 & CTRL_REG3_I1_IA2) && ia2);
+    bool active2 = ((ctrl6 & CTRL_REG6_I2_CLICK) && clickActive) || ((ctrl6 & CTRL_REG6_I2_IA1) && ia1) ||
+                   ((ctrl6 & CTRL_REG6_I2_IA2) && ia2);
+
+    // The polarity setting applies to both pins
+    bool inverted = ctrl6 & CTRL_REG6_INT_POLARITY;
+    PinUpdate update;
+    update.int1Level = inverted ? !active : active;
+    update.int2Level = inverted ? !active2 : active2;
+    update.int1Changed = update.int1Level != int1Level;
+    update.int2Changed = update.int2Level != int2Level;
+    int1Level = update.int1Level;
+    int2Level = update.int2Level;
+    return update;
+}
+
+void LIS3DHSim::drivePins(const PinUpdate& update)
+{
+    if (!bus) {
+        return;
+    }
+    if (update.int1Changed) {
+        mock_gpio_set_input(int1Pin, update.int1Level);
+    }
+    if (update.int2Changed && int2Pin >= 0) {
+        mock_gpio_set_input((unsigned int)int2Pin, update.int2Level);
+    }
+}
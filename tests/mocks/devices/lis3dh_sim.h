@@ -0,0 +1,188 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <mutex>
+#include <vector>
+#include "hardware/i2c.h"
+#include "pico/time.h"
+
+// Register-level model of the LIS3DH accelerometer, attached to the I2C mock.
+//
+// Modelled: WHO_AM_I, CTRL_REG1-6, STATUS_REG, OUT_X/Y/Z (left-justified, 8/10/12-bit by mode), FIFO_CTRL_REG,
+// FIFO_SRC_REG, the 32-sample FIFO in bypass, FIFO and stream modes, register auto-increment (wrapping from OUT_Z_H
+// to OUT_X_L while the FIFO is enabled), the INT1 DRDY/WTM/OVERRUN sources, and the embedded engines: both inertial
+// interrupt generators (OR/AND of high/low events, 6D movement and position), click (single and double, with time
+// limit, latency and window) and their latched sources. The engines and interrupt routing drive INT1 and INT2 onto
+// GPIOs. Samples are produced at the configured ODR in real time, so reads see exactly the data a real sensor would
+// have collected.
+// Not modelled: stream-to-FIFO triggers (it behaves as stream mode), the high-pass filter other than for clicks (where
+// it is approximated by subtracting a running average), the ADC and temperature sensor, and block data update.
+
+// Produces the acceleration in mg on each axis at a time (seconds since the simulator was created)
+typedef void (*LIS3DHWaveform)(double seconds, float mg[3], void* context);
+
+// Counters for load testing the acquisition path
+struct LIS3DHSimStats {
+    uint64_t samplesGenerated; // Samples produced at the ODR
+    uint64_t samplesRead;      // Samples the host read (popped from the FIFO, or read from the output registers)
+    uint64_t samplesDropped;   // Samples lost unread (FIFO overrun, or output registers overwritten)
+    uint64_t totalLatencyUs;   // Sum of the time from each sample being produced to it being read
+    uint64_t maxLatencyUs;     // Longest time from a sample being produced to it being read
+    uint64_t transactions;     // I2C transfers addressed to the device
+};
+
+class LIS3DHSim {
+    public:
+        static constexpr size_t FIFO_DEPTH = 32;
+
+        LIS3DHSim();
+        ~LIS3DHSim();
+
+        // attach() puts the device on the bus and drives its INT1 output onto the given GPIO, and INT2 if int2Pin is
+        // not -1
+        void attach(i2c_inst_t* i2c, uint8_t address, unsigned int int1Pin, int int2Pin = -1);
+
+        // detach() removes the device from the bus and stops producing samples
+        void detach();
+
+        // setConstant() produces the same acceleration on every sample (the default is 1g on Z, lying flat)
+        void setConstant(float x_mg, float y_mg, float z_mg);
+
+        // setWaveform() produces each sample from a function of time
+        void setWaveform(LIS3DHWaveform waveform, void* context);
+
+        // setTrace() replays recorded samples (mg), one per sample at the configured ODR, looping at the end
+        void setTrace(const std::vector<float>& xyz_mg);
+
+        // loadTrace() reads a CSV trace with rows of "x,y,z" or "time,x,y,z" in mg (the time column is ignored and
+        // non-numeric rows such as headers are skipped). Returns false if the file can't be read or has no samples.
+        bool loadTrace(const char* path);
+
+        // injectSamples() produces samples immediately, regardless of the ODR (e.g. to fill the FIFO in a benchmark)
+        void injectSamples(size_t count);
+
+        // setReportInterval() prints the statistics every interval_us (0 to stop)
+        void setReportInterval(uint64_t interval_us);
+
+        // getStats() returns a snapshot of the counters, and resetStats() clears them
+        LIS3DHSimStats getStats();
+        void resetStats();
+
+        // printStats() prints the counters to stdout
+        void printStats();
+
+        // readRegister() peeks at a register without any read side effects
+        uint8_t readRegister(uint8_t reg);
+
+    private:
+        struct Sample {
+            int16_t x, y, z;    // Left-justified output register values
+            uint64_t createdUs; // When the sample was produced, for latency
+        };
+
+        // An inertial interrupt generator (INT1_CFG/SRC/THS/DURATION or the INT2_* set)
+        struct Generator {
+            uint8_t source;   // INTx_SRC
+            uint32_t run;     // Consecutive samples the condition has held
+            uint8_t position; // Last 6D position reported, in INTx_SRC flags
+        };
+
+        // Click detection: an axis rises above the threshold and falls back within the time limit. A double click is
+        // a second one starting in the window that follows the latency.
+        enum class ClickPhase : uint8_t { IDLE, FIRST, LATENCY, WINDOW, SECOND, WAIT_RELEASE };
+        struct Click {
+            ClickPhase phase;
+            uint32_t count;     // Samples spent in the phase
+            uint8_t axis;       // Axis and direction of the click in progress
+            bool negative;
+            uint8_t source;     // CLICK_SRC
+            float baseline[3];  // Running average removed by the high-pass filter
+        };
+
+        // Interrupt pin changes, driven once the lock is released
+        struct PinUpdate {
+            bool int1Changed, int2Changed;
+            bool int1Level, int2Level;
+        };
+
+        std::recursive_mutex mutex;
+        uint8_t registers[0x40];
+        uint8_t address;       // Register pointer for the next transfer
+        bool autoIncrement;
+
+        i2c_inst_t* bus;
+        uint8_t busAddress;
+        unsigned int int1Pin;
+        int int2Pin;
+        bool int1Level;
+        bool int2Level;
+        alarm_id_t alarm;
+
+        // Sample schedule: sample n of the current ODR is due at scheduleStartUs + n * 1e6 / odrHz
+        uint64_t createdUs;
+        uint64_t scheduleStartUs;
+        uint64_t scheduleIndex;
+        uint32_t odrHz;
+
+        Sample fifo[FIFO_DEPTH];
+        size_t fifoHead;
+        size_t fifoCount;
+        Sample output;          // Sample shown in the output registers outside FIFO mode
+        bool outputUnread;      // STATUS_REG ZYXDA
+        bool outputOverrun;     // STATUS_REG ZYXOR
+
+        Generator generators[2];
+        Click click;
+
+        float constant[3];
+        LIS3DHWaveform waveform;
+        void* waveformContext;
+        std::vector<float> trace;
+        size_t traceIndex;
+
+        uint64_t reportIntervalUs;
+        uint64_t nextReportUs;
+
+        LIS3DHSimStats stats;
+
+        // I2C mock entry points
+        static int i2cWrite(void* context, const uint8_t* src, size_t len, bool nostop);
+        static int i2cRead(void* context, uint8_t* dst, size_t len, bool nostop);
+
+        // Alarm handler that keeps producing samples and driving INT1 while the host sleeps
+        static int64_t tick(alarm_id_t id, void* user_data);
+
+        int write(const uint8_t* src, size_t len);
+        int read(uint8_t* dst, size_t len);
+        uint8_t registerValue(uint8_t reg);
+        uint8_t readAndAdvance(uint64_t now);
+        void writeRegister(uint8_t reg, uint8_t value, uint64_t now);
+
+        // catchUp() produces every sample due by now. Returns the delay until INT1 next needs checking.
+        uint64_t catchUp(uint64_t now);
+        void produce(uint64_t now);
+        Sample makeSample(uint64_t now);
+        int operatingMode() const;
+        void restartSchedule(uint64_t now);
+        uint32_t dataRateHz() const;
+
+        bool fifoActive() const;
+        void clearFifo();
+        uint8_t fifoSource() const;
+        uint8_t statusRegister() const;
+        const Sample& currentOutput() const;
+        void consume(const Sample& sample, uint64_t now);
+
+        // detectEvents() runs the embedded engines on a new sample
+        void detectEvents(const Sample& sample);
+        void updateGenerator(int index, const float mg[3]);
+        void updateClick(const float mg[3]);
+        void reportClick(uint8_t kind);
+        float thresholdMg(uint8_t reg) const;
+
+        // updateInterrupts() recalculates the INT1 and INT2 levels. The caller drives the GPIOs once the lock is
+        // released, as the GPIO mock calls straight into the firmware's interrupt handler.
+        PinUpdate updateInterrupts();
+        void drivePins(const PinUpdate& update);
+};
@@ -0,0 +1,212 @@
+#include <map>
+#include <string.h>
+#include <stdexcept>
+#include "hardware/dma.h"
+#include "pico/stdlib.h"
+
+#define NUM_DMA_CHANNELS 12
+
+// State for each mock DMA channel
+struct mock_dma_channel {
+    bool claimed;
+    dma_channel_config config;
+    volatile void* write_addr;
+    const volatile void* read_addr;
+    uint32_t transfer_count;
+    bool busy; // Started, and waiting for a read source to supply the rest of the transfer
+};
+static mock_dma_channel channels[NUM_DMA_CHANNELS];
+
+struct mock_dma_target {
+    mock_dma_write_fn write;
+    void* context;
+};
+
+// Function-local so that other mocks can register targets from their static initialisers
+static std::map<const volatile void*, mock_dma_target>& write_targets()
+{
+    static std::map<const volatile void*, mock_dma_target> targets;
+    return targets;
+}
+
+struct mock_dma_source {
+    mock_dma_read_fn read;
+    void* context;
+};
+
+static std::map<const volatile void*, mock_dma_source>& read_sources()
+{
+    static std::map<const volatile void*, mock_dma_source> sources;
+    return sources;
+}
+
+void mock_dma_register_write_target(volatile void* addr, mock_dma_write_fn write, void* context)
+{
+    write_targets()[addr] = { write, context };
+}
+
+void mock_dma_register_read_source(const volatile void* addr, mock_dma_read_fn read, void* context)
+{
+    read_sources()[addr] = { read, context };
+}
+
+// Perform as much of the transfer as possible immediately. The real hardware paces the transfer using the DREQ. Every
+// mock peripheral consumes data as soon as it is written, so only a read source that has run dry holds a transfer up.
+static void run_transfer(unsigned int channel)
+{
+    mock_dma_channel& ch = channels[channel];
+    size_t size = 1u << ch.config.size;
+    auto target = write_targets().find(ch.write_addr);
+    auto source = read_sources().find(ch.read_addr);
+
+    const volatile uint8_t* src = (const volatile uint8_t*)ch.read_addr;
+    volatile uint8_t* dst = (volatile uint8_t*)ch.write_addr;
+    ch.busy = true;
+    while (ch.transfer_count > 0) {
+        uint32_t value = 0;
+        if (source != read_sources().end()) {
+            if (!source->second.read(source->second.context, &value)) {
+                break; // Resumed by mock_dma_source_ready()
+            }
+        } else {
+            memcpy(&value, (const void*)src, size);
+        }
+        ch.transfer_count--;
+        if (target != write_targets().end()) {
+            target->second.write(target->second.context, value);
+        } else {
+            memcpy((void*)dst, &value, size);
+        }
+        if (ch.config.read_increment) src += size;
+        if (ch.config.write_increment) dst += size;
+    }
+    ch.read_addr = src;
+    ch.write_addr = dst;
+    ch.busy = ch.transfer_count > 0;
+}
+
+void mock_dma_source_ready(const volatile void* addr)
+{
+    for (unsigned int channel = 0; channel < NUM_DMA_CHANNELS; channel++) {
+        if (channels[channel].busy && channels[channel].read_addr == addr) {
+            run_transfer(channel);
+        }
+    }
+}
+
+int dma_claim_unused_channel(bool required)
+{
+    for (int i = 0; i < NUM_DMA_CHANNELS; i++) {
+        if (!channels[i].claimed) {
+            channels[i].claimed = true;
+            return i;
+        }
+    }
+    if (required) {
+        throw std::runtime_error("No DMA channels are available");
+    }
+    return -1;
+}
+
+void dma_channel_unclaim(unsigned int channel)
+{
+    channels[channel].claimed = false;
+}
+
+dma_channel_config dma_channel_get_default_config(unsigned int channel)
+{
+    // Matches the SDK defaults: 32-bit transfers, read increment on, write increment off, unpaced
+    return { DMA_SIZE_32, true, false, 0x3f };
+}
+
+void channel_config_set_transfer_data_size(dma_channel_config* c, enum dma_channel_transfer_size size)
+{
+    c->size = size;
+}
+
+void channel_config_set_read_increment(dma_channel_config* c, bool incr)
+{
+    c->read_increment = incr;
+}
+
+void channel_config_set_write_increment(dma_channel_config* c, bool incr)
+{
+    c->write_increment = incr;
+}
+
+void channel_config_set_dreq(dma_channel_config* c, unsigned int dreq)
+{
+    c->dreq = dreq;
+}
+
+void dma_channel_configure(unsigned int channel, const dma_channel_config* config, volatile void* write_addr,
+                           const volatile void* read_addr, unsigned int transfer_count, bool trigger)
+{
+    channels[channel].config = *config;
+    channels[channel].write_addr = write_addr;
+    channels[channel].read_addr = read_addr;
+    channels[channel].transfer_count = transfer_count;
+    if (trigger) {
+        run_transfer(channel);
+    }
+}
+
+void dma_channel_set_read_addr(unsigned int channel, const volatile void* read_addr, bool trigger)
+{
+    channels[channel].read_addr = read_addr;
+    if (trigger) {
+        run_transfer(channel);
+    }
+}
+
+void dma_channel_set_write_addr(unsigned int channel, volatile void* write_addr, bool trigger)
+{
+    channels[channel].write_addr = write_addr;
+    if (trigger) {
+        run_transfer(channel);
+    }
+}
+
+void dma_channel_set_trans_count(unsigned int channel, uint32_t trans_count, bool trigger)
+{
+    channels[channel].transfer_count = trans_count;
+    if (trigger) {
+        run_transfer(channel);
+    }
+}
+
+void dma_channel_transfer_from_buffer_now(unsigned int channel, const volatile void* read_addr, uint32_t transfer_count)
+{
+    channels[channel].read_addr = read_addr;
+    channels[channel].transfer_count = transfer_count;
+    run_transfer(channel);
+}
+
+void dma_start_channel_mask(uint32_t chan_mask)
+{
+    // The hardware runs the channels side by side; the mock runs them one after another
+    for (unsigned int channel = 0; channel < NUM_DMA_CHANNELS; channel++) {
+        if (chan_mask & (1u << channel)) {
+            run_transfer(channel);
+        }
+    }
+}
+
+bool dma_channel_is_busy(unsigned int channel)
+{
+    // Transfers complete synchronously in the mock, unless they are waiting on a read source
+    return channels[channel].busy;
+}
+
+void dma_channel_wait_for_finish_blocking(unsigned int channel)
+{
+    while (channels[channel].busy) {
+        tight_loop_contents();
+    }
+}
+
+void dma_channel_abort(unsigned int channel)
+{
+    channels[channel].transfer_count = 0;
+    channels[channel].busy = false;
+}
@@ -0,0 +1,48 @@
+#pragma once
+
+#include <stdint.h>
+
+// Types defined just so that we can replicate the real API
+enum dma_channel_transfer_size {
+    DMA_SIZE_8 = 0,
+    DMA_SIZE_16 = 1,
+    DMA_SIZE_32 = 2,
+};
+
+typedef struct {
+    enum dma_channel_transfer_size size;
+    bool read_increment;
+    bool write_increment;
+    unsigned int dreq;
+} dma_channel_config;
+
+// Functions defined to replicate the real API
+int dma_claim_unused_channel(bool required);
+void dma_channel_unclaim(unsigned int channel);
+dma_channel_config dma_channel_get_default_config(unsigned int channel);
+void channel_config_set_transfer_data_size(dma_channel_config* c, enum dma_channel_transfer_size size);
+void channel_config_set_read_increment(dma_channel_config* c, bool incr);
+void channel_config_set_write_increment(dma_channel_config* c, bool incr);
+void channel_config_set_dreq(dma_channel_config* c, unsigned int dreq);
+void dma_channel_configure(unsigned int channel, const dma_channel_config* config, volatile void* write_addr,
+                           const volatile void* read_addr, unsigned int transfer_count, bool trigger);
+void dma_channel_set_read_addr(unsigned int channel, const volatile void* read_addr, bool trigger);
+void dma_channel_set_write_addr(unsigned int channel, volatile void* write_addr, bool trigger);
+void dma_channel_set_trans_count(unsigned int channel, uint32_t trans_count, bool trigger);
+void dma_channel_transfer_from_buffer_now(unsigned int channel, const volatile void* read_addr, uint32_t transfer_count);
+void dma_start_channel_mask(uint32_t chan_mask);
+bool dma_channel_is_busy(unsigned int channel);
+void dma_channel_wait_for_finish_blocking(unsigned int channel);
+void dma_channel_abort(unsigned int channel);
+
+// Mock only: lets other mocks expose a peripheral register (e.g. a PIO TX FIFO) as a DMA write target. Each word the
+// DMA writes to `addr` is passed to `write` instead of being stored in memory.
+typedef void (*mock_dma_write_fn)(void* context, uint32_t data);
+void mock_dma_register_write_target(volatile void* addr, mock_dma_write_fn write, void* context);
+
+// Mock only: the other direction, e.g. a peripheral's receive register. Each word the DMA reads from `addr` comes from
+// `read`, which returns false if the peripheral has nothing yet. The channel then stays busy, as if waiting for its
+// DREQ, until the peripheral calls mock_dma_source_ready() with more data.
+typedef bool (*mock_dma_read_fn)(void* context, uint32_t* data);
+void mock_dma_register_read_source(const volatile void* addr, mock_dma_read_fn read, void* context);
+void mock_dma_source_ready(const volatile void* addr);
@@ -0,0 +1,180 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <mutex>
+#include <vector>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include "hardware/flash.h"
+
+static std::mutex mutex;
+static std::vector<uint8_t> memoryContents;
+static uint8_t* contents = nullptr;
+static bool mapped = false;
+
+#ifdef _WIN32
+static HANDLE fileHandle = INVALID_HANDLE_VALUE;
+static HANDLE mappingHandle = nullptr;
+#endif
+
+// --- Backing store
+
+// mapFile() maps the file at path, growing it to the size of the flash with erased bytes. Returns null on failure.
+static uint8_t* mapFile(const char* path)
+{
+#ifdef _WIN32
+    HANDLE file =
+        CreateFileA(path, GENERIC_READ | GENERIC_WRITE, 0, nullptr, OPEN_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (file == INVALID_HANDLE_VALUE) {
+        return nullptr;
+    }
+    LARGE_INTEGER size;
+    GetFileSizeEx(file, &size);
+    HANDLE mapping = CreateFileMappingA(file, nullptr, PAGE_READWRITE, 0, PICO_FLASH_SIZE_BYTES, nullptr);
+    uint8_t* view = mapping ? (uint8_t*)MapViewOfFile(mapping, FILE_MAP_ALL_ACCESS, 0, 0, PICO_FLASH_SIZE_BYTES)
+                            : nullptr;
+    if (!view) {
+        if (mapping) {
+            CloseHandle(mapping);
+        }
+        CloseHandle(file);
+        return nullptr;
+    }
+    fileHandle = file;
+    mappingHandle = mapping;
+    size_t existing = (size_t)size.QuadPart;
+#else
+    int fd = open(path, O_RDWR | O_CREAT, 0644);
+    if (fd < 0) {
+        return nullptr;
+    }
+    struct stat info;
+    if (fstat(fd, &info) != 0 ||
+        ((size_t)info.st_size < PICO_FLASH_SIZE_BYTES && ftruncate(fd, PICO_FLASH_SIZE_BYTES) != 0)) {
+        close(fd);
+        return nullptr;
+    }
+    void* view = mmap(nullptr, PICO_FLASH_SIZE_BYTES, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (view == MAP_FAILED) {
+        return nullptr;
+    }
+    size_t existing = (size_t)info.st_size;
+#endif
+
+    // A new file, or the part added to a short one, is zeros; make it erased flash
+    if (existing < PICO_FLASH_SIZE_BYTES) {
+        memset((uint8_t*)view + existing, 0xFF, PICO_FLASH_SIZE_BYTES - existing);
+    }
+    return (uint8_t*)view;
+}
+
+static void unmapFile()
+{
+#ifdef _WIN32
+    FlushViewOfFile(contents, 0);
+    UnmapViewOfFile(contents);
+    CloseHandle(mappingHandle);
+    CloseHandle(fileHandle);
+    mappingHandle = nullptr;
+    fileHandle = INVALID_HANDLE_VALUE;
+#else
+    msync(contents, PICO_FLASH_SIZE_BYTES, MS_SYNC);
+    munmap(contents, PICO_FLASH_SIZE_BYTES);
+#endif
+}
+
+static void useMemory()
+{
+    memoryContents.assign(PICO_FLASH_SIZE_BYTES, 0xFF);
+    contents = memoryContents.data();
+    mapped = false;
+}
+
+// flash() returns the contents, setting them up on first use. Call with the mutex held.
+static uint8_t* flash()
+{
+    if (!contents) {
+        const char* path = getenv("PICO_MOCK_FLASH_FILE");
+        if (path && (contents = mapFile(path))) {
+            mapped = true;
+        } else {
+            if (path) {
+                printf("Debug: Could not map %s as flash, using memory instead\n", path);
+            }
+            useMemory();
+        }
+    }
+    return contents;
+}
+
+uint8_t* mock_flash_contents()
+{
+    std::lock_guard<std::mutex> guard(mutex);
+    return flash();
+}
+
+bool mock_flash_open(const char* path)
+{
+    std::lock_guard<std::mutex> guard(mutex);
+    uint8_t* view = mapFile(path);
+    if (!view) {
+        return false;
+    }
+    if (mapped) {
+        unmapFile();
+    }
+    memoryContents.clear();
+    memoryContents.shrink_to_fit();
+    contents = view;
+    mapped = true;
+    return true;
+}
+
+void mock_flash_close()
+{
+    std::lock_guard<std::mutex> guard(mutex);
+    if (mapped) {
+        unmapFile();
+    }
+    useMemory();
+}
+
+// --- Erase and program
+
+void flash_range_erase(uint32_t flash_offs, size_t count)
+{
+    if (flash_offs % FLASH_SECTOR_SIZE != 0 || count % FLASH_SECTOR_SIZE != 0 ||
+        (size_t)flash_offs + count > PICO_FLASH_SIZE_BYTES) {
+        printf("Debug: flash_range_erase(0x%x, %zu) is not whole sectors within the flash\n", (unsigned)flash_offs,
+               count);
+        return;
+    }
+
+    std::lock_guard<std::mutex> guard(mutex);
+    memset(flash() + flash_offs, 0xFF, count);
+}
+
+void flash_range_program(uint32_t flash_offs, const uint8_t* data, size_t count)
+{
+    if (flash_offs % FLASH_PAGE_SIZE != 0 || count % FLASH_PAGE_SIZE != 0 ||
+        (size_t)flash_offs + count > PICO_FLASH_SIZE_BYTES) {
+        printf("Debug: flash_range_program(0x%x, %zu) is not whole pages within the flash\n", (unsigned)flash_offs,
+               count);
+        return;
+    }
+
+    std::lock_guard<std::mutex> guard(mutex);
+    uint8_t* out = flash() + flash_offs;
+    for (size_t i = 0; i < count; ++i) {
+        out[i] &= data[i];
+    }
+}
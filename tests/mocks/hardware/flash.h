@@ -0,0 +1,34 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+
+// Flash geometry (from hardware/flash.h) and the size of the Pico's flash (from the board header)
+#define FLASH_PAGE_SIZE (1u << 8)
+#define FLASH_SECTOR_SIZE (1u << 12)
+#define FLASH_BLOCK_SIZE (1u << 16)
+#ifndef PICO_FLASH_SIZE_BYTES
+#define PICO_FLASH_SIZE_BYTES (2 * 1024 * 1024)
+#endif
+
+// Flash is read through the XIP window, so the mock's contents stand in for it
+#define XIP_BASE ((uintptr_t)mock_flash_contents())
+
+// Functions defined to replicate the real API. As on the chip, erasing sets whole sectors to 0xFF and programming can
+// only clear bits, so programming over data that was not erased ANDs the two. Offsets and counts must be multiples of
+// the sector or page size; a call that breaks this, or runs past the end of the flash, is reported and ignored.
+// Erase and program times are not modelled.
+void flash_range_erase(uint32_t flash_offs, size_t count);
+void flash_range_program(uint32_t flash_offs, const uint8_t* data, size_t count);
+
+// Mock only: the PICO_FLASH_SIZE_BYTES of flash contents. These start erased and last until the program exits, unless
+// PICO_MOCK_FLASH_FILE names a file (or mock_flash_open() is called first), in which case the file is memory mapped
+// and keeps them between runs. The file is created erased if it doesn't exist.
+uint8_t* mock_flash_contents();
+
+// Mock only: back the flash with a memory-mapped file from now on, as for PICO_MOCK_FLASH_FILE. Returns false if the
+// file can't be opened or mapped, leaving the flash as it was.
+bool mock_flash_open(const char* path);
+
+// Mock only: flush and unmap the file, if there is one, and go back to an erased in-memory flash
+void mock_flash_close();
@@ -1,4 +1,21 @@
 #include <iostream>
+#include <atomic>
+#include "hardware/gpio.h"
+#include "hardware/sync.h"
+
+#define NUM_GPIOS 30
+
+// Pin levels and interrupt settings
+static std::atomic<bool> gpio_levels[NUM_GPIOS];
+static std::atomic<uint32_t> gpio_irq_events[NUM_GPIOS];
+static std::atomic<gpio_irq_callback_t> gpio_irq_callback;
+
+// Simulated devices watching the outputs
+struct mock_gpio_watch {
+    mock_gpio_output_fn watch;
+    void* context;
+};
+static mock_gpio_watch gpio_watches[NUM_GPIOS];
 
 void gpio_init(unsigned int gpio)
 {
@@ -14,4 +31,56 @@ void gpio_set_dir(unsigned int gpio, bool out)
 void gpio_put(unsigned int gpio, bool val)
 {
     printf("Debug: GPIO pin %u set to %i\n", gpio, val);
+    if (gpio_watches[gpio].watch) {
+        gpio_watches[gpio].watch(gpio_watches[gpio].context, gpio, val);
+    }
+}
+
+bool gpio_get(unsigned int gpio)
+{
+    return gpio_levels[gpio].load();
+}
+
+void gpio_set_function(unsigned int gpio, enum gpio_function fn)
+{
+    printf("Debug: GPIO pin %u set to function %i\n", gpio, (int)fn);
+}
+
+void gpio_set_irq_enabled_with_callback(unsigned int gpio, uint32_t event_mask, bool enabled, gpio_irq_callback_t callback)
+{
+    // Like the real SDK, there is one callback shared by every pin
+    gpio_irq_callback.store(callback);
+    if (enabled) {
+        gpio_irq_events[gpio] |= event_mask;
+    } else {
+        gpio_irq_events[gpio] &= ~event_mask;
+    }
+}
+
+void mock_gpio_set_input(unsigned int gpio, bool level)
+{
+    bool previous = gpio_levels[gpio].exchange(level);
+    uint32_t events = level ? GPIO_IRQ_LEVEL_HIGH : GPIO_IRQ_LEVEL_LOW;
+    if (level != previous) {
+        events |= level ? GPIO_IRQ_EDGE_RISE : GPIO_IRQ_EDGE_FALL;
+    }
+    events &= gpio_irq_events[gpio].load();
+    if (events) {
+        mock_gpio_fire_irq(gpio, events);
+    }
+}
+
+void mock_gpio_fire_irq(unsigned int gpio, uint32_t event_mask)
+{
+    gpio_irq_callback_t callback = gpio_irq_callback.load();
+    if (callback) {
+        callback(gpio, event_mask);
+    }
+    // Wake the core, as any interrupt would
+    mock_irq_signal();
+}
+
+void mock_gpio_watch_output(unsigned int gpio, mock_gpio_output_fn watch, void* context)
+{
+    gpio_watches[gpio] = {watch, context};
 }
@@ -1,8 +1,45 @@
 #pragma once 
 
+#include <stdint.h>
+
 // GPIO functionality
 #define GPIO_OUT 1
 #define GPIO_IN 0
 void gpio_init(unsigned int gpio);
 void gpio_set_dir(unsigned int gpio, bool out);
 void gpio_put(unsigned int gpio, bool val);
+bool gpio_get(unsigned int gpio);
+
+// Pin functions
+enum gpio_function {
+    GPIO_FUNC_SPI = 1,
+    GPIO_FUNC_UART = 2,
+    GPIO_FUNC_I2C = 3,
+    GPIO_FUNC_PWM = 4,
+    GPIO_FUNC_SIO = 5,
+    GPIO_FUNC_PIO0 = 6,
+    GPIO_FUNC_PIO1 = 7,
+};
+void gpio_set_function(unsigned int gpio, enum gpio_function fn);
+
+// Interrupts
+enum gpio_irq_level {
+    GPIO_IRQ_LEVEL_LOW = 0x1u,
+    GPIO_IRQ_LEVEL_HIGH = 0x2u,
+    GPIO_IRQ_EDGE_FALL = 0x4u,
+    GPIO_IRQ_EDGE_RISE = 0x8u,
+};
+typedef void (*gpio_irq_callback_t)(unsigned int gpio, uint32_t event_mask);
+void gpio_set_irq_enabled_with_callback(unsigned int gpio, uint32_t event_mask, bool enabled, gpio_irq_callback_t callback);
+
+// Mock only: drive an input pin from the test harness (e.g. a simulated interrupt line). Edges fire any enabled
+// interrupt, just like the real hardware.
+void mock_gpio_set_input(unsigned int gpio, bool level);
+
+// Mock only: fire the interrupt for a pin directly with the given events
+void mock_gpio_fire_irq(unsigned int gpio, uint32_t event_mask);
+
+// Mock only: call `watch` whenever the firmware drives an output pin (e.g. a simulated device reacting to a
+// bit-banged clock). One watch per pin; pass nullptr to remove it.
+typedef void (*mock_gpio_output_fn)(void* context, unsigned int gpio, bool level);
+void mock_gpio_watch_output(unsigned int gpio, mock_gpio_output_fn watch, void* context);
@@ -0,0 +1,278 @@
+#include <stdio.h>
+#include <map>
+#include <mutex>
+#include <deque>
+#include <vector>
+#include <utility>
+#include "hardware/i2c.h"
+#include "hardware/dma.h"
+#include "pico/stdlib.h"
+
+// Opaque in the SDK, so the mock keeps each bus's state here. Commands written to DATA_CMD are collected into
+// segments (a run of writes or reads) and passed to the device when a restart, change of direction or stop ends them.
+struct i2c_inst {
+    unsigned int baudrate;
+    i2c_hw_t hw;
+    std::vector<uint8_t> write_data; // Bytes of the write segment in progress
+    size_t read_length;              // Read commands in the read segment in progress
+    bool in_transfer;                // Commands have arrived since the last stop
+    bool aborted;                    // Discarding commands until the stop that ends the aborted transfer
+    std::deque<uint8_t> rx_fifo;     // Received bytes waiting to be read from DATA_CMD
+
+    // A device holding SDA low, see mock_i2c_hold_sda_low()
+    bool sda_held;
+    unsigned int sda_pin;
+    unsigned int clocks_to_release;
+};
+static i2c_inst i2c0_inst;
+static i2c_inst i2c1_inst;
+i2c_inst_t* i2c0 = &i2c0_inst;
+i2c_inst_t* i2c1 = &i2c1_inst;
+
+// Simulated devices, keyed by bus and address. Never destroyed, so devices with static storage can detach themselves
+// during exit.
+struct mock_i2c_device {
+    mock_i2c_write_fn write;
+    mock_i2c_read_fn read;
+    void* context;
+};
+
+static std::mutex& i2c_mutex()
+{
+    static std::mutex* mutex = new std::mutex();
+    return *mutex;
+}
+
+static std::map<std::pair<i2c_inst_t*, uint8_t>, mock_i2c_device>& i2c_devices()
+{
+    static auto* devices = new std::map<std::pair<i2c_inst_t*, uint8_t>, mock_i2c_device>();
+    return *devices;
+}
+
+static bool find_device(i2c_inst_t* i2c, uint8_t addr, mock_i2c_device* device)
+{
+    std::lock_guard<std::mutex> guard(i2c_mutex());
+    auto it = i2c_devices().find({i2c, addr});
+    if (it == i2c_devices().end()) {
+        return false;
+    }
+    *device = it->second;
+    return true;
+}
+
+// --- Transfers driven through DATA_CMD
+
+static void reset_transfer(i2c_inst_t* i2c)
+{
+    i2c->write_data.clear();
+    i2c->read_length = 0;
+    i2c->in_transfer = false;
+    i2c->aborted = false;
+    i2c->rx_fifo.clear();
+}
+
+// The device didn't acknowledge: flag TX_ABRT and drop the rest of the transfer, as the real block flushes its FIFO
+static void abort_transfer(i2c_inst_t* i2c, uint32_t source)
+{
+    i2c->hw.raw_intr_stat = i2c->hw.raw_intr_stat | I2C_IC_RAW_INTR_STAT_TX_ABRT_BITS;
+    i2c->hw.tx_abrt_source = source;
+    i2c->write_data.clear();
+    i2c->read_length = 0;
+    i2c->aborted = true;
+}
+
+// Pass the segment collected so far to the device. nostop is true if a restart follows rather than a stop.
+static void run_segment(i2c_inst_t* i2c, bool nostop)
+{
+    mock_i2c_device device;
+    bool found = find_device(i2c, (uint8_t)(i2c->hw.tar & 0x7F), &device);
+
+    if (!i2c->write_data.empty()) {
+        std::vector<uint8_t> data;
+        data.swap(i2c->write_data);
+        if (!found || !device.write) {
+            abort_transfer(i2c, I2C_IC_TX_ABRT_SOURCE_ABRT_7B_ADDR_NOACK_BITS);
+        } else if (device.write(device.context, data.data(), data.size(), nostop) != (int)data.size()) {
+            abort_transfer(i2c, I2C_IC_TX_ABRT_SOURCE_ABRT_TXDATA_NOACK_BITS);
+        }
+    } else if (i2c->read_length > 0) {
+        std::vector<uint8_t> data(i2c->read_length);
+        i2c->read_length = 0;
+        if (!found || !device.read || device.read(device.context, data.data(), data.size(), nostop) != (int)data.size()) {
+            abort_transfer(i2c, I2C_IC_TX_ABRT_SOURCE_ABRT_7B_ADDR_NOACK_BITS);
+            return;
+        }
+        i2c->rx_fifo.insert(i2c->rx_fifo.end(), data.begin(), data.end());
+        mock_dma_source_ready(&i2c->hw.data_cmd);
+    }
+}
+
+// A command written to DATA_CMD: a byte to send, or a request to read one, optionally with a restart before it or a
+// stop after it
+static void data_cmd_write(void* context, uint32_t value)
+{
+    i2c_inst_t* i2c = static_cast<i2c_inst_t*>(context);
+    bool read = (value & I2C_IC_DATA_CMD_CMD_BITS) != 0;
+
+    // Nothing gets onto a bus whose SDA line is held low, so the transfer never completes
+    if (i2c->sda_held) {
+        return;
+    }
+
+    // The first command of a transfer clears the abort left by the previous one. The real block holds it until
+    // CLR_TX_ABRT is read, which the mock cannot see.
+    if (!i2c->in_transfer) {
+        i2c->hw.raw_intr_stat = i2c->hw.raw_intr_stat & ~I2C_IC_RAW_INTR_STAT_TX_ABRT_BITS;
+        i2c->hw.tx_abrt_source = 0;
+        i2c->in_transfer = true;
+    }
+
+    if (!i2c->aborted) {
+        bool turnaround = read ? !i2c->write_data.empty() : i2c->read_length > 0;
+        if ((value & I2C_IC_DATA_CMD_RESTART_BITS) || turnaround) {
+            run_segment(i2c, true);
+        }
+    }
+    if (!i2c->aborted) {
+        if (read) {
+            i2c->read_length++;
+        } else {
+            i2c->write_data.push_back((uint8_t)value);
+        }
+    }
+    if (value & I2C_IC_DATA_CMD_STOP_BITS) {
+        if (!i2c->aborted) {
+            run_segment(i2c, false);
+        }
+        i2c->aborted = false;
+        i2c->in_transfer = false;
+    }
+}
+
+// A received byte read from DATA_CMD
+static bool data_cmd_read(void* context, uint32_t* data)
+{
+    i2c_inst_t* i2c = static_cast<i2c_inst_t*>(context);
+    if (i2c->rx_fifo.empty()) {
+        return false;
+    }
+    *data = i2c->rx_fifo.front();
+    i2c->rx_fifo.pop_front();
+    return true;
+}
+
+static struct DataRegisterSetup {
+    DataRegisterSetup()
+    {
+        for (i2c_inst_t* i2c : {&i2c0_inst, &i2c1_inst}) {
+            mock_dma_register_write_target(&i2c->hw.data_cmd, data_cmd_write, i2c);
+            mock_dma_register_read_source(&i2c->hw.data_cmd, data_cmd_read, i2c);
+        }
+    }
+} data_register_setup;
+
+// --- API
+
+unsigned int i2c_init(i2c_inst_t* i2c, unsigned int baudrate)
+{
+    // Resetting the block drops any transfer in progress
+    reset_transfer(i2c);
+    i2c->hw.raw_intr_stat = 0;
+    i2c->hw.tx_abrt_source = 0;
+    i2c->hw.dma_cr = 0;
+    i2c->hw.enable = 1;
+    i2c->baudrate = baudrate;
+    printf("Debug: initialised I2C%u at %u Hz\n", i2c == i2c0 ? 0u : 1u, baudrate);
+    return baudrate;
+}
+
+void i2c_deinit(i2c_inst_t* i2c)
+{
+}
+
+i2c_hw_t* i2c_get_hw(i2c_inst_t* i2c)
+{
+    return &i2c->hw;
+}
+
+unsigned int i2c_get_dreq(i2c_inst_t* i2c, bool is_tx)
+{
+    // DREQ_I2C0_TX is 32, followed by I2C0_RX, I2C1_TX and I2C1_RX
+    return 32 + (i2c == i2c1 ? 2 : 0) + (is_tx ? 0 : 1);
+}
+
+// Addresses with no device attached are NACKed, as on an empty bus
+int i2c_write_blocking(i2c_inst_t* i2c, uint8_t addr, const uint8_t* src, size_t len, bool nostop)
+{
+    mock_i2c_device device;
+    if (i2c->sda_held || !find_device(i2c, addr, &device) || !device.write) {
+        return PICO_ERROR_GENERIC;
+    }
+    return device.write(device.context, src, len, nostop);
+}
+
+int i2c_read_blocking(i2c_inst_t* i2c, uint8_t addr, uint8_t* dst, size_t len, bool nostop)
+{
+    mock_i2c_device device;
+    if (i2c->sda_held || !find_device(i2c, addr, &device) || !device.read) {
+        return PICO_ERROR_GENERIC;
+    }
+    return device.read(device.context, dst, len, nostop);
+}
+
+// A held bus burns the whole timeout, as on the hardware
+int i2c_write_timeout_us(i2c_inst_t* i2c, uint8_t addr, const uint8_t* src, size_t len, bool nostop,
+                         unsigned int timeout_us)
+{
+    if (i2c->sda_held) {
+        sleep_us(timeout_us);
+        return PICO_ERROR_TIMEOUT;
+    }
+    return i2c_write_blocking(i2c, addr, src, len, nostop);
+}
+
+int i2c_read_timeout_us(i2c_inst_t* i2c, uint8_t addr, uint8_t* dst, size_t len, bool nostop, unsigned int timeout_us)
+{
+    if (i2c->sda_held) {
+        sleep_us(timeout_us);
+        return PICO_ERROR_TIMEOUT;
+    }
+    return i2c_read_blocking(i2c, addr, dst, len, nostop);
+}
+
+void mock_i2c_attach_device(i2c_inst_t* i2c, uint8_t addr, mock_i2c_write_fn write, mock_i2c_read_fn read,
+                            void* context)
+{
+    std::lock_guard<std::mutex> guard(i2c_mutex());
+    i2c_devices()[{i2c, addr}] = {write, read, context};
+}
+
+void mock_i2c_detach_device(i2c_inst_t* i2c, uint8_t addr)
+{
+    std::lock_guard<std::mutex> guard(i2c_mutex());
+    i2c_devices().erase({i2c, addr});
+}
+
+// Each rising edge on SCL clocks out one more bit of the byte the device is stuck in
+static void scl_driven(void* context, unsigned int gpio, bool level)
+{
+    i2c_inst_t* i2c = static_cast<i2c_inst_t*>(context);
+    if (!i2c->sda_held || !level) {
+        return;
+    }
+    if (--i2c->clocks_to_release == 0) {
+        i2c->sda_held = false;
+        mock_gpio_watch_output(gpio, nullptr, nullptr);
+        mock_gpio_set_input(i2c->sda_pin, true);
+    }
+}
+
+void mock_i2c_hold_sda_low(i2c_inst_t* i2c, unsigned int sda_pin, unsigned int scl_pin, unsigned int clocks)
+{
+    reset_transfer(i2c);
+    i2c->sda_held = true;
+    i2c->sda_pin = sda_pin;
+    i2c->clocks_to_release = clocks > 0 ? clocks : 1;
+    mock_gpio_set_input(sda_pin, false);
+    mock_gpio_watch_output(scl_pin, scl_driven, i2c);
+}
@@ -0,0 +1,65 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include "hardware/gpio.h"
+
+// Types defined just so that we can replicate the real API
+typedef struct i2c_inst i2c_inst_t;
+extern i2c_inst_t* i2c0;
+extern i2c_inst_t* i2c1;
+
+// Error codes returned by the transfer functions (from pico/error.h)
+#ifndef PICO_ERROR_GENERIC
+#define PICO_ERROR_GENERIC -1
+#endif
+#ifndef PICO_ERROR_TIMEOUT
+#define PICO_ERROR_TIMEOUT -2
+#endif
+
+// The I2C block's registers, for driving transfers with DMA. Only the registers the drivers use are modelled: TAR,
+// DATA_CMD (written with commands by one DMA channel, read for the received bytes by another), RAW_INTR_STAT.TX_ABRT and
+// TX_ABRT_SOURCE. ENABLE, DMA_CR and CLR_TX_ABRT are plain fields, so writing or reading them has no side effect.
+typedef struct {
+    volatile uint32_t enable;
+    volatile uint32_t tar;
+    volatile uint32_t data_cmd;
+    volatile uint32_t raw_intr_stat;
+    volatile uint32_t clr_tx_abrt;
+    volatile uint32_t tx_abrt_source;
+    volatile uint32_t dma_cr;
+} i2c_hw_t;
+
+// Register bits (from hardware/regs/i2c.h)
+#define I2C_IC_DATA_CMD_RESTART_BITS 0x00000400u
+#define I2C_IC_DATA_CMD_STOP_BITS 0x00000200u
+#define I2C_IC_DATA_CMD_CMD_BITS 0x00000100u
+#define I2C_IC_RAW_INTR_STAT_TX_ABRT_BITS 0x00000040u
+#define I2C_IC_TX_ABRT_SOURCE_ABRT_7B_ADDR_NOACK_BITS 0x00000001u
+#define I2C_IC_TX_ABRT_SOURCE_ABRT_TXDATA_NOACK_BITS 0x00000008u
+#define I2C_IC_DMA_CR_TDMAE_BITS 0x00000002u
+#define I2C_IC_DMA_CR_RDMAE_BITS 0x00000001u
+
+// Functions defined to replicate the real API
+unsigned int i2c_init(i2c_inst_t* i2c, unsigned int baudrate);
+void i2c_deinit(i2c_inst_t* i2c);
+int i2c_write_blocking(i2c_inst_t* i2c, uint8_t addr, const uint8_t* src, size_t len, bool nostop);
+int i2c_read_blocking(i2c_inst_t* i2c, uint8_t addr, uint8_t* dst, size_t len, bool nostop);
+int i2c_write_timeout_us(i2c_inst_t* i2c, uint8_t addr, const uint8_t* src, size_t len, bool nostop,
+                         unsigned int timeout_us);
+int i2c_read_timeout_us(i2c_inst_t* i2c, uint8_t addr, uint8_t* dst, size_t len, bool nostop, unsigned int timeout_us);
+i2c_hw_t* i2c_get_hw(i2c_inst_t* i2c);
+unsigned int i2c_get_dreq(i2c_inst_t* i2c, bool is_tx);
+
+// Mock only: attach a simulated device to the bus at a 7-bit address. Transfers to that address are passed to the
+// device, which returns the number of bytes transferred or PICO_ERROR_GENERIC to NACK. Unattached addresses NACK.
+typedef int (*mock_i2c_write_fn)(void* context, const uint8_t* src, size_t len, bool nostop);
+typedef int (*mock_i2c_read_fn)(void* context, uint8_t* dst, size_t len, bool nostop);
+void mock_i2c_attach_device(i2c_inst_t* i2c, uint8_t addr, mock_i2c_write_fn write, mock_i2c_read_fn read,
+                            void* context);
+void mock_i2c_detach_device(i2c_inst_t* i2c, uint8_t addr);
+
+// Mock only: simulate a device holding SDA low, as one reset part-way through sending a byte would. Transfers on the
+// bus time out (the blocking functions, which would hang on the real hardware, fail instead) until the firmware has
+// clocked `scl_pin` high `clocks` times with gpio_put(), which lets the device finish its byte and release SDA.
+void mock_i2c_hold_sda_low(i2c_inst_t* i2c, unsigned int sda_pin, unsigned int scl_pin, unsigned int clocks);
@@ -1,18 +1,107 @@
 #include <vector>
+#include <stdexcept>
 #include "hardware/pio.h"
+#include "hardware/dma.h"
 
-PIO pio0 = 0;
-static std::vector<pio_program_t> pio_programs;
+static pio_hw_t pio_hw[NUM_PIOS];
+PIO pio0 = &pio_hw[0];
+PIO pio1 = &pio_hw[1];
+
+// Each PIO block's loaded programs (indexed by offset), and the program each state machine was started at
+struct mock_pio_state {
+    std::vector<pio_program_t> programs;
+    pio_program_t running[NUM_PIO_STATE_MACHINES];
+    bool claimed[NUM_PIO_STATE_MACHINES];
+};
+static mock_pio_state pio_state[NUM_PIOS];
+
+// Words written to a TX FIFO register by the DMA mock are delivered to the program, just like pio_sm_put_blocking.
+// The context holds the PIO index and state machine.
+static void pio_txf_write(void* context, uint32_t data)
+{
+    unsigned int target = (unsigned int)(uintptr_t)context;
+    pio_sm_put_blocking(&pio_hw[target / NUM_PIO_STATE_MACHINES], target % NUM_PIO_STATE_MACHINES, data);
+}
+
+static bool register_txf_targets()
+{
+    for (unsigned int target = 0; target < NUM_PIOS * NUM_PIO_STATE_MACHINES; target++) {
+        mock_dma_register_write_target(&pio_hw[target / NUM_PIO_STATE_MACHINES].txf[target % NUM_PIO_STATE_MACHINES],
+                                       pio_txf_write, (void*)(uintptr_t)target);
+    }
+    return true;
+}
+static bool txf_targets_registered = register_txf_targets();
 
 unsigned int pio_add_program(PIO pio, const pio_program_t* program)
 {
-    pio_programs.push_back(*program);
-    return 0;
+    // The offset is just the program's index, as the mock has no instruction memory
+    std::vector<pio_program_t>& programs = pio_state[pio_get_index(pio)].programs;
+    programs.push_back(*program);
+    return (unsigned int)programs.size() - 1;
+}
+
+unsigned int pio_get_index(PIO pio)
+{
+    return (unsigned int)(pio - pio_hw);
+}
+
+int pio_claim_unused_sm(PIO pio, bool required)
+{
+    mock_pio_state& state = pio_state[pio_get_index(pio)];
+    for (unsigned int sm = 0; sm < NUM_PIO_STATE_MACHINES; sm++) {
+        if (!state.claimed[sm]) {
+            state.claimed[sm] = true;
+            return (int)sm;
+        }
+    }
+    if (required) {
+        throw std::runtime_error("No PIO state machines are available");
+    }
+    return -1;
+}
+
+void pio_sm_claim(PIO pio, unsigned int sm)
+{
+    mock_pio_state& state = pio_state[pio_get_index(pio)];
+    if (state.claimed[sm]) {
+        throw std::runtime_error("PIO state machine is already claimed");
+    }
+    state.claimed[sm] = true;
+}
+
+void pio_sm_unclaim(PIO pio, unsigned int sm)
+{
+    pio_state[pio_get_index(pio)].claimed[sm] = false;
+}
+
+bool pio_sm_is_claimed(PIO pio, unsigned int sm)
+{
+    return pio_state[pio_get_index(pio)].claimed[sm];
+}
+
+void pio_sm_init(PIO pio, unsigned int sm, unsigned int initial_pc, const pio_sm_config* config)
+{
+    mock_pio_state& state = pio_state[pio_get_index(pio)];
+    state.running[sm] = initial_pc < state.programs.size() ? state.programs[initial_pc] : nullptr;
 }
 
 void pio_sm_put_blocking(PIO pio, unsigned int sm, uint32_t data)
 {
-    for (auto program : pio_programs) {
-        program(data);
+    // Data sent to a state machine that was never started is lost, as nothing would ever drain the real FIFO
+    pio_program_t program = pio_state[pio_get_index(pio)].running[sm];
+    if (program) {
+        program(pio, sm, data);
     }
 }
+
+bool pio_sm_is_tx_fifo_empty(PIO pio, unsigned int sm)
+{
+    // The mock delivers data to the program immediately, so the FIFO never holds anything
+    return true;
+}
+
+unsigned int pio_get_dreq(PIO pio, unsigned int sm, bool is_tx)
+{
+    return pio_get_index(pio) * 8 + sm + (is_tx ? 0 : 4);
+}
@@ -1,14 +1,35 @@
 #pragma once 
 
+#include <stdint.h>
 #include <vector>
 
 // Types defined just so that we can replicate the real API
-typedef uint32_t PIO;
+typedef struct {
+    volatile uint32_t txf[4]; // TX FIFO write registers, one per state machine (used as DMA write targets)
+} pio_hw_t;
+typedef pio_hw_t* PIO;
 extern PIO pio0;
+extern PIO pio1;
 
-// A "program" in the mock is a function pointer that is called with the data being delivered to the PIO.
-typedef void (*pio_program_t)(uint32_t data);
+#define NUM_PIOS 2
+#define NUM_PIO_STATE_MACHINES 4
+
+// A "program" in the mock is a function pointer that is called with the data delivered to a state machine running it.
+typedef void (*pio_program_t)(PIO pio, unsigned int sm, uint32_t data);
+
+// The mock ignores the configuration, but keeps the type so that code can pass one
+typedef struct {
+    uint32_t unused;
+} pio_sm_config;
 
 // Functions defined to replicate the real API
 unsigned int pio_add_program(PIO pio, const pio_program_t* program);
+unsigned int pio_get_index(PIO pio);
+int pio_claim_unused_sm(PIO pio, bool required);
+void pio_sm_claim(PIO pio, unsigned int sm);
+void pio_sm_unclaim(PIO pio, unsigned int sm);
+bool pio_sm_is_claimed(PIO pio, unsigned int sm);
+void pio_sm_init(PIO pio, unsigned int sm, unsigned int initial_pc, const pio_sm_config* config);
 void pio_sm_put_blocking(PIO pio, unsigned int sm, uint32_t data);
+bool pio_sm_is_tx_fifo_empty(PIO pio, unsigned int sm);
+unsigned int pio_get_dreq(PIO pio, unsigned int sm, bool is_tx);
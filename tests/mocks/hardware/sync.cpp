@@ -0,0 +1,45 @@
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+#include <atomic>
+#include "hardware/sync.h"
+#include "pico/time.h"
+
+static std::mutex irq_mutex;
+static std::condition_variable irq_condition;
+static std::atomic<bool> irq_pending{false};
+
+uint32_t save_and_disable_interrupts()
+{
+    // Interrupt handlers run on the threads that raise them, so there is nothing to disable
+    return 0;
+}
+
+void restore_interrupts(uint32_t status)
+{
+}
+
+void __wfi()
+{
+    if (mock_time_is_virtual()) {
+        // Let the clock run on until an interrupt, or for the same 1ms timeout as below
+        mock_time_block_until(to_us_since_boot(get_absolute_time()) + 1000, [] { return irq_pending.load(); });
+        irq_pending = false;
+        return;
+    }
+
+    std::unique_lock<std::mutex> lock(irq_mutex);
+    // Time out occasionally, as a real core is woken by interrupts (e.g. timers) that the mocks do not model
+    irq_condition.wait_for(lock, std::chrono::milliseconds(1), [] { return irq_pending.load(); });
+    irq_pending = false;
+}
+
+void mock_irq_signal()
+{
+    {
+        std::lock_guard<std::mutex> lock(irq_mutex);
+        irq_pending = true;
+    }
+    irq_condition.notify_all();
+    mock_time_notify();
+}
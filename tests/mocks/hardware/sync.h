@@ -0,0 +1,14 @@
+#pragma once
+
+#include <stdint.h>
+
+// Functions defined to replicate the real API
+uint32_t save_and_disable_interrupts();
+void restore_interrupts(uint32_t status);
+
+// Sleeps until an interrupt is signalled. As on the hardware, an interrupt that arrived while interrupts were disabled
+// causes an immediate return.
+void __wfi();
+
+// Mock only: called by the other mocks whenever they raise an "interrupt", to wake the core from __wfi()
+void mock_irq_signal();
@@ -0,0 +1,16 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+
+// Types defined just so that we can replicate the real API
+typedef struct uart_inst uart_inst_t;
+extern uart_inst_t* uart0;
+extern uart_inst_t* uart1;
+
+// The UART that stdio uses (PICO_DEFAULT_UART on the board)
+#define uart_default uart0
+
+// Bytes written to the stdio UART go to stdout alongside printf() output, as they share the wire on the board. Writes
+// are not translated (no CRLF handling), so binary data arrives intact. The other UART discards its output.
+void uart_write_blocking(uart_inst_t* uart, const uint8_t* src, size_t len);
@@ -0,0 +1,12 @@
+#include "pico/flash.h"
+
+int flash_safe_execute(void (*func)(void*), void* param, uint32_t enter_exit_timeout_ms)
+{
+    func(param);
+    return 0;
+}
+
+bool flash_safe_execute_core_init()
+{
+    return true;
+}
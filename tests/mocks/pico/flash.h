@@ -0,0 +1,11 @@
+#pragma once
+
+#include <stdint.h>
+
+// Functions defined to replicate the real API. On the chip, flash_safe_execute() stops the other core and disables
+// interrupts while func erases or programs flash, as nothing may run from flash meanwhile; the mock just calls func
+// and returns 0 (PICO_OK).
+int flash_safe_execute(void (*func)(void*), void* param, uint32_t enter_exit_timeout_ms);
+
+// Lets the other core pause this one for flash_safe_execute(). Call it once on the core that is not writing flash.
+bool flash_safe_execute_core_init();
@@ -0,0 +1,24 @@
+#include <thread>
+#include "pico/multicore.h"
+#include "pico/platform.h"
+#include "pico/time.h"
+
+// Identifies the thread that is standing in for core 1
+static thread_local unsigned int core_num = 0;
+
+unsigned int get_core_num()
+{
+    return core_num;
+}
+
+void multicore_launch_core1(void (*entry)(void))
+{
+    mock_time_core_launched(1);
+    std::thread core1([entry] {
+        core_num = 1;
+        mock_time_core_started();
+        entry();
+        mock_time_core_finished();
+    });
+    core1.detach();
+}
@@ -0,0 +1,6 @@
+#pragma once
+
+#include <stdint.h>
+
+// Core 1 is emulated by a std::thread
+void multicore_launch_core1(void (*entry)(void));
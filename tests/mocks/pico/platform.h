@@ -0,0 +1,4 @@
+#pragma once
+
+// Returns 1 on the thread started by multicore_launch_core1(), otherwise 0
+unsigned int get_core_num();
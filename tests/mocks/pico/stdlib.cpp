@@ -1,21 +1,72 @@
 #include <iostream>
 #include <thread>
 #include <chrono>
+#include <deque>
+#include <mutex>
+#include <stdio.h>
 
 #include "pico/stdlib.h"
-#include "ws2812.pio.h"
+#include "pico/time.h"
+#include "WS2812.pio.h"
 
 void stdio_init_all()
 {
 
 }
 
+// Characters read from stdin and not yet taken by getchar_timeout_us()
+static std::mutex inputMutex;
+static std::deque<int> input;
+
+int getchar_timeout_us(uint32_t timeout_us)
+{
+    static std::once_flag readerStarted;
+    std::call_once(readerStarted, [] {
+        std::thread reader([] {
+            int c;
+            while ((c = getchar()) != EOF) {
+                std::lock_guard<std::mutex> guard(inputMutex);
+                input.push_back(c);
+            }
+        });
+        reader.detach();
+    });
+
+    absolute_time_t deadline = make_timeout_time_us(timeout_us);
+    for (;;) {
+        {
+            std::lock_guard<std::mutex> guard(inputMutex);
+            if (!input.empty()) {
+                int c = input.front();
+                input.pop_front();
+                return c;
+            }
+        }
+        if (time_reached(deadline)) {
+            return PICO_ERROR_TIMEOUT;
+        }
+        sleep_us(100);
+    }
+}
+
 void sleep_ms(uint32_t ms)
 {
-    std::this_thread::sleep_for(std::chrono::milliseconds(ms));
+    sleep_us(ms * 1000);
 }
 
 void sleep_us(uint32_t us)
 {
+    if (mock_time_is_virtual()) {
+        mock_time_block_until(to_us_since_boot(get_absolute_time()) + us, nullptr);
+        return;
+    }
     std::this_thread::sleep_for(std::chrono::microseconds(us));
 }
+
+void tight_loop_contents()
+{
+    // A busy-wait would otherwise stop the virtual clock, so treat each pass as a short sleep
+    if (mock_time_is_virtual()) {
+        sleep_us(1);
+    }
+}
@@ -1,8 +1,18 @@
 #pragma once
 #include <stdint.h>
 
+// Error code returned by getchar_timeout_us() (from pico/error.h)
+#ifndef PICO_ERROR_TIMEOUT
+#define PICO_ERROR_TIMEOUT -2
+#endif
+
 // Generic API
 typedef unsigned int uint;
 void stdio_init_all();
+// Returns the next character received on stdio, or PICO_ERROR_TIMEOUT if none arrives within timeout_us. Characters
+// come from stdin, read on a background thread (so from a terminal they arrive once Enter is pressed).
+int getchar_timeout_us(uint32_t timeout_us);
 void sleep_ms(uint32_t ms);
 void sleep_us(uint32_t us);
+// Does nothing, except under virtual time (see pico/time.h) where it lets the clock move on by a microsecond
+void tight_loop_contents();
@@ -1,7 +1,244 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <set>
+#include <map>
 #include "pico/time.h"
+#include "pico/platform.h"
+#include "hardware/sync.h"
 
-absolute_time_t get_absolute_time() 
-{   
+// Alarms that have been added but have not fired or been cancelled
+static std::mutex alarm_mutex;
+static std::set<alarm_id_t> active_alarms;
+static alarm_id_t next_alarm_id = 1;
+
+// --- Virtual clock
+// Guarded by clock_mutex, except for the current time which any thread can read
+
+#define NO_CORE 0xFFFFFFFFu
+
+struct VirtualAlarm {
+    uint64_t due_us;
+    alarm_callback_t callback;
+    void* user_data;
+};
+
+// Why a blocked core is waiting: until a time, or until ready() returns true
+struct Waiter {
+    uint64_t wake_us;
+    bool (*ready)();
+};
+
+static std::atomic<uint64_t> virtual_now_us{0};
+static std::mutex clock_mutex;
+static std::condition_variable clock_condition;
+static std::map<alarm_id_t, VirtualAlarm> virtual_alarms;
+static std::map<unsigned int, Waiter> waiters; // Blocked cores, by core number
+static unsigned int running_core = 0;          // The core allowed to run; the main thread starts out running
+static bool scheduling = false;                // A blocked core is choosing who runs next (and may be firing alarms)
+static uint64_t exit_after_us = 0;
+
+// Static initialisation runs on the main thread, which stands in for core 0. Core 1 marks its own thread.
+static const std::thread::id main_thread = std::this_thread::get_id();
+static thread_local bool core_thread = false;
+
+// Function-local so that the environment is read before the first use from any static initialiser (e.g. a simulated
+// device recording when it was created)
+static std::atomic<bool>& virtual_time()
+{
+    static std::atomic<bool> enabled{getenv("PICO_MOCK_VIRTUAL_TIME") != nullptr};
+    return enabled;
+}
+
+// Reads the environment during static initialisation, before main() can start any threads
+static bool configure_from_environment()
+{
+    if (const char* limit = getenv("PICO_MOCK_EXIT_AFTER_MS")) {
+        exit_after_us = strtoull(limit, nullptr, 10) * 1000;
+        if (!virtual_time().load() && exit_after_us > 0) {
+            std::thread([] {
+                std::this_thread::sleep_for(std::chrono::microseconds(exit_after_us));
+                fflush(nullptr);
+                _Exit(0);
+            }).detach();
+        }
+    }
+    return true;
+}
+static bool configured = configure_from_environment();
+
+void mock_time_set_virtual(bool enabled)
+{
+    virtual_time().store(enabled);
+}
+
+bool mock_time_is_virtual()
+{
+    return virtual_time().load();
+}
+
+static bool is_core()
+{
+    return core_thread || std::this_thread::get_id() == main_thread;
+}
+
+static bool is_runnable(const Waiter& waiter)
+{
+    return virtual_now_us.load() >= waiter.wake_us || (waiter.ready && waiter.ready());
+}
+
+// Fire every alarm due by the current time, earliest first. The lock is released around each callback so that it can
+// use the other mocks.
+static void fire_due_alarms(std::unique_lock<std::mutex>& lock)
+{
+    for (;;) {
+        auto due = virtual_alarms.end();
+        for (auto it = virtual_alarms.begin(); it != virtual_alarms.end(); ++it) {
+            if (it->second.due_us <= virtual_now_us.load() &&
+                (due == virtual_alarms.end() || it->second.due_us < due->second.due_us)) {
+                due = it;
+            }
+        }
+        if (due == virtual_alarms.end()) {
+            return;
+        }
+        alarm_id_t id = due->first;
+        VirtualAlarm alarm = due->second;
+        virtual_alarms.erase(due);
+
+        lock.unlock();
+        int64_t reschedule = alarm.callback(id, alarm.user_data);
+        mock_irq_signal();
+        lock.lock();
+
+        // As in the SDK, a positive return value reschedules the alarm that many microseconds later
+        if (reschedule > 0) {
+            virtual_alarms[id] = {virtual_now_us.load() + (uint64_t)reschedule, alarm.callback, alarm.user_data};
+        } else {
+            std::lock_guard<std::mutex> guard(alarm_mutex);
+            active_alarms.erase(id);
+        }
+    }
+}
+
+// Called with the lock held by a blocked core when no core is running. Hands the turn to the lowest numbered runnable
+// core, first moving time forward to the next deadline or alarm if nothing can run yet.
+static void schedule(std::unique_lock<std::mutex>& lock)
+{
+    scheduling = true;
+    for (;;) {
+        for (auto& waiter : waiters) {
+            if (is_runnable(waiter.second)) {
+                running_core = waiter.first;
+                break;
+            }
+        }
+        if (running_core != NO_CORE) {
+            break;
+        }
+
+        // Nothing can run, so skip ahead to whatever happens first
+        uint64_t next_us = UINT64_MAX;
+        for (auto& waiter : waiters) {
+            next_us = std::min(next_us, waiter.second.wake_us);
+        }
+        for (auto& alarm : virtual_alarms) {
+            next_us = std::min(next_us, alarm.second.due_us);
+        }
+        if (next_us == UINT64_MAX) {
+            // Every core is waiting for something only another thread can cause
+            clock_condition.wait(lock);
+            continue;
+        }
+        if (exit_after_us > 0 && next_us >= exit_after_us) {
+            fflush(nullptr);
+            _Exit(0);
+        }
+        if (next_us > virtual_now_us.load()) {
+            virtual_now_us.store(next_us);
+        }
+        fire_due_alarms(lock);
+    }
+    scheduling = false;
+    clock_condition.notify_all();
+}
+
+// Wait, with the lock held, until it is this core's turn and its wait is over
+static void wait_for_turn(std::unique_lock<std::mutex>& lock, unsigned int core)
+{
+    for (;;) {
+        if (running_core == NO_CORE && !scheduling) {
+            schedule(lock);
+        }
+        if (running_core == core && is_runnable(waiters[core])) {
+            break;
+        }
+        clock_condition.wait(lock);
+    }
+    waiters.erase(core);
+}
+
+void mock_time_block_until(uint64_t wake_us, bool (*ready)())
+{
+    std::unique_lock<std::mutex> lock(clock_mutex);
+    if (!is_core()) {
+        // Other threads (e.g. a mock's worker) just wait for the clock, without taking part in scheduling
+        Waiter self = {wake_us, ready};
+        clock_condition.wait(lock, [&self] { return is_runnable(self); });
+        return;
+    }
+
+    unsigned int core = get_core_num();
+    waiters[core] = {wake_us, ready};
+    if (running_core == core) {
+        running_core = NO_CORE;
+    }
+    wait_for_turn(lock, core);
+}
+
+void mock_time_notify()
+{
+    std::lock_guard<std::mutex> guard(clock_mutex);
+    clock_condition.notify_all();
+}
+
+void mock_time_core_launched(unsigned int core)
+{
+    // Counts as blocked and ready to run, so the clock can't move until the new core has had its first turn
+    std::lock_guard<std::mutex> guard(clock_mutex);
+    waiters[core] = {virtual_now_us.load(), nullptr};
+}
+
+void mock_time_core_started()
+{
+    core_thread = true;
+    std::unique_lock<std::mutex> lock(clock_mutex);
+    if (virtual_time().load()) {
+        wait_for_turn(lock, get_core_num());
+    } else {
+        waiters.erase(get_core_num());
+    }
+}
+
+void mock_time_core_finished()
+{
+    std::lock_guard<std::mutex> guard(clock_mutex);
+    if (running_core == get_core_num()) {
+        running_core = NO_CORE;
+    }
+    clock_condition.notify_all();
+}
+
+// --- Time
+
+absolute_time_t get_absolute_time()
+{
+    if (virtual_time().load()) {
+        return absolute_time_t(std::chrono::microseconds(virtual_now_us.load()));
+    }
     return std::chrono::steady_clock::now();
 }
 
@@ -11,3 +248,86 @@ uint32_t to_ms_since_boot(absolute_time_t t)
     auto millis = std::chrono::duration_cast<std::chrono::milliseconds>(duration).count();
     return (uint32_t)millis;
 }
+
+uint64_t to_us_since_boot(absolute_time_t t)
+{
+    auto duration = t.time_since_epoch();
+    return (uint64_t)std::chrono::duration_cast<std::chrono::microseconds>(duration).count();
+}
+
+int64_t absolute_time_diff_us(absolute_time_t from, absolute_time_t to)
+{
+    return std::chrono::duration_cast<std::chrono::microseconds>(to - from).count();
+}
+
+absolute_time_t make_timeout_time_us(uint64_t us)
+{
+    return get_absolute_time() + std::chrono::microseconds(us);
+}
+
+bool time_reached(absolute_time_t t)
+{
+    return get_absolute_time() >= t;
+}
+
+// --- Alarms
+
+// Each alarm runs on its own thread, standing in for the timer interrupt
+static void alarm_thread(alarm_id_t id, uint64_t us, alarm_callback_t callback, void *user_data)
+{
+    for (;;) {
+        std::this_thread::sleep_for(std::chrono::microseconds(us));
+        {
+            std::lock_guard<std::mutex> guard(alarm_mutex);
+            if (active_alarms.count(id) == 0) {
+                return; // Cancelled
+            }
+        }
+
+        int64_t reschedule = callback(id, user_data);
+        mock_irq_signal();
+
+        // As in the SDK, a positive return value reschedules the alarm that many microseconds later
+        if (reschedule <= 0) {
+            std::lock_guard<std::mutex> guard(alarm_mutex);
+            active_alarms.erase(id);
+            return;
+        }
+        us = (uint64_t)reschedule;
+    }
+}
+
+alarm_id_t add_alarm_in_us(uint64_t us, alarm_callback_t callback, void *user_data, bool fire_if_past)
+{
+    alarm_id_t id;
+    {
+        std::lock_guard<std::mutex> guard(alarm_mutex);
+        id = next_alarm_id++;
+        active_alarms.insert(id);
+    }
+
+    if (virtual_time().load()) {
+        // Fired by whichever core moves the clock past the due time
+        std::lock_guard<std::mutex> guard(clock_mutex);
+        virtual_alarms[id] = {virtual_now_us.load() + us, callback, user_data};
+        return id;
+    }
+
+    std::thread(alarm_thread, id, us, callback, user_data).detach();
+    return id;
+}
+
+alarm_id_t add_alarm_in_ms(uint32_t ms, alarm_callback_t callback, void *user_data, bool fire_if_past)
+{
+    return add_alarm_in_us((uint64_t)ms * 1000, callback, user_data, fire_if_past);
+}
+
+bool cancel_alarm(alarm_id_t alarm_id)
+{
+    if (virtual_time().load()) {
+        std::lock_guard<std::mutex> guard(clock_mutex);
+        virtual_alarms.erase(alarm_id);
+    }
+    std::lock_guard<std::mutex> guard(alarm_mutex);
+    return active_alarms.erase(alarm_id) > 0;
+}
@@ -6,4 +6,41 @@
 typedef std::chrono::time_point<std::chrono::steady_clock,std::chrono::steady_clock::duration> absolute_time_t;
 
 uint32_t to_ms_since_boot(absolute_time_t t);
+uint64_t to_us_since_boot(absolute_time_t t);
 absolute_time_t get_absolute_time();
+int64_t absolute_time_diff_us(absolute_time_t from, absolute_time_t to);
+absolute_time_t make_timeout_time_us(uint64_t us);
+bool time_reached(absolute_time_t t);
+
+// Alarms
+typedef int32_t alarm_id_t;
+typedef int64_t (*alarm_callback_t)(alarm_id_t id, void *user_data);
+alarm_id_t add_alarm_in_us(uint64_t us, alarm_callback_t callback, void *user_data, bool fire_if_past);
+alarm_id_t add_alarm_in_ms(uint32_t ms, alarm_callback_t callback, void *user_data, bool fire_if_past);
+bool cancel_alarm(alarm_id_t alarm_id);
+
+// Mock only: virtual time.
+//
+// When enabled, time starts at zero and only moves when every core (the main thread, plus core 1 once launched) is
+// blocked in sleep_ms()/sleep_us(), __wfi() or tight_loop_contents(). It then jumps straight to the next sleep deadline
+// or alarm, firing alarms on the way, so minutes of firmware time run in milliseconds. The cores also take turns, only
+// switching when the running core blocks, which makes a run repeatable. A core that busy-waits without calling one of
+// those functions stops the clock.
+//
+// Enable it before any other mock is used, or set PICO_MOCK_VIRTUAL_TIME in the environment. Setting
+// PICO_MOCK_EXIT_AFTER_MS exits the program after that much (virtual or real) time.
+void mock_time_set_virtual(bool enabled);
+bool mock_time_is_virtual();
+
+// Mock only: block the calling core until virtual time reaches wake_us, or until ready() (if given) returns true. Used
+// by the other mocks to implement sleeping and waiting for interrupts.
+void mock_time_block_until(uint64_t wake_us, bool (*ready)());
+
+// Mock only: something a blocked core may be waiting for has happened (e.g. an interrupt was raised)
+void mock_time_notify();
+
+// Mock only: register core 1 with the virtual clock. mock_time_core_launched() is called by the thread launching the
+// core, and the others from the new core's thread before and after its entry point.
+void mock_time_core_launched(unsigned int core);
+void mock_time_core_started();
+void mock_time_core_finished();
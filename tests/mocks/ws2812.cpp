@@ -1,77 +1,417 @@
+#include <stdio.h>
 #include <vector>
-#include <iostream>
 #include <chrono>
 #include <atomic>
 #include <mutex>
+#include <condition_variable>
 #include <thread>
-#include <semaphore>
+#include <algorithm>
 
 #include "hardware/pio.h"
-#include "ws2812.pio.h"
+#include "pico/time.h"
+#include "WS2812.pio.h"
 
-void ws2812_program_impl(uint32_t data);
-void ws2812_idle_detection_thread();
+void ws2812_program_impl(PIO pio, unsigned int sm, uint32_t data);
+void ws2812_latch_thread();
+int64_t ws2812_latch_alarm(alarm_id_t id, void* user_data);
 
 pio_program_t ws2812_program = ws2812_program_impl;
 
-// Array in which to receive the LED data during each call to pio_sm_put_blocking
-std::vector<uint32_t> mock_ws2812_leds;
-std::mutex mock_ws2812_leds_mutex;
-std::binary_semaphore mock_ws2812_semaphore (0); // to signal that the idle detection thread should wake up
+// The real LEDs latch once the line has been low for 280us
+#define LATCH_TIME_US 280
 
-// Storage for the last update 
-std::atomic<std::chrono::steady_clock::time_point> last_update;
+#define NUM_CHANNELS (NUM_PIOS * NUM_PIO_STATE_MACHINES)
+
+// Words are written straight into one of a ring of preallocated frame buffers. The frame being captured and the
+// number of pixels in it are packed into one atomic, so that both the sender (a word arriving after the line went
+// idle) and the latch thread (a timeout) can close a frame with a compare-exchange and no lock on the pixel path.
+struct FrameSlot {
+    std::atomic<bool> ready; // Closed and waiting for the latch thread; the sender must not write to it
+    uint32_t count;
+    uint64_t timestamp_us;
+    uint32_t pixels[MOCK_WS2812_MAX_PIXELS];
+};
+
+// Each state machine running the program drives a separate LED chain, with its own frames
+struct CaptureChannel {
+    unsigned int pio;
+    unsigned int sm;
+    uint8_t bytes_per_pixel;
+    FrameSlot slots[MOCK_WS2812_FRAME_SLOTS];
+    std::atomic<uint64_t> frame_state{0}; // (frame sequence << 32) | pixels captured
+    std::atomic<uint64_t> last_word_us{0};
+    std::atomic<bool> dropping{false};
+    uint32_t next_sequence = 0; // Next frame to deliver, only touched by whichever side latches frames
+};
+
+// Created by ws2812_program_init() before the chain can receive data. Never destroyed, as the latch thread may still
+// be using them while the program exits.
+static std::atomic<CaptureChannel*> channels[NUM_CHANNELS];
+static std::atomic<bool> latch_thread_started{false};
+static std::atomic<uint64_t> frames_dropped{0};
+static std::atomic<uint64_t> pixels_dropped{0};
+
+// Wakes the latch thread when a frame starts. The synchronisation objects are never destroyed, as the detached latch
+// thread may still be waiting on them while the program exits.
+static std::mutex& activity_mutex = *new std::mutex();
+static std::condition_variable& activity = *new std::condition_variable();
+
+// Sinks and counters, only touched by the latch thread and the mock_ws2812 API
+static std::mutex& sink_mutex = *new std::mutex();
+static std::condition_variable& frame_latched = *new std::condition_variable();
+static bool console_output = true;
+static FILE* recording = nullptr;
+static size_t frames_to_keep = 0;
+static std::vector<mock_ws2812_frame> kept_frames;
+static uint64_t frames_latched = 0;
+static uint64_t pixels_latched = 0;
+static uint64_t first_frame_us = 0;
+static uint64_t last_frame_us = 0;
+
+// Closes a recording left open at exit so the file is complete
+static struct RecordingCloser {
+    ~RecordingCloser() { mock_ws2812_stop_recording(); }
+} recording_closer;
+
+static uint64_t now_us()
+{
+    return to_us_since_boot(get_absolute_time());
+}
+
+static uint32_t state_count(uint64_t state)
+{
+    return (uint32_t)state;
+}
+
+static uint32_t state_sequence(uint64_t state)
+{
+    return (uint32_t)(state >> 32);
+}
+
+// Close the frame described by `state`, timestamped with its last word. Returns the new state, which is the next
+// empty frame if this call closed it, or whatever the other side changed it to.
+static uint64_t close_frame(CaptureChannel& channel, uint64_t state, uint64_t last_word)
+{
+    uint64_t next = (uint64_t)(state_sequence(state) + 1) << 32;
+    if (channel.frame_state.compare_exchange_strong(state, next, std::memory_order_acq_rel)) {
+        FrameSlot& slot = channel.slots[state_sequence(state) % MOCK_WS2812_FRAME_SLOTS];
+        slot.count = std::min<uint32_t>(state_count(state), MOCK_WS2812_MAX_PIXELS);
+        slot.timestamp_us = last_word + LATCH_TIME_US;
+        slot.ready.store(true, std::memory_order_release);
+        return next;
+    }
+    return state;
+}
 
 void ws2812_program_init(PIO pio, unsigned int sm, unsigned int offset, unsigned int pin, float freq, bool rgbw)
 {
-    last_update.store(std::chrono::steady_clock::now());
-    std::thread idle_detection (ws2812_idle_detection_thread);
-    idle_detection.detach();
+    unsigned int index = pio_get_index(pio) * NUM_PIO_STATE_MACHINES + sm;
+    CaptureChannel* channel = channels[index].load();
+    if (!channel) {
+        channel = new CaptureChannel();
+        channel->pio = pio_get_index(pio);
+        channel->sm = sm;
+    }
+    channel->bytes_per_pixel = rgbw ? 4 : 3;
+    channel->last_word_us.store(now_us());
+    channels[index].store(channel);
+    pio_sm_init(pio, sm, offset, nullptr);
+
+    // Under virtual time frames are latched by an alarm instead, so that they arrive at repeatable times
+    if (!mock_time_is_virtual() && !latch_thread_started.exchange(true)) {
+        std::thread latch(ws2812_latch_thread);
+        latch.detach();
+    }
 }
 
-void ws2812_program_impl(uint32_t data) 
+void ws2812_program_impl(PIO pio, unsigned int sm, uint32_t data)
 {
-    // Store the LED colour we received
-    std::lock_guard<std::mutex> guard(mock_ws2812_leds_mutex);
-    mock_ws2812_leds.push_back(data);
-    // Reset the idle detection timer (because the real LEDs wait for the bus to go idle before latching the colours)
-    last_update.store(std::chrono::steady_clock::now());
-    // Signal to the idle detection thread
-    mock_ws2812_semaphore.release();
+    CaptureChannel& channel = *channels[pio_get_index(pio) * NUM_PIO_STATE_MACHINES + sm].load();
+    uint64_t now = now_us();
+    uint64_t last = channel.last_word_us.exchange(now, std::memory_order_acq_rel);
+    uint64_t state = channel.frame_state.load(std::memory_order_acquire);
+
+    // A gap longer than the latch time means the LEDs have already latched the previous frame
+    if (state_count(state) > 0 && now - last >= LATCH_TIME_US) {
+        state = close_frame(channel, state, last);
+    }
+
+    uint32_t count;
+    for (;;) {
+        count = state_count(state);
+        FrameSlot& slot = channel.slots[state_sequence(state) % MOCK_WS2812_FRAME_SLOTS];
+        if (slot.ready.load(std::memory_order_acquire)) {
+            // The latch thread has fallen a whole ring behind; lose this frame rather than block the sender
+            if (!channel.dropping.exchange(true) || now - last >= LATCH_TIME_US) {
+                frames_dropped++;
+            }
+            pixels_dropped++;
+            return;
+        }
+        channel.dropping.store(false);
+        if (count < MOCK_WS2812_MAX_PIXELS) {
+            slot.pixels[count] = data;
+        } else {
+            pixels_dropped++;
+        }
+        if (channel.frame_state.compare_exchange_weak(state, state + 1, std::memory_order_acq_rel)) {
+            break;
+        }
+        // The latch thread closed the frame in the meantime, so this word starts the next one
+    }
+
+    // Only the first word of a frame takes the lock, to wake the latch thread
+    if (count == 0) {
+        if (latch_thread_started.load()) {
+            std::lock_guard<std::mutex> guard(activity_mutex);
+            activity.notify_one();
+        } else {
+            add_alarm_in_us(LATCH_TIME_US, ws2812_latch_alarm, &channel, true);
+        }
+    }
 }
 
-// Display the LED status 280us after the last message was posted. This emulates the real wire protocol where idle 
-// means to latch the latest values.
-void ws2812_idle_detection_thread()
+// Pass a latched frame to the sinks
+static void deliver_frame(const CaptureChannel& channel, const FrameSlot& slot)
+{
+    std::lock_guard<std::mutex> guard(sink_mutex);
+
+    if (console_output) {
+        // The first chain keeps the plain prefix, so single-strip output reads as it always has
+        bool rgbw = channel.bytes_per_pixel == 4;
+        const char* channel_names = rgbw ? "(R,G,B,W)" : "(R,G,B)";
+        if (channel.pio == 0 && channel.sm == 0) {
+            printf("Debug: LEDs %s = ", channel_names);
+        } else {
+            printf("Debug: LEDs pio%u sm%u %s = ", channel.pio, channel.sm, channel_names);
+        }
+        // Decode the words as a WS2812 (or SK6812 RGBW) would: green, red, blue, then white
+        for (uint32_t i = 0; i < slot.count; i++) {
+            uint32_t v = slot.pixels[i];
+            uint8_t g = (0xFF000000 & v) >> 24;
+            uint8_t r = (0xFF0000 & v) >> 16;
+            uint8_t b = (0xFF00 & v) >> 8;
+            if (rgbw) {
+                printf("(%03u,%03u,%03u,%03u),", r, g, b, (unsigned)(v & 0xFF));
+            } else {
+                printf("(%03u,%03u,%03u),", r, g, b);
+            }
+        }
+        printf("\n");
+    }
+
+    if (recording) {
+        uint8_t header[16];
+        for (int i = 0; i < 8; i++) {
+            header[i] = (uint8_t)(slot.timestamp_us >> (8 * i));
+        }
+        for (int i = 0; i < 4; i++) {
+            header[8 + i] = (uint8_t)(slot.count >> (8 * i));
+        }
+        header[12] = (uint8_t)channel.pio;
+        header[13] = (uint8_t)channel.sm;
+        header[14] = channel.bytes_per_pixel;
+        header[15] = 0;
+        fwrite(header, 1, sizeof(header), recording);
+
+        uint8_t pixel[4];
+        for (uint32_t i = 0; i < slot.count; i++) {
+            for (uint8_t b = 0; b < channel.bytes_per_pixel; b++) {
+                pixel[b] = (uint8_t)(slot.pixels[i] >> (24 - 8 * b));
+            }
+            fwrite(pixel, 1, channel.bytes_per_pixel, recording);
+        }
+    }
+
+    if (frames_to_keep > 0) {
+        if (kept_frames.size() == frames_to_keep) {
+            kept_frames.erase(kept_frames.begin());
+        }
+        kept_frames.push_back({slot.timestamp_us, channel.pio, channel.sm,
+                               std::vector<uint32_t>(slot.pixels, slot.pixels + slot.count)});
+    }
+
+    if (frames_latched == 0) {
+        first_frame_us = slot.timestamp_us;
+    }
+    last_frame_us = slot.timestamp_us;
+    frames_latched++;
+    pixels_latched += slot.count;
+    frame_latched.notify_all();
+}
+
+// Deliver a chain's closed frames in order, freeing each buffer for the sender
+static void deliver_ready_frames(CaptureChannel& channel)
 {
     for (;;) {
-        // Wait for activity
-        mock_ws2812_semaphore.acquire();
-        std::this_thread::sleep_for(std::chrono::microseconds(280));
-        
-        for (;;) {
-            // Check that enough time has elapsed
-            auto elapsed = std::chrono::steady_clock::now() - last_update.load();
-            if (elapsed > std::chrono::microseconds(280)) {
-                std::lock_guard<std::mutex> guard(mock_ws2812_leds_mutex);
-                if (mock_ws2812_leds.size() > 0 ) {
-                    printf("Debug: LEDs (R,G,B) = ");
-
-                    for (uint32_t v : mock_ws2812_leds) {
-                        uint8_t r = (0xFF000000 & v) >> 24;
-                        uint8_t g = (0xFF0000 & v) >> 16;
-                        uint8_t b = (0xFF00 & v) >> 8;
-                        printf("(%03u,%03u,%03u),", r, g, b);
+        FrameSlot& slot = channel.slots[channel.next_sequence % MOCK_WS2812_FRAME_SLOTS];
+        if (!slot.ready.load(std::memory_order_acquire)) {
+            break;
+        }
+        deliver_frame(channel, slot);
+        slot.ready.store(false, std::memory_order_release);
+        channel.next_sequence++;
+    }
+}
+
+// Latch frames once the line has been idle for the latch time, and pass them to the sinks. Sleeps on a condition
+// variable while there is no data, and until the earliest deadline while frames are being sent.
+void ws2812_latch_thread()
+{
+    for (;;) {
+        {
+            std::unique_lock<std::mutex> lock(activity_mutex);
+            for (;;) {
+                bool pending = false;
+                uint64_t deadline = UINT64_MAX;
+                uint64_t now = now_us();
+
+                for (auto& entry : channels) {
+                    CaptureChannel* channel = entry.load();
+                    if (!channel) {
+                        continue;
                     }
-                    printf("\n");
+                    pending |= channel->slots[channel->next_sequence % MOCK_WS2812_FRAME_SLOTS].ready.load();
 
-                    mock_ws2812_leds.clear();
+                    // Close the frame if the line has been idle for long enough, otherwise sleep until it could be
+                    uint64_t state = channel->frame_state.load();
+                    if (state_count(state) == 0) {
+                        continue;
+                    }
+                    uint64_t last = channel->last_word_us.load();
+                    if (now - last >= LATCH_TIME_US) {
+                        close_frame(*channel, state, last);
+                        pending = true;
+                    } else {
+                        deadline = std::min(deadline, last + LATCH_TIME_US);
+                    }
+                }
+
+                if (pending) {
                     break;
                 }
+                if (deadline != UINT64_MAX) {
+                    activity.wait_until(lock, absolute_time_t(std::chrono::microseconds(deadline)));
+                } else {
+                    activity.wait(lock);
+                }
+            }
+        }
+
+        for (auto& entry : channels) {
+            if (CaptureChannel* channel = entry.load()) {
+                deliver_ready_frames(*channel);
             }
+        }
+    }
+}
 
-            // Otherwise, wait 10us and try again 
-            std::this_thread::sleep_for(std::chrono::microseconds(10));
+// Latch the chain's frame once the line has been idle for the latch time, as the latch thread does but driven by the
+// virtual clock. Returns the time left if more words have arrived since the alarm was set.
+int64_t ws2812_latch_alarm(alarm_id_t id, void* user_data)
+{
+    CaptureChannel& channel = *(CaptureChannel*)user_data;
+    uint64_t state = channel.frame_state.load();
+    if (state_count(state) > 0) {
+        uint64_t last = channel.last_word_us.load();
+        uint64_t now = now_us();
+        if (now - last < LATCH_TIME_US) {
+            return (int64_t)(last + LATCH_TIME_US - now);
         }
+        close_frame(channel, state, last);
+    }
+    deliver_ready_frames(channel);
+    return 0;
+}
+
+void mock_ws2812_set_console_output(bool enabled)
+{
+    std::lock_guard<std::mutex> guard(sink_mutex);
+    console_output = enabled;
+}
+
+bool mock_ws2812_start_recording(const char* path)
+{
+    std::lock_guard<std::mutex> guard(sink_mutex);
+    if (recording) {
+        fclose(recording);
+    }
+    recording = fopen(path, "wb");
+    if (!recording) {
+        return false;
     }
+    const uint8_t header[8] = {'W', '2', 'F', 'R', 2, 0, 0, 0};
+    fwrite(header, 1, sizeof(header), recording);
+    return true;
+}
+
+void mock_ws2812_stop_recording()
+{
+    std::lock_guard<std::mutex> guard(sink_mutex);
+    if (recording) {
+        fclose(recording);
+        recording = nullptr;
+    }
+}
+
+void mock_ws2812_keep_frames(size_t max_frames)
+{
+    std::lock_guard<std::mutex> guard(sink_mutex);
+    frames_to_keep = max_frames;
+    if (kept_frames.size() > max_frames) {
+        kept_frames.erase(kept_frames.begin(), kept_frames.end() - max_frames);
+    }
+}
+
+std::vector<mock_ws2812_frame> mock_ws2812_take_frames()
+{
+    std::lock_guard<std::mutex> guard(sink_mutex);
+    std::vector<mock_ws2812_frame> frames;
+    frames.swap(kept_frames);
+    return frames;
+}
+
+bool mock_ws2812_wait_for_frames(uint64_t count, uint32_t timeout_ms)
+{
+    if (mock_time_is_virtual()) {
+        // The frames are latched by alarms, which only fire while the caller lets the clock run
+        uint64_t deadline = now_us() + (uint64_t)timeout_ms * 1000;
+        for (;;) {
+            {
+                std::lock_guard<std::mutex> guard(sink_mutex);
+                if (frames_latched >= count) {
+                    return true;
+                }
+            }
+            if (now_us() >= deadline) {
+                return false;
+            }
+            mock_time_block_until(std::min(deadline, now_us() + LATCH_TIME_US), nullptr);
+        }
+    }
+
+    std::unique_lock<std::mutex> lock(sink_mutex);
+    return frame_latched.wait_for(lock, std::chrono::milliseconds(timeout_ms), [count] {
+        return frames_latched >= count;
+    });
+}
+
+mock_ws2812_stats mock_ws2812_get_stats()
+{
+    std::lock_guard<std::mutex> guard(sink_mutex);
+    mock_ws2812_stats stats = {frames_latched, pixels_latched, frames_dropped.load(), pixels_dropped.load(), 0, 0};
+    if (frames_latched > 1 && last_frame_us > first_frame_us) {
+        double seconds = (last_frame_us - first_frame_us) * 1e-6;
+        stats.frames_per_second = (frames_latched - 1) / seconds;
+        stats.pixels_per_second = pixels_latched / seconds;
+    }
+    return stats;
+}
+
+void mock_ws2812_print_stats()
+{
+    mock_ws2812_stats stats = mock_ws2812_get_stats();
+    printf("Debug: WS2812 %llu frames (%.1f/s), %llu pixels (%.0f/s), dropped %llu frames, %llu pixels\n",
+           (unsigned long long)stats.frames, stats.frames_per_second, (unsigned long long)stats.pixels,
+           stats.pixels_per_second, (unsigned long long)stats.frames_dropped, (unsigned long long)stats.pixels_dropped);
 }
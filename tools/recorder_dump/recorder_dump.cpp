@@ -0,0 +1,132 @@
+// Host reader for the flash sample recorder.
+//
+// Usage: recorder_dump [--offset=N] [--size=N] [--out=FILE] IMAGE
+//
+// Reads a flash image: a read back of the whole flash (e.g. picotool save --all), the native build's
+// PICO_MOCK_FLASH_FILE, or just the recorder's region. Writes the recording, oldest sample first, as CSV rows of
+// sector,timestamp_us,x_mg,y_mg,z_mg to stdout or FILE. The region defaults to the firmware's (the last 256 KB of a
+// 2 MB flash) in an image of the whole flash, or the whole file otherwise. A summary of samples, bytes per sample,
+// damaged chunks and sector wear goes to stderr at the end.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+#include "drivers/recorder/recorder_format.h"
+
+// The firmware's defaults (see recorder.h)
+static const size_t FLASH_SIZE = 2 * 1024 * 1024;
+static const size_t REGION_SIZE = 256 * 1024;
+
+struct DumpStats {
+    unsigned long long samples;
+    unsigned long long bytes;         // Chunk bytes, plus the sector headers
+    unsigned long long sectors;
+    unsigned long long damagedChunks; // Chunks that failed their checks, each ending its sector
+};
+
+int main(int argc, char **argv)
+{
+    const char *inputPath = nullptr;
+    const char *outPath = nullptr;
+    long long offset = -1;
+    long long size = -1;
+
+    for (int i = 1; i < argc; ++i) {
+        if (strncmp(argv[i], "--offset=", 9) == 0) {
+            offset = strtoll(argv[i] + 9, nullptr, 0);
+        } else if (strncmp(argv[i], "--size=", 7) == 0) {
+            size = strtoll(argv[i] + 7, nullptr, 0);
+        } else if (strncmp(argv[i], "--out=", 6) == 0) {
+            outPath = argv[i] + 6;
+        } else if (argv[i][0] != '-' && !inputPath) {
+            inputPath = argv[i];
+        } else {
+            inputPath = nullptr;
+            break;
+        }
+    }
+    if (!inputPath) {
+        fprintf(stderr, "Usage: %s [--offset=N] [--size=N] [--out=FILE] IMAGE\n", argv[0]);
+        return 1;
+    }
+
+    FILE *in = fopen(inputPath, "rb");
+    if (!in) {
+        fprintf(stderr, "Could not open %s\n", inputPath);
+        return 1;
+    }
+    std::vector<uint8_t> image;
+    uint8_t buffer[65536];
+    size_t got;
+    while ((got = fread(buffer, 1, sizeof(buffer), in)) > 0) {
+        image.insert(image.end(), buffer, buffer + got);
+    }
+    fclose(in);
+
+    bool wholeFlash = image.size() == FLASH_SIZE;
+    if (offset < 0) {
+        offset = wholeFlash ? (long long)(FLASH_SIZE - (size >= 0 ? (size_t)size : REGION_SIZE)) : 0;
+    }
+    if (size < 0) {
+        size = wholeFlash ? (long long)REGION_SIZE : (long long)image.size() - offset;
+    }
+    if (offset < 0 || size <= 0 || size % RECORDER_SECTOR_SIZE != 0 || offset + size > (long long)image.size()) {
+        fprintf(stderr, "The region (offset %lld, %lld bytes) is not whole sectors within the %zu byte image\n",
+                offset, size, image.size());
+        return 1;
+    }
+
+    FILE *out = stdout;
+    if (outPath) {
+        out = fopen(outPath, "w");
+        if (!out) {
+            fprintf(stderr, "Could not open %s\n", outPath);
+            return 1;
+        }
+    }
+    fprintf(out, "sector,timestamp_us,x_mg,y_mg,z_mg\n");
+
+    const uint8_t *region = image.data() + offset;
+    size_t sectorCount = (size_t)size / RECORDER_SECTOR_SIZE;
+    RecorderExtent extent;
+    DumpStats stats = {};
+    if (recorderFindRecording(region, sectorCount, extent)) {
+        for (uint32_t sequence = extent.oldest; sequence - extent.oldest <= extent.newest - extent.oldest; ++sequence) {
+            const uint8_t *sector = region + (sequence % sectorCount) * RECORDER_SECTOR_SIZE;
+            RecorderSectorHeader header;
+            if (!recorderReadSectorHeader(sector, header) || header.sequence != sequence) {
+                continue; // Erased, but the header was never written
+            }
+            stats.sectors++;
+
+            size_t chunkOffset = RECORDER_SECTOR_HEADER_SIZE;
+            RecorderSample samples[RECORDER_MAX_CHUNK_SAMPLES];
+            int count;
+            while ((count = recorderDecodeChunk(sector, chunkOffset, samples)) > 0) {
+                for (int i = 0; i < count; ++i) {
+                    fprintf(out, "%u,%u,%d,%d,%d\n", (unsigned)sequence, (unsigned)samples[i].timestamp_us,
+                            samples[i].x_mg, samples[i].y_mg, samples[i].z_mg);
+                }
+                stats.samples += (unsigned)count;
+            }
+            if (count < 0) {
+                stats.damagedChunks++;
+            }
+            stats.bytes += chunkOffset;
+        }
+    }
+
+    fprintf(stderr, "%llu samples in %llu sectors, %.2f bytes per sample, %llu damaged chunks", stats.samples,
+            stats.sectors, stats.samples ? (double)stats.bytes / stats.samples : 0.0, stats.damagedChunks);
+    if (stats.sectors > 0) {
+        fprintf(stderr, ", most erases of a sector %u\n", (unsigned)extent.maxEraseCount);
+    } else {
+        fprintf(stderr, "\n");
+    }
+
+    if (out != stdout) {
+        fclose(out);
+    }
+    return 0;
+}
@@ -0,0 +1,149 @@
+// Host decoder for the binary telemetry stream.
+//
+// Usage: telemetry_decode [--text] [--out=FILE] [INPUT]
+//
+// Reads a capture of the UART (or of the native build's stdout) from INPUT, or stdin, and writes every sample as a CSV
+// row of sequence,timestamp_us,x_mg,y_mg,z_mg to stdout or FILE. The log text mixed in with the frames is skipped, or
+// echoed to stderr with --text. A summary of frames, samples, lost frames and damaged frames goes to stderr at the end.
+
+#include <stdio.h>
+#include <string.h>
+#include <vector>
+#include "drivers/telemetry/telemetry_protocol.h"
+
+#ifdef _WIN32
+#include <io.h>
+#include <fcntl.h>
+#endif
+
+struct DecodeStats {
+    unsigned long long frames;
+    unsigned long long samples;
+    unsigned long long lostFrames;    // Gaps in the sequence numbers
+    unsigned long long damagedFrames; // Pieces with binary data that did not decode
+    unsigned long long textBytes;
+};
+
+struct Decoder {
+    FILE *out;
+    bool echoText;
+    bool haveSequence;
+    uint16_t lastSequence;
+    DecodeStats stats;
+};
+
+// Text is printable ASCII and line endings; anything else in a piece that failed to decode was a frame
+static bool isText(const uint8_t *data, size_t length)
+{
+    for (size_t i = 0; i < length; ++i) {
+        if ((data[i] < 0x20 || data[i] > 0x7E) && data[i] != '\r' && data[i] != '\n' && data[i] != '\t') {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Handle the bytes between two zeros
+static void decodePiece(Decoder &decoder, const uint8_t *data, size_t length)
+{
+    if (length == 0) {
+        return; // Between the delimiters of two frames
+    }
+
+    TelemetryFrame frame;
+    if (!telemetryDecodeFrame(data, length, frame)) {
+        if (isText(data, length)) {
+            decoder.stats.textBytes += length;
+            if (decoder.echoText) {
+                fwrite(data, 1, length, stderr);
+            }
+        } else {
+            decoder.stats.damagedFrames++;
+        }
+        return;
+    }
+
+    if (decoder.haveSequence) {
+        decoder.stats.lostFrames += (uint16_t)(frame.sequence - decoder.lastSequence - 1);
+    }
+    decoder.haveSequence = true;
+    decoder.lastSequence = frame.sequence;
+    decoder.stats.frames++;
+    decoder.stats.samples += frame.count;
+
+    for (size_t i = 0; i < frame.count; ++i) {
+        fprintf(decoder.out, "%u,%llu,%d,%d,%d\n", (unsigned)frame.sequence,
+                (unsigned long long)frame.timestamp_us + (unsigned long long)i * frame.period_us,
+                frame.samples[i][0], frame.samples[i][1], frame.samples[i][2]);
+    }
+}
+
+int main(int argc, char **argv)
+{
+    Decoder decoder = {stdout, false, false, 0, {}};
+    const char *inputPath = nullptr;
+    const char *outPath = nullptr;
+
+    for (int i = 1; i < argc; ++i) {
+        if (strcmp(argv[i], "--text") == 0) {
+            decoder.echoText = true;
+        } else if (strncmp(argv[i], "--out=", 6) == 0) {
+            outPath = argv[i] + 6;
+        } else if (argv[i][0] != '-' && !inputPath) {
+            inputPath = argv[i];
+        } else {
+            fprintf(stderr, "Usage: %s [--text] [--out=FILE] [INPUT]\n", argv[0]);
+            return 1;
+        }
+    }
+
+    FILE *in = stdin;
+    if (inputPath) {
+        in = fopen(inputPath, "rb");
+        if (!in) {
+            fprintf(stderr, "Could not open %s\n", inputPath);
+            return 1;
+        }
+    } else {
+#ifdef _WIN32
+        _setmode(_fileno(stdin), _O_BINARY);
+#endif
+    }
+    if (outPath) {
+        decoder.out = fopen(outPath, "w");
+        if (!decoder.out) {
+            fprintf(stderr, "Could not open %s\n", outPath);
+            return 1;
+        }
+    }
+
+    fprintf(decoder.out, "sequence,timestamp_us,x_mg,y_mg,z_mg\n");
+
+    // Split the stream at zeros. A piece can span reads, so it is collected until its zero arrives.
+    std::vector<uint8_t> piece;
+    uint8_t buffer[4096];
+    size_t got;
+    while ((got = fread(buffer, 1, sizeof(buffer), in)) > 0) {
+        for (size_t i = 0; i < got; ++i) {
+            if (buffer[i] == 0) {
+                decodePiece(decoder, piece.data(), piece.size());
+                piece.clear();
+            } else {
+                piece.push_back(buffer[i]);
+            }
+        }
+    }
+    decodePiece(decoder, piece.data(), piece.size());
+
+    const DecodeStats &stats = decoder.stats;
+    fprintf(stderr, "%llu frames, %llu samples, %llu frames lost, %llu damaged, %llu bytes of text\n", stats.frames,
+            stats.samples, stats.lostFrames, stats.damagedFrames, stats.textBytes);
+
+    if (in != stdin) {
+        fclose(in);
+    }
+    if (decoder.out != stdout) {
+        fclose(decoder.out);
+    }
+    return 0;
+}